@@ -0,0 +1,65 @@
+#ifndef IAUNS_ENTITY_SYSTEM_ARCHETYPEESCORE_HPP
+#define IAUNS_ENTITY_SYSTEM_ARCHETYPEESCORE_HPP
+
+#include "ESCore.hpp"
+#include "src/ArchetypeIndex.hpp"
+
+namespace CPM_ES_NS {
+
+/// ESCore that groups entities by component signature into archetype tables
+/// at every renormalize. Entities move between tables when they gain or lose
+/// all components of a type, which only happens at renormalize. Only the
+/// rows of those entities are removed and inserted; the rows of all other
+/// entities stay, and their indices are shifted past the changed entities
+/// (see ArchetypeIndex::build). Changes to entities with small IDs, e.g.
+/// despawning the oldest entities, still shift the indices of nearly every
+/// row, which BenchArchetypeCore measures.
+///
+/// GenericSystem walks the tables matching its component types directly
+/// instead of joining its containers. This pays off for systems that touch
+/// many component types. Components are still stored in their per-type
+/// containers, so existing systems, ComponentGroup::modify and static
+/// components behave as with ESCore.
+///
+/// NOTE: walkComponents visits entities table by table (entities are in
+///       ascending order within each table) rather than in globally
+///       ascending entity order, for every GenericSystem walked over this
+///       core. Systems that depend on the order of execute calls across
+///       entities must not be walked over an ArchetypeESCore. walkEntity,
+///       walkEntities and change filtered walks are unaffected.
+class ArchetypeESCore : public ESCore
+{
+public:
+  void renormalize(bool stableSort = false) override
+  {
+    ESCore::renormalize(stableSort);
+    updateArchetypes();
+  }
+
+  void prepareRenormalize(bool stableSort = false) override
+  {
+    ESCore::prepareRenormalize(stableSort);
+    updateArchetypes();
+  }
+
+  void swapBuffers() override
+  {
+    ESCore::swapBuffers();
+    updateArchetypes();
+  }
+
+  const ArchetypeIndex* getArchetypeIndex() const override {return &mArchetypes;}
+
+protected:
+  void updateArchetypes()
+  {
+    if (mArchetypes.needsRebuild(mComponents, getContainerVersion()))
+      mArchetypes.build(mComponents, getContainerVersion());
+  }
+
+  ArchetypeIndex mArchetypes;
+};
+
+} // namespace CPM_ES_NS
+
+#endif
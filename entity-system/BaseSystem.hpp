@@ -2,6 +2,9 @@
 #define IAUNS_ENTITY_SYSTEM_BASESYSTEM_HPP
 
 #include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
 
 namespace CPM_ES_NS {
 
@@ -17,6 +20,31 @@ public:
   virtual void walkComponents(ESCoreBase& core) = 0;
   virtual bool walkEntity(ESCoreBase& core, uint64_t entityID) = 0;
 
+  /// Walks every entity in \p entityIDs, in sorted order. The result is the
+  /// same as calling walkEntity once per (sorted) entity ID. Returns the number
+  /// of those walkEntity calls that would have returned true. Systems that can do better than one
+  /// walkEntity call per entity should override this function.
+  virtual size_t walkEntities(ESCoreBase& core, const uint64_t* entityIDs, size_t numEntities)
+  {
+    std::vector<uint64_t> sorted(entityIDs, entityIDs + numEntities);
+    std::sort(sorted.begin(), sorted.end());
+
+    size_t numExecuted = 0;
+    for (uint64_t entityID : sorted)
+    {
+      if (walkEntity(core, entityID))
+        ++numExecuted;
+    }
+    return numExecuted;
+  }
+
+  size_t walkEntities(ESCoreBase& core, const std::vector<uint64_t>& entityIDs)
+  {
+    if (entityIDs.empty())
+      return 0;
+    return walkEntities(core, &entityIDs[0], entityIDs.size());
+  }
+
   // Debug functions related to printing components that a particular
   // entity is missing in relation to the system executing.
   virtual std::vector<uint64_t> getComponents() const = 0;
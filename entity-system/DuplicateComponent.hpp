@@ -2,6 +2,7 @@
 #define IAUNS_ENTITY_SYSTEM_DUPLICATECOMPONENT_HPP
 
 #include "GenericSystem.hpp"
+#include "src/DuplicateAwareComponentContainer.hpp"
 
 namespace CPM_ES_NS {
 
@@ -35,10 +36,18 @@ private:
 };
 
 /// Tests to see if there is already an equivalent component within a given
-/// entityID.
+/// entityID. If T is stored in a DuplicateAwareComponentContainer, its index
+/// answers the query, and components added since the last renormalize are
+/// taken into account as well. Otherwise, only renormalized components are
+/// searched.
 template <typename T>
 bool hasDuplicateComponent(ESCoreBase& core, uint64_t entityID, const T& component)
 {
+  BaseComponentContainer* container = core.getComponentContainer(getESTypeID<T>());
+  ComponentDuplicateIndex<T>* indexed = dynamic_cast<ComponentDuplicateIndex<T>*>(container);
+  if (indexed != nullptr && !container->isStatic())
+    return indexed->hasDuplicate(entityID, component);
+
   HasDuplicateComponent<T> sys(component);
   sys.walkEntity(core, entityID);
   return sys.hasFoundDuplicate();
@@ -17,6 +17,22 @@ public:
     coreAddComponent(entityID, component);
   }
 
+  /// Adds many components of one type at once, e.g. when loading a level.
+  /// Pass \p sorted if the pairs are in ascending order of entity ID. See
+  /// ComponentContainer::addComponents.
+  template <typename T>
+  void addComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted = false)
+  {
+    coreAddComponents(items, count, sorted);
+  }
+
+  template <typename T>
+  void addComponents(const std::vector<std::pair<uint64_t, T>>& items, bool sorted = false)
+  {
+    if (!items.empty())
+      coreAddComponents(&items[0], items.size(), sorted);
+  }
+
   //template <typename T>
   //void addComponent(uint64_t entityID, T&& component)
   //{
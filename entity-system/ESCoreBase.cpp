@@ -1,15 +1,18 @@
 #include "ESCoreBase.hpp"
+#include <algorithm>
 
 namespace CPM_ES_NS {
 
 EmptyComponentContainer ESCoreBase::mEmptyContainer;
+std::atomic<uint64_t>   ESCoreBase::mNextContainerVersion(0);
 
 // Note: It is *very* important that mCurSequence starts one greater than
 // the StaticEntityID! Otherwise we could accidentally delete static components!
 ESCoreBase::ESCoreBase()
- : mCurSequence(BaseComponentContainer::StaticEntID)
+ : mCurSequence(BaseComponentContainer::StaticEntID),
+   mLazyRenormalize(false)
 {
-
+  bumpContainerVersion();
 }
 
 bool ESCoreBase::hasComponentContainer(uint64_t componentID) const
@@ -30,6 +33,17 @@ void ESCoreBase::addComponentContainer(BaseComponentContainer* componentCont, ui
   if (it == mComponents.end())
   {
     mComponents.insert(std::make_pair(componentID, componentCont));
+    componentCont->setDirtyList(&mDirtyContainers);
+    if (!componentCont->tracksDirty())
+      mUntrackedContainers.push_back(componentCont);
+    for (BaseReactiveSystem* system : mReactiveSystems)
+    {
+      if (system->getComponentTemplateID() == componentID)
+        componentCont->setReactive(true);
+    }
+    if (componentCont->isDirty())
+      mDirtyContainers.push_back(componentCont);
+    bumpContainerVersion();
   }
   else
   {
@@ -44,9 +58,14 @@ BaseComponentContainer* ESCoreBase::getComponentContainer(uint64_t component)
 {
   auto it = mComponents.find(component);
   if (it != mComponents.end())
+  {
+    it->second->flushRenormalize();
     return (it->second);
+  }
   else
+  {
     return nullptr;
+  }
 }
 
 /// Clears out all component containers (deletes all entities).
@@ -68,6 +87,10 @@ void ESCoreBase::deleteAllComponentContainers()
     delete iter->second;
 
   mComponents.clear();
+  mDirtyContainers.clear();
+  mUntrackedContainers.clear();
+  mBuildContainers.clear();
+  bumpContainerVersion();
 }
 
 /// Call this function at the beginning or end of every frame. It renormalizes
@@ -77,8 +100,178 @@ void ESCoreBase::deleteAllComponentContainers()
 /// components with the same entity ID, use stable sort.
 void ESCoreBase::renormalize(bool stableSort)
 {
+  mWriters.clear();
+  if (!mLazyRenormalize)
+  {
+    renormalizeNow(stableSort);
+    return;
+  }
+
+  compactDirtyContainers();
+  for (BaseComponentContainer* cont : mDirtyContainers)
+    cont->deferRenormalize(stableSort);
+  for (BaseComponentContainer* cont : mUntrackedContainers)
+    cont->renormalize(stableSort);
+
+  if (!mReactiveSystems.empty())
+  {
+    for (BaseReactiveSystem* system : mReactiveSystems)
+      flushPendingRenormalize(system->getComponentTemplateID());
+    dispatchReactiveSystems();
+  }
+}
+
+void ESCoreBase::renormalizeNow(bool stableSort)
+{
+  // Renormalizing may add containers to the list (componentConstruct and
+  // componentDestruct may queue changes), so swap it out first.
+  mWriters.clear();
+  std::vector<BaseComponentContainer*> dirty;
+  dirty.swap(mDirtyContainers);
+  for (BaseComponentContainer* cont : dirty)
+  {
+    if (cont->isRenormalizePending())
+      cont->flushRenormalize();
+    else if (cont->isDirty())
+      cont->renormalize(stableSort);
+  }
+  for (BaseComponentContainer* cont : mUntrackedContainers)
+    cont->renormalize(stableSort);
+  dispatchReactiveSystems();
+}
+
+void ESCoreBase::flushPendingRenormalize()
+{
+  for (size_t i = 0; i < mDirtyContainers.size(); ++i)
+    mDirtyContainers[i]->flushRenormalize();
+  compactDirtyContainers();
+  dispatchReactiveSystems();
+}
+
+void ESCoreBase::flushPendingRenormalize(uint64_t compTemplateID)
+{
+  auto it = mComponents.find(compTemplateID);
+  if (it != mComponents.end())
+    it->second->flushRenormalize();
+}
+
+void ESCoreBase::compactDirtyContainers()
+{
+  std::sort(mDirtyContainers.begin(), mDirtyContainers.end());
+  mDirtyContainers.erase(std::unique(mDirtyContainers.begin(), mDirtyContainers.end()),
+                         mDirtyContainers.end());
+  mDirtyContainers.erase(
+      std::remove_if(mDirtyContainers.begin(), mDirtyContainers.end(),
+                     [](BaseComponentContainer* cont) {return !cont->isDirty();}),
+      mDirtyContainers.end());
+}
+
+void ESCoreBase::prepareRenormalize(bool stableSort)
+{
+  mWriters.clear();
+  mBuildContainers.clear();
   for (auto iter = mComponents.begin(); iter != mComponents.end(); ++iter)
-    iter->second->renormalize(stableSort);
+  {
+    iter->second->prepareRenormalize(stableSort);
+    if (iter->second->isBuildPending())
+      mBuildContainers.push_back(iter->second);
+  }
+  compactDirtyContainers();
+}
+
+void ESCoreBase::buildBackBuffers()
+{
+  // Runs alongside systems, which may add containers to mComponents. Only
+  // the list taken by prepareRenormalize is safe to read here.
+  for (BaseComponentContainer* cont : mBuildContainers)
+    cont->buildBackBuffer();
+}
+
+void ESCoreBase::swapBuffers()
+{
+  for (BaseComponentContainer* cont : mBuildContainers)
+    cont->swapBuffers();
+  mBuildContainers.clear();
+  dispatchReactiveSystems();
+}
+
+void ESCoreBase::addReactiveSystem(BaseReactiveSystem* system)
+{
+  if (std::find(mReactiveSystems.begin(), mReactiveSystems.end(), system) != mReactiveSystems.end())
+    return;
+
+  mReactiveSystems.push_back(system);
+  auto it = mComponents.find(system->getComponentTemplateID());
+  if (it != mComponents.end())
+    it->second->setReactive(true);
+}
+
+void ESCoreBase::removeReactiveSystem(BaseReactiveSystem* system)
+{
+  mReactiveSystems.erase(std::remove(mReactiveSystems.begin(), mReactiveSystems.end(), system),
+                         mReactiveSystems.end());
+
+  uint64_t templateID = system->getComponentTemplateID();
+  for (BaseReactiveSystem* other : mReactiveSystems)
+  {
+    if (other->getComponentTemplateID() == templateID)
+      return;
+  }
+  auto it = mComponents.find(templateID);
+  if (it != mComponents.end())
+    it->second->setReactive(false);
+}
+
+void ESCoreBase::dispatchReactiveSystems()
+{
+  for (size_t i = 0; i < mReactiveSystems.size(); ++i)
+  {
+    uint64_t templateID = mReactiveSystems[i]->getComponentTemplateID();
+    auto it = mComponents.find(templateID);
+    if (it == mComponents.end() || !it->second->hasReactiveBatches())
+      continue;
+
+    // Every system of the type sees the batches before they are cleared.
+    // Handlers may register or unregister systems, so iterate over a copy.
+    BaseComponentContainer* cont = it->second;
+    std::vector<BaseReactiveSystem*> systems = mReactiveSystems;
+    for (BaseReactiveSystem* system : systems)
+    {
+      if (system->getComponentTemplateID() == templateID)
+        system->react(*this, cont);
+    }
+    cont->clearReactiveBatches();
+  }
+}
+
+void ESCoreBase::claimWriteAccess(uint64_t templateID, const BaseSystem* system)
+{
+  const BaseSystem* writer = getWriter(templateID);
+  if (writer == system)
+    return;
+  if (writer != nullptr)
+  {
+    std::cerr << "cpm-entity-system: Two systems claimed exclusive write access to the same component in one frame." << std::endl;
+    throw std::runtime_error("Two systems claimed exclusive write access to the same component.");
+  }
+
+  auto it = mComponents.find(templateID);
+  if (it != mComponents.end() && !it->second->canWriteInPlace())
+  {
+    std::cerr << "cpm-entity-system: Component container does not support in place writes." << std::endl;
+    throw std::runtime_error("Component container does not support in place writes.");
+  }
+  mWriters.push_back(std::make_pair(templateID, system));
+}
+
+const BaseSystem* ESCoreBase::getWriter(uint64_t templateID) const
+{
+  for (const std::pair<uint64_t, const BaseSystem*>& writer : mWriters)
+  {
+    if (writer.first == templateID)
+      return writer.second;
+  }
+  return nullptr;
 }
 
 /// Removes all components associated with entity.
@@ -88,6 +281,53 @@ void ESCoreBase::removeEntity(uint64_t entityID)
     iter->second->removeSequence(entityID);
 }
 
+Prefab ESCoreBase::createPrefab(uint64_t entityID)
+{
+  Prefab prefab;
+  prefab.mSourceEntityID = entityID;
+  for (auto iter = mComponents.begin(); iter != mComponents.end(); ++iter)
+  {
+    iter->second->flushRenormalize();
+    BasePrefabComponents* part = iter->second->capturePrefabComponents(entityID);
+    if (part != nullptr)
+      prefab.mParts.emplace_back(iter->first, std::unique_ptr<BasePrefabComponents>(part));
+  }
+  return prefab;
+}
+
+uint64_t ESCoreBase::instantiatePrefab(const Prefab& prefab, size_t count)
+{
+  uint64_t first = getNewEntityIDs(count);
+  instantiatePrefab(prefab, first, count);
+  return first;
+}
+
+void ESCoreBase::instantiatePrefab(const Prefab& prefab, uint64_t firstEntityID, size_t count)
+{
+  if (firstEntityID == 0)
+  {
+    std::cerr << "cpm-entity-system: Attempting to instantiate a prefab at entityID 0! Not allowed." << std::endl;
+    throw std::runtime_error("Attempting to instantiate a prefab at entityID 0.");
+  }
+
+  // Check every container first so that nothing is queued on failure.
+  std::vector<BaseComponentContainer*> containers;
+  containers.reserve(prefab.mParts.size());
+  for (const auto& part : prefab.mParts)
+  {
+    auto it = mComponents.find(part.first);
+    if (it == mComponents.end())
+    {
+      std::cerr << "cpm-entity-system: Attempting to instantiate a prefab holding a component type without a container in this core." << std::endl;
+      throw std::runtime_error("No component container for a prefab component type.");
+    }
+    containers.push_back(it->second);
+  }
+
+  for (size_t i = 0; i < containers.size(); ++i)
+    containers[i]->instantiatePrefabComponents(*prefab.mParts[i].second, firstEntityID, count);
+}
+
 void ESCoreBase::removeFirstComponent(uint64_t entityID, uint64_t compTemplateID)
 {
   BaseComponentContainer* cont = getComponentContainer(compTemplateID);
@@ -3,11 +3,16 @@
 
 #include <map>
 #include <list>
+#include <vector>
+#include <atomic>
 #include <iostream>
 #include <stdexcept>
 #include "BaseSystem.hpp"
+#include "ReactiveSystem.hpp"
+#include "Prefab.hpp"
 #include "src/ComponentContainer.hpp"
 #include "src/EmptyComponentContainer.hpp"
+#include "src/ArchetypeIndex.hpp"
 
 namespace CPM_ES_NS {
 
@@ -40,10 +45,24 @@ public:
   void addComponentContainer(BaseComponentContainer* componentCont, uint64_t componentID);
 
   /// Retrieves a base component container. Component is the output from
-  /// the TemplateID class.
+  /// the TemplateID class. Performs the container's deferred renormalize, if
+  /// any (see setLazyRenormalize).
   BaseComponentContainer* getComponentContainer(uint64_t component);
 
-  /// Clears out all component containers (deletes all entities).
+  /// Returns a value that changes whenever component containers are added to
+  /// or deleted from this core. Versions are unique across all cores, so a
+  /// cached container lookup (see Query) is valid as long as the version it
+  /// was resolved against matches.
+  uint64_t getContainerVersion() const {return mContainerVersion;}
+
+  /// Returns the archetype index maintained by this core, or nullptr if the
+  /// core does not maintain one (see ArchetypeESCore). GenericSystem uses the
+  /// index, when present and up to date, in place of its merge join.
+  virtual const ArchetypeIndex* getArchetypeIndex() const {return nullptr;}
+
+  /// Clears out all component containers (deletes all entities) at the next
+  /// renormalize. Components still pending are kept, see
+  /// ComponentContainer::removeAll.
   void clearAllComponentContainers();
 
   /// Clears out all component containers *immediately*.
@@ -54,8 +73,87 @@ public:
   /// the walkComponents function on BaseSystem. Most systems don't need a
   /// stable sort. But if you need to guarantee the relative order of multiple 
   /// components with the same entity ID, use stable sort.
+  /// Only containers that changed since their last renormalize are visited,
+  /// along with every container that does not track changes (see
+  /// BaseComponentContainer::tracksDirty). In lazy mode (see
+  /// setLazyRenormalize), the renormalize of changed containers is deferred.
   virtual void renormalize(bool stableSort = false);
 
+  /// Renormalizes all changed containers immediately, including containers
+  /// whose renormalize was deferred. Same as renormalize outside of lazy
+  /// mode.
+  void renormalizeNow(bool stableSort = false);
+
+  /// In lazy mode, renormalize only records which containers need to be
+  /// renormalized. Each is renormalized when it is next accessed: when a
+  /// system walks it, when it is retrieved through getComponentContainer
+  /// (and so getStaticComponent), when a change is queued to it, or when
+  /// flushPendingRenormalize is called. Containers no system reads are
+  /// not renormalized until then. Results are the same as with eager
+  /// renormalization.
+  void setLazyRenormalize(bool lazy)  {mLazyRenormalize = lazy;}
+  bool isLazyRenormalize() const      {return mLazyRenormalize;}
+
+  /// Performs all deferred renormalizes.
+  void flushPendingRenormalize();
+
+  /// Performs the deferred renormalize of one container, if any.
+  void flushPendingRenormalize(uint64_t compTemplateID);
+
+  template <typename T>
+  void flushPendingRenormalizeT()
+  {
+    flushPendingRenormalize(getESTypeID<T>());
+  }
+
+  /// Renormalize split into three steps, so that double-buffered containers
+  /// (see DoubleBufferedComponentContainer) can build their next layout while
+  /// systems read the current one:
+  ///
+  ///   core.prepareRenormalize();                      // frame barrier
+  ///   std::thread builder([&]{core.buildBackBuffers();});
+  ///   ... walk systems ...
+  ///   builder.join();
+  ///   core.swapBuffers();                             // frame barrier
+  ///
+  /// prepareRenormalize renormalizes all other containers in place, and hands
+  /// the changes queued in double-buffered containers over to their back
+  /// buffers. buildBackBuffers only touches the back buffers of the
+  /// containers prepareRenormalize found changes in, and may run on another
+  /// thread while systems walk (and add containers to) the core. swapBuffers
+  /// makes the new layouts visible. Changes queued while the back buffers are
+  /// built, including to containers added meanwhile, are applied by the next
+  /// prepareRenormalize.
+  /// @{
+  virtual void prepareRenormalize(bool stableSort = false);
+  void buildBackBuffers();
+  virtual void swapBuffers();
+  /// @}
+
+  /// Records that \p system writes the components of \p templateID in place
+  /// (see GenericSystem::isComponentWritten) until the next renormalize or
+  /// prepareRenormalize. A system may claim the same components any number
+  /// of times. Throws if another system claimed them first, or if their
+  /// container cannot be written in place.
+  void claimWriteAccess(uint64_t templateID, const BaseSystem* system);
+
+  /// Returns the system that claimed write access to \p templateID since the
+  /// last renormalize, or nullptr.
+  const BaseSystem* getWriter(uint64_t templateID) const;
+
+  /// Registers \p system to receive the components of its type added and
+  /// removed by each renormalize (see ReactiveSystem). The core does not
+  /// take ownership. Systems are called in the order they were added, after
+  /// renormalize, flushPendingRenormalize and swapBuffers. In lazy mode,
+  /// containers with reactive systems are renormalized eagerly.
+  void addReactiveSystem(BaseReactiveSystem* system);
+
+  /// Unregisters \p system.
+  void removeReactiveSystem(BaseReactiveSystem* system);
+
+  /// Hands the recorded batches to the reactive systems, then clears them.
+  void dispatchReactiveSystems();
+
   /// Removes all components associated with entity.
   virtual void removeEntity(uint64_t entityID);
 
@@ -137,7 +235,7 @@ public:
       typename ComponentContainer<T>::ComponentItem* components = concreteContainer->getComponentArray();
       int numComp = concreteContainer->getNumComponents();
       if (components != nullptr && index < concreteContainer->getNumComponents())
-        return &components[index].component;
+        return &components[index].get();
       else
         return nullptr;
     }
@@ -157,14 +255,45 @@ public:
   /// not be used if you are controlling entity ids using external code.
   uint64_t getNewEntityID() {return ++mCurSequence;}
 
+  /// Returns the first of \p count new, consecutive entity IDs.
+  uint64_t getNewEntityIDs(size_t count)
+  {
+    uint64_t first = mCurSequence + 1;
+    mCurSequence += count;
+    return first;
+  }
+
+  /// Captures copies of all components \p entityID holds, in every
+  /// container, see Prefab.
+  Prefab createPrefab(uint64_t entityID);
+
+  /// Queues the prefab's components for \p count new entities, with IDs
+  /// from getNewEntityIDs, and returns the first ID. The components become
+  /// visible at the next renormalize, like those of addComponent.
+  uint64_t instantiatePrefab(const Prefab& prefab, size_t count);
+
+  /// Same as above, for the entities \p firstEntityID to
+  /// \p firstEntityID + \p count - 1. Throws if the core has no container
+  /// for one of the prefab's component types.
+  void instantiatePrefab(const Prefab& prefab, uint64_t firstEntityID, size_t count);
+
 protected:
 
   /// Deletes all component containers.
   void deleteAllComponentContainers();
 
+  /// Assigns a new container version. Called whenever the set of containers
+  /// changes.
+  void bumpContainerVersion() {mContainerVersion = ++mNextContainerVersion;}
+
+  /// Drops containers that are no longer dirty, and duplicates, from
+  /// mDirtyContainers.
+  void compactDirtyContainers();
+
   /// Adds a component. If a component container already exists, then that is
-  /// used. Otherwise, a new component container is created and used.
-  template <typename T, class CompCont = ComponentContainer<T>>
+  /// used. Otherwise, a new component container is created and used. The
+  /// container type defaults to ComponentContainerType<T>::type.
+  template <typename T, class CompCont = typename ComponentContainerType<T>::type>
   void coreAddComponent(uint64_t entityID, const T& component)
   {
     if (entityID == 0)
@@ -176,9 +305,32 @@ protected:
 
     BaseComponentContainer* componentContainer = ensureComponentArrayExists<T, CompCont>();
     CompCont* concreteContainer = dynamic_cast<CompCont*>(componentContainer);
+    if (concreteContainer == nullptr)
+    {
+      std::cerr << "cpm-entity-system: Component container type does not match the container already in use for this component." << std::endl;
+      throw std::runtime_error("Component container type mismatch.");
+    }
     concreteContainer->addComponent(entityID, component);
   }
 
+  /// Adds \p count components of type T with one container lookup, see
+  /// ComponentContainer::addComponents.
+  template <typename T, class CompCont = typename ComponentContainerType<T>::type>
+  void coreAddComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted)
+  {
+    if (count == 0)
+      return;
+
+    BaseComponentContainer* componentContainer = ensureComponentArrayExists<T, CompCont>();
+    CompCont* concreteContainer = dynamic_cast<CompCont*>(componentContainer);
+    if (concreteContainer == nullptr)
+    {
+      std::cerr << "cpm-entity-system: Component container type does not match the container already in use for this component." << std::endl;
+      throw std::runtime_error("Component container type mismatch.");
+    }
+    concreteContainer->addComponents(items, count, sorted);
+  }
+
   ///// Same function as above, but we bind to an rvalue reference.
   //template <typename T, class CompCont = ComponentContainer<T>>
   //void coreAddComponent(uint64_t entityID, T&& component)
@@ -212,7 +364,7 @@ protected:
   // Note: This std::decay is the reason why we don't get perfect forwarding
   // into the ComponentContainer<T> class. We remove its cv qualifiers so
   // we don't get a type match.
-  template <typename T, class CompCont = ComponentContainer<typename std::decay<T>::type>>
+  template <typename T, class CompCont = typename ComponentContainerType<typename std::decay<T>::type>::type>
   size_t coreAddStaticComponent(T&& component)
   {
    // If the container isn't already marked as static, mark it and ensure
@@ -235,9 +387,17 @@ protected:
   }
 
   std::map<uint64_t, BaseComponentContainer*> mComponents;
+  std::vector<BaseComponentContainer*>        mDirtyContainers; ///< Changed since their last renormalize.
+  std::vector<BaseComponentContainer*>        mUntrackedContainers; ///< Renormalized every time, see BaseComponentContainer::tracksDirty.
+  std::vector<BaseComponentContainer*>        mBuildContainers; ///< Back buffers to build, see prepareRenormalize.
+  std::vector<std::pair<uint64_t, const BaseSystem*>> mWriters; ///< Write claims since the last renormalize.
+  std::vector<BaseReactiveSystem*>            mReactiveSystems; ///< See addReactiveSystem.
   uint64_t                                    mCurSequence;
+  uint64_t                                    mContainerVersion;
+  bool                                        mLazyRenormalize;
 
   static EmptyComponentContainer mEmptyContainer;
+  static std::atomic<uint64_t>   mNextContainerVersion;
 };
 
 
@@ -2,18 +2,26 @@
 #define IAUNS_ENTITY_SYSTEM_GENERICSYSTEM_HPP
 
 // GenericSystems are not associated with any one core. You can use a system
-// with any number of cores. All important functions are static and don't
-// use any stored state. You can create instances of this class and use
-// the BaseSystem interface to iterate over all systems with the 
-// walkComponentsOver override.
+// with any number of cores. A system caches per walk state: a Query of the
+// containers it walks, which is re-resolved whenever the system is walked
+// over a different core or the core's set of containers changes, along with
+// change filter and archetype match state. Do not walk one system instance
+// from two threads at once; give each thread its own instance.
+// You can create instances of this class and use the BaseSystem interface to
+// iterate over all systems with the walkComponentsOver override.
 
 #include <iostream>
 #include <array>
+#include <vector>
+#include <limits>
+#include <algorithm>
 #include <set>          // Only used in a corner case of walkComponents where
                         // all components are optional.
 #include <type_traits>
 #include "ESCoreBase.hpp"
+#include "Query.hpp"
 #include "src/ComponentContainer.hpp"
+#include "src/UniqueComponentContainer.hpp"
 #include "src/TemplateID.hpp"
 #include "src/ComponentGroup.hpp"
 
@@ -53,6 +61,33 @@ void call(ESCoreBase& core, uint64_t sequence, C c, F f, Tuple && t)
   call_impl<C, F, Tuple, 0 == std::tuple_size<ttype>::value, std::tuple_size<ttype>::value>::call(core, sequence, c, f, std::forward<Tuple>(t));
 }
 
+/// Returns the index of the first item in [begin, end) whose sequence is not
+/// less than \p sequence. Gallops forward from \p begin before falling back
+/// to a binary search, so walking a sorted list of sequences through an array
+/// costs little more than a linear merge when the sequences are dense, and
+/// a logarithmic probe when they are sparse.
+template <typename Item>
+int gallopLowerBound(const Item* array, int begin, int end, uint64_t sequence)
+{
+  if (begin >= end || !(array[begin] < sequence))
+    return begin;
+
+  // array[lo] < sequence always holds from here on.
+  int lo = begin;
+  int step = 1;
+  int hi = begin + step;
+  while (hi < end && array[hi] < sequence)
+  {
+    lo = hi;
+    step *= 2;
+    hi = begin + step;
+  }
+  if (hi > end)
+    hi = end;
+
+  return static_cast<int>(std::lower_bound(array + lo + 1, array + hi, sequence) - array);
+}
+
 }
 
 /// See: http://stackoverflow.com/questions/18986560/check-variadic-templates-parameters-for-uniqueness?lq=1
@@ -74,8 +109,9 @@ template< class ...T >struct is_unique : is_unique_impl< empty, T ... > {};
 } // mpl    
 
 
-/// Base class implementation of generic system. You do not need instances of
-/// this class in order to use it. All important functions are static.
+/// Base class implementation of generic system. Walks modify the state the
+/// instance caches between walks, so a single instance must not be walked
+/// concurrently, even over different cores.
 template <bool GroupComponents, typename... Ts>
 class GenericSystem : public BaseSystem
 {
@@ -83,7 +119,14 @@ public:
 
   static_assert(mpl::is_unique<Ts...>::value, "GenericSystem does not allow duplicate component types.");
 
-  GenericSystem()           {}
+  GenericSystem() :
+      mArchetypeIndex(nullptr),
+      mArchetypeBuild(0)
+  {
+    mWritten.fill(false);
+    mChangeContainers.fill(nullptr);
+    mChangeSeen.fill(0);
+  }
   virtual ~GenericSystem()  {}
 
   bool walkEntity(ESCoreBase& core, uint64_t entityID) override
@@ -91,22 +134,23 @@ public:
     if (sizeof...(Ts) == 0)
       return false;
 
-    std::array<BaseComponentContainer*, sizeof...(Ts)> baseComponents = { core.getComponentContainer(TemplateID<Ts>::getID())... };
+    bindQuery(core);
+    claimWriteAccess(core);
+    std::array<BaseComponentContainer*, sizeof...(Ts)> baseComponents = mQuery.getBaseContainers();
     std::array<int, sizeof...(Ts)> indices;
     std::array<int, sizeof...(Ts)> nextIndices;
     std::array<bool, sizeof...(Ts)> isStatic;
     std::array<int, sizeof...(Ts)> numComponents;
     std::array<bool, sizeof...(Ts)> optionalComponents = { isComponentOptional(TemplateID<Ts>::getID())... }; // Detect optional components via overriden function call (simplest).
 
-    // Arrays containing components arrays. BuildComponentArrays was made to be
-    // called before we correct baseComponents with getEmptyContainer.
+    // Arrays containing components arrays.
     std::tuple<typename ComponentContainer<Ts>::ComponentItem*...> componentArrays;
-    BuildComponentArraysAndIndicesWithID<0, Ts...>::exec(baseComponents, componentArrays, indices, entityID);
+    BuildComponentArraysAndIndicesWithID<0, Ts...>::exec(mQuery.getContainers(), componentArrays, indices, entityID);
 
     std::tuple<Ts*...> values;  ///< Values that will be passed into execute.
     std::tuple<ComponentGroup<Ts>...> groupValues;  ///< Grouped values that will be passed into group execute.
 
-    AddComponentsToGroupInputs<0, Ts...>::exec(core, baseComponents, groupValues);
+    AddComponentsToGroupInputs<0, Ts...>::exec(mQuery.getContainers(), groupValues);
 
     bool execute = true;
     for (int i = 0; i < sizeof...(Ts); i++)
@@ -155,6 +199,100 @@ public:
     }
   }
 
+  using BaseSystem::walkEntities;
+
+  /// Walks all entities in \p entityIDs in sorted order. Containers are only
+  /// looked up once, and each container is searched in a single forward pass
+  /// over the sorted entity IDs instead of a binary search per entity.
+  /// Execution matches calling walkEntity once per sorted entity ID.
+  size_t walkEntities(ESCoreBase& core, const uint64_t* entityIDs, size_t numEntities) override
+  {
+    if (sizeof...(Ts) == 0 || numEntities == 0)
+      return 0;
+
+    std::vector<uint64_t> sorted(entityIDs, entityIDs + numEntities);
+    std::sort(sorted.begin(), sorted.end());
+    return walkSortedEntities(core, &sorted[0], sorted.size());
+  }
+
+  /// Same as walkEntities, but \p entityIDs must already be sorted in
+  /// ascending order. Avoids the copy and sort performed by walkEntities.
+  size_t walkSortedEntities(ESCoreBase& core, const uint64_t* entityIDs, size_t numEntities)
+  {
+    if (sizeof...(Ts) == 0)
+      return 0;
+
+    bindQuery(core);
+    claimWriteAccess(core);
+    std::array<BaseComponentContainer*, sizeof...(Ts)> baseComponents = mQuery.getBaseContainers();
+    std::array<int, sizeof...(Ts)> indices;
+    std::array<int, sizeof...(Ts)> nextIndices;
+    std::array<int, sizeof...(Ts)> cursors;
+    std::array<bool, sizeof...(Ts)> isStatic;
+    std::array<int, sizeof...(Ts)> numComponents;
+    std::array<bool, sizeof...(Ts)> optionalComponents = { isComponentOptional(TemplateID<Ts>::getID())... };
+
+    std::tuple<typename ComponentContainer<Ts>::ComponentItem*...> componentArrays;
+    BuildComponentArrays<0, Ts...>::exec(mQuery.getContainers(), componentArrays);
+
+    std::tuple<Ts*...> values;
+    std::tuple<ComponentGroup<Ts>...> groupValues;
+
+    AddComponentsToGroupInputs<0, Ts...>::exec(mQuery.getContainers(), groupValues);
+
+    for (int i = 0; i < sizeof...(Ts); i++)
+    {
+      if (baseComponents[i] == nullptr)
+        baseComponents[i] = ESCoreBase::getEmptyContainer();
+
+      isStatic[i] = baseComponents[i]->isStatic();
+      numComponents[i] = baseComponents[i]->getNumComponents();
+      cursors[i] = 0;
+      nextIndices[i] = 0;
+    }
+
+    size_t numExecuted = 0;
+    for (size_t e = 0; e < numEntities; ++e)
+    {
+      uint64_t entityID = entityIDs[e];
+      GallopIndicesToID<0, Ts...>::exec(componentArrays, numComponents, isStatic,
+                                        cursors, indices, entityID);
+
+      // Identical to the index resolution in walkEntity.
+      bool execute = true;
+      for (int i = 0; i < sizeof...(Ts); i++)
+      {
+        if (indices[i] == -1)
+        {
+          if (!optionalComponents[i])
+          {
+            execute = false;
+            break;
+          }
+          else
+          {
+            indices[i] = numComponents[i];
+          }
+        }
+      }
+
+      if (execute)
+      {
+        if (GroupComponents == false)
+          RecurseExecute<0, Ts...>::exec(core, this, componentArrays, numComponents,
+                                         indices, optionalComponents, isStatic,
+                                         nextIndices, values, entityID);
+        else
+          GroupExecute<0, Ts...>::exec(core, this, componentArrays, numComponents,
+                                       indices, optionalComponents, isStatic,
+                                       nextIndices, groupValues, entityID);
+        ++numExecuted;
+      }
+    }
+
+    return numExecuted;
+  }
+
   void walkComponents(ESCoreBase& core) override
   {
     preWalkComponents(core);
@@ -167,17 +305,26 @@ public:
     if (sizeof...(Ts) == 0)
       return;
 
-    std::array<BaseComponentContainer*, sizeof...(Ts)> baseComponents = { core.getComponentContainer(TemplateID<Ts>::getID())... };
+    bindQuery(core);
+    claimWriteAccess(core);
+
+    std::array<bool, sizeof...(Ts)> changeFiltered = {{ isChangeFiltered(TemplateID<Ts>::getID())... }};
+    if (std::find(changeFiltered.begin(), changeFiltered.end(), true) != changeFiltered.end())
+    {
+      walkChangedEntities(core, changeFiltered);
+      return;
+    }
+
+    std::array<BaseComponentContainer*, sizeof...(Ts)> baseComponents = mQuery.getBaseContainers();
     std::array<int, sizeof...(Ts)> indices;
     std::array<int, sizeof...(Ts)> nextIndices;
     std::array<int, sizeof...(Ts)> numComponents;
     std::array<bool, sizeof...(Ts)> isStatic;
     std::array<bool, sizeof...(Ts)> optionalComponents = { isComponentOptional(TemplateID<Ts>::getID())... }; // Detect optional components via overriden function call (simplest).
 
-    // Arrays containing components arrays. BuildComponentArrays was made to be
-    // called before we correct baseComponents with getEmptyContainer.
+    // Arrays containing components arrays.
     std::tuple<typename ComponentContainer<Ts>::ComponentItem*...> componentArrays;
-    BuildComponentArrays<0, Ts...>::exec(baseComponents, componentArrays);
+    BuildComponentArrays<0, Ts...>::exec(mQuery.getContainers(), componentArrays);
 
     // Start off with std::numeric_limits max on lowest upper sequence,
     // and check for optional components. No optional components are allowed
@@ -193,6 +340,8 @@ public:
       if (baseComponents[i] == nullptr)
         baseComponents[i] = ESCoreBase::getEmptyContainer();
 
+      baseComponents[i]->noteWalk();
+
       bool optional = optionalComponents[i];
       // An empty mandatory component results in an immediate termination
       // of the walk. Even if the component is static.
@@ -218,7 +367,18 @@ public:
     std::tuple<Ts*...> values;                      ///< Values that will be passed into execute.
     std::tuple<ComponentGroup<Ts>...> groupValues;  ///< Grouped values that will be passed into group execute.
 
-    AddComponentsToGroupInputs<0, Ts...>::exec(core, baseComponents, groupValues);
+    AddComponentsToGroupInputs<0, Ts...>::exec(mQuery.getContainers(), groupValues);
+
+    // Cores that maintain an archetype index let us iterate the rows of
+    // matching tables instead of joining the containers below. Entities are
+    // then visited table by table, not in ascending order (see
+    // ArchetypeESCore).
+    if (leadingComponent != -1
+        && walkArchetypes(core, baseComponents, componentArrays, numComponents,
+                          optionalComponents, isStatic, values, groupValues))
+    {
+      return;
+    }
 
     // leadingComponent == -1 if and only if the number of optional and static
     // components == sizeof...(Ts). Because the if statement following the
@@ -442,6 +602,192 @@ public:
     }
   }
 
+  /// Walks the archetype tables of \p core that contain all mandatory
+  /// non-static components of this system. Returns false, without executing
+  /// anything, if the core has no archetype index or the index is out of date
+  /// with respect to any container this system reads.
+  bool walkArchetypes(ESCoreBase& core,
+                      const std::array<BaseComponentContainer*, sizeof...(Ts)>& baseComponents,
+                      const std::tuple<typename ComponentContainer<Ts>::ComponentItem*...>& componentArrays,
+                      const std::array<int, sizeof...(Ts)>& numComponents,
+                      const std::array<bool, sizeof...(Ts)>& optionalComponents,
+                      const std::array<bool, sizeof...(Ts)>& isStatic,
+                      std::tuple<Ts*...>& values,
+                      std::tuple<ComponentGroup<Ts>...>& groupValues)
+  {
+    const ArchetypeIndex* archetypes = core.getArchetypeIndex();
+    if (archetypes == nullptr || !archetypes->isCurrent(core.getContainerVersion()))
+      return false;
+
+    for (int i = 0; i < sizeof...(Ts); ++i)
+    {
+      if (!isStatic[i] && numComponents[i] > 0 && !archetypes->isCurrent(baseComponents[i]))
+        return false;
+    }
+
+    // Determine which tables match, and which column each component is
+    // stored in, once per build of the index.
+    if (mArchetypeIndex != archetypes || mArchetypeBuild != archetypes->getBuildVersion())
+    {
+      std::array<uint64_t, sizeof...(Ts)> templateIDs = {{ TemplateID<Ts>::getID()... }};
+      const std::vector<ArchetypeIndex::Table>& tables = archetypes->getTables();
+
+      mArchetypeMatches.clear();
+      for (size_t t = 0; t < tables.size(); ++t)
+      {
+        std::array<int, sizeof...(Ts)> columns;
+        bool matches = true;
+        for (int i = 0; i < sizeof...(Ts); ++i)
+        {
+          columns[i] = isStatic[i] ? -1 : tables[t].findColumn(templateIDs[i]);
+          if (columns[i] == -1 && !isStatic[i] && !optionalComponents[i])
+          {
+            matches = false;
+            break;
+          }
+        }
+        if (matches)
+          mArchetypeMatches.push_back(std::make_pair(t, columns));
+      }
+
+      mArchetypeIndex = archetypes;
+      mArchetypeBuild = archetypes->getBuildVersion();
+    }
+
+    const std::vector<ArchetypeIndex::Table>& tables = archetypes->getTables();
+    std::array<int, sizeof...(Ts)> indices;
+    std::array<int, sizeof...(Ts)> nextIndices;
+    nextIndices.fill(0);
+
+    for (const std::pair<size_t, std::array<int, sizeof...(Ts)>>& match : mArchetypeMatches)
+    {
+      const ArchetypeIndex::Table& table = tables[match.first];
+      const std::array<int, sizeof...(Ts)>& columns = match.second;
+
+      for (size_t row = 0; row < table.entities.size(); ++row)
+      {
+        // Static components always start at 0. Optional components that are
+        // not part of this table are placed at the end of their array, just
+        // as the merge join does.
+        for (int i = 0; i < sizeof...(Ts); ++i)
+        {
+          if (isStatic[i])
+            indices[i] = 0;
+          else if (columns[i] == -1)
+            indices[i] = numComponents[i];
+          else
+            indices[i] = table.columns[columns[i]][row];
+        }
+
+        if (GroupComponents == false)
+          RecurseExecute<0, Ts...>::exec(core, this, componentArrays, numComponents,
+                                         indices, optionalComponents, isStatic,
+                                         nextIndices, values, table.entities[row]);
+        else
+          GroupExecute<0, Ts...>::exec(core, this, componentArrays, numComponents,
+                                       indices, optionalComponents, isStatic,
+                                       nextIndices, groupValues, table.entities[row]);
+      }
+    }
+
+    return true;
+  }
+
+  /// Binds mQuery to \p core. Whenever containers are re-resolved, checks
+  /// that components IsUniqueComponent declares unique really are held by a
+  /// UniqueComponentContainer, since the walk joins them one-to-one.
+  void bindQuery(ESCoreBase& core)
+  {
+    bool resolve = !mQuery.isValid() || mQuery.getCore() != &core;
+    mQuery.bind(core);
+    if (!resolve)
+      return;
+
+    std::array<bool, sizeof...(Ts)> matches = {{ isUniqueContainerValid<Ts>(mQuery.template getContainer<Ts>())... }};
+    if (std::find(matches.begin(), matches.end(), false) != matches.end())
+    {
+      mQuery.invalidate();
+      std::cerr << "cpm-entity-system: Component declared unique is not held by a UniqueComponentContainer." << std::endl;
+      throw std::runtime_error("Unique component held by a non-unique container.");
+    }
+  }
+
+  template <typename T>
+  static bool isUniqueContainerValid(ComponentContainer<T>* container)
+  {
+    return    !IsUniqueComponent<T>::value || container == nullptr
+           || dynamic_cast<UniqueComponentContainer<T>*>(container) != nullptr;
+  }
+
+  void claimWriteAccess(ESCoreBase& core)
+  {
+    std::array<uint64_t, sizeof...(Ts)> templateIDs = {{ TemplateID<Ts>::getID()... }};
+    for (size_t i = 0; i < sizeof...(Ts); ++i)
+    {
+      mWritten[i] = isComponentWritten(templateIDs[i]);
+      if (mWritten[i])
+        core.claimWriteAccess(templateIDs[i], this);
+    }
+  }
+
+  /// walkComponents with a change filter: walks, with walkSortedEntities,
+  /// the entities whose filtered components were added or changed since
+  /// this system last walked them.
+  void walkChangedEntities(ESCoreBase& core, const std::array<bool, sizeof...(Ts)>& changeFiltered)
+  {
+    std::array<BaseComponentContainer*, sizeof...(Ts)> baseComponents = mQuery.getBaseContainers();
+    mChangedSequences.clear();
+    for (size_t i = 0; i < sizeof...(Ts); ++i)
+    {
+      BaseComponentContainer* cont = baseComponents[i];
+      if (!changeFiltered[i] || cont == nullptr || cont->isStatic())
+        continue;
+
+      if (!cont->isTrackingChanges())
+      {
+        std::cerr << "cpm-entity-system: Change filter on a component whose changes are not tracked (see TrackComponentChanges)." << std::endl;
+        throw std::runtime_error("Change filter on a component whose changes are not tracked.");
+      }
+
+      // A different container, e.g. of another core: everything is new.
+      if (mChangeContainers[i] != cont)
+      {
+        mChangeContainers[i] = cont;
+        mChangeSeen[i] = 0;
+      }
+
+      size_t numSorted = mChangedSequences.size();
+      cont->collectChangedSequences(mChangeSeen[i], mChangedSequences);
+      if (numSorted != 0)
+      {
+        std::inplace_merge(mChangedSequences.begin(), mChangedSequences.begin() + numSorted,
+                           mChangedSequences.end());
+        mChangedSequences.erase(std::unique(mChangedSequences.begin(), mChangedSequences.end()),
+                                mChangedSequences.end());
+      }
+    }
+
+    if (!mChangedSequences.empty())
+      walkSortedEntities(core, &mChangedSequences[0], mChangedSequences.size());
+
+    // Taken after the walk, so that this system's own in place writes are
+    // not seen as changes the next time.
+    for (size_t i = 0; i < sizeof...(Ts); ++i)
+    {
+      if (changeFiltered[i] && baseComponents[i] != nullptr)
+        mChangeSeen[i] = baseComponents[i]->getChangeVersion();
+    }
+  }
+
+  void checkWritten(size_t component) const
+  {
+    if (!mWritten[component])
+    {
+      std::cerr << "cpm-entity-system: Attempt to write a component in place that the system did not declare as written." << std::endl;
+      throw std::runtime_error("Attempt to write a component in place that the system did not declare as written.");
+    }
+  }
+
   std::vector<uint64_t> getComponents() const override
   {
     std::vector<uint64_t> components = { TemplateID<Ts>::getID()... };
@@ -498,19 +844,19 @@ public:
   struct BuildComponentArrays<TupleIndex, RT, RTs...>
   {
     static void exec(
-        std::array<BaseComponentContainer*, sizeof...(Ts)>& baseComponents,
+        const std::tuple<ComponentContainer<Ts>*...>& containers,
         std::tuple<typename ComponentContainer<Ts>::ComponentItem*...>& componentArrays)
     {
-      if (baseComponents[TupleIndex] != nullptr)
+      ComponentContainer<RT>* derived = std::get<TupleIndex>(containers);
+      if (derived != nullptr)
       {
-        std::get<TupleIndex>(componentArrays) =
-            dynamic_cast<ComponentContainer<RT>*>(baseComponents[TupleIndex])->getComponentArray();
+        std::get<TupleIndex>(componentArrays) = derived->getComponentArray();
       }
       else
       {
         std::get<TupleIndex>(componentArrays) = nullptr;
       }
-      BuildComponentArrays<TupleIndex + 1, RTs...>::exec(baseComponents, componentArrays);
+      BuildComponentArrays<TupleIndex + 1, RTs...>::exec(containers, componentArrays);
     }
   };
 
@@ -518,7 +864,7 @@ public:
   struct BuildComponentArrays<TupleIndex>
   {
     static void exec(
-        std::array<BaseComponentContainer*, sizeof...(Ts)>&,
+        const std::tuple<ComponentContainer<Ts>*...>&,
         std::tuple<typename ComponentContainer<Ts>::ComponentItem*...>&)
     {}
   };
@@ -530,14 +876,13 @@ public:
   struct BuildComponentArraysAndIndicesWithID<TupleIndex, RT, RTs...>
   {
     static void exec(
-        std::array<BaseComponentContainer*, sizeof...(Ts)>& baseComponents,
+        const std::tuple<ComponentContainer<Ts>*...>& containers,
         std::tuple<typename ComponentContainer<Ts>::ComponentItem*...>& componentArrays,
         std::array<int, sizeof...(Ts)>& indices, uint64_t entityID)
     {
-      if (baseComponents[TupleIndex] != nullptr)
+      ComponentContainer<RT>* derived = std::get<TupleIndex>(containers);
+      if (derived != nullptr)
       {
-        ComponentContainer<RT>* derived = dynamic_cast<ComponentContainer<RT>*>(baseComponents[TupleIndex]);
-
         std::get<TupleIndex>(componentArrays) = derived->getComponentArray();
         int foundIndex = derived->getComponentItemIndexWithSequence(entityID);
         indices[TupleIndex] = foundIndex;
@@ -548,7 +893,7 @@ public:
         indices[TupleIndex] = 0;
       }
       BuildComponentArraysAndIndicesWithID<TupleIndex + 1, RTs...>::exec(
-          baseComponents, componentArrays, indices, entityID);
+          containers, componentArrays, indices, entityID);
     }
   };
 
@@ -556,38 +901,86 @@ public:
   struct BuildComponentArraysAndIndicesWithID<TupleIndex>
   {
     static void exec(
-        std::array<BaseComponentContainer*, sizeof...(Ts)>&,
+        const std::tuple<ComponentContainer<Ts>*...>&,
         std::tuple<typename ComponentContainer<Ts>::ComponentItem*...>&,
         std::array<int, sizeof...(Ts)>&, uint64_t)
     {}
   };
 
+  /// Advances the per-container cursors to the first component whose sequence
+  /// is not less than \p entityID, and sets the index of each container's
+  /// component with sequence \p entityID (or -1 if there is none). Mirrors
+  /// BuildComponentArraysAndIndicesWithID for sorted batches of entity IDs.
   template <int TupleIndex, typename... RTs>
-  struct AddComponentsToGroupInputs;
+  struct GallopIndicesToID;
 
   template <int TupleIndex, typename RT, typename... RTs>
-  struct AddComponentsToGroupInputs<TupleIndex, RT, RTs...>
+  struct GallopIndicesToID<TupleIndex, RT, RTs...>
   {
-    static void exec(ESCoreBase& core, std::array<BaseComponentContainer*, sizeof...(Ts)>& baseComponents,
-                     std::tuple<ComponentGroup<Ts>...>& input)
+    static void exec(
+        const std::tuple<typename ComponentContainer<Ts>::ComponentItem*...>& componentArrays,
+        const std::array<int, sizeof...(Ts)>& componentSizes,
+        const std::array<bool, sizeof...(Ts)>& componentStatic,
+        std::array<int, sizeof...(Ts)>& cursors,
+        std::array<int, sizeof...(Ts)>& indices, uint64_t entityID)
     {
-      if (baseComponents[TupleIndex] != nullptr)
+      typename ComponentContainer<RT>::ComponentItem* array = std::get<TupleIndex>(componentArrays);
+      int arraySize = componentSizes[TupleIndex];
+
+      if (array == nullptr)
+      {
+        // Missing containers behave as they do in walkEntity.
+        indices[TupleIndex] = 0;
+      }
+      else if (componentStatic[TupleIndex])
       {
-        std::get<TupleIndex>(input).container 
-            = dynamic_cast<ComponentContainer<RT>*>(core.getComponentContainer(TemplateID<RT>::getID()));
+        indices[TupleIndex] = (arraySize > 0) ? 0 : -1;
       }
       else
       {
-        std::get<TupleIndex>(input).container = nullptr;
+        int cursor = gs_detail::gallopLowerBound(array, cursors[TupleIndex], arraySize, entityID);
+        cursors[TupleIndex] = cursor;
+        if (cursor != arraySize && array[cursor].sequence == entityID)
+          indices[TupleIndex] = cursor;
+        else
+          indices[TupleIndex] = -1;
       }
-      AddComponentsToGroupInputs<TupleIndex + 1, RTs...>::exec(core, baseComponents, input);
+
+      GallopIndicesToID<TupleIndex + 1, RTs...>::exec(
+          componentArrays, componentSizes, componentStatic, cursors, indices, entityID);
+    }
+  };
+
+  template <int TupleIndex>
+  struct GallopIndicesToID<TupleIndex>
+  {
+    static void exec(
+        const std::tuple<typename ComponentContainer<Ts>::ComponentItem*...>&,
+        const std::array<int, sizeof...(Ts)>&,
+        const std::array<bool, sizeof...(Ts)>&,
+        std::array<int, sizeof...(Ts)>&,
+        std::array<int, sizeof...(Ts)>&, uint64_t)
+    {}
+  };
+
+  template <int TupleIndex, typename... RTs>
+  struct AddComponentsToGroupInputs;
+
+  template <int TupleIndex, typename RT, typename... RTs>
+  struct AddComponentsToGroupInputs<TupleIndex, RT, RTs...>
+  {
+    static void exec(const std::tuple<ComponentContainer<Ts>*...>& containers,
+                     std::tuple<ComponentGroup<Ts>...>& input)
+    {
+      std::get<TupleIndex>(input).container = std::get<TupleIndex>(containers);
+      AddComponentsToGroupInputs<TupleIndex + 1, RTs...>::exec(containers, input);
     }
   };
 
   template <int TupleIndex>
   struct AddComponentsToGroupInputs<TupleIndex>
   {
-    static void exec(ESCoreBase& /* core */, std::array<BaseComponentContainer*, sizeof...(Ts)>& /* baseComponents */,
+    static void exec(const std::tuple<ComponentContainer<Ts>*...>& /* containers */,
                      std::tuple<ComponentGroup<Ts>...>& /* input */) {}
   };
 
@@ -635,7 +1028,7 @@ public:
         {
           if (isStatic && arraySize > 0)
           {
-            std::get<TupleIndex>(input) = &array[0].component;
+            std::get<TupleIndex>(input) = &array[0].get();
           }
           else
           {
@@ -645,7 +1038,7 @@ public:
         }
         else
         {
-          std::get<TupleIndex>(input) = &array[currentIndex].component;
+          std::get<TupleIndex>(input) = &array[currentIndex].get();
         }
       }
 
@@ -681,10 +1074,11 @@ public:
             return false;
         }
 
-        // Loop until we find a sequence that is not in our target.
-        while (array[currentIndex].sequence == targetSequence)
+        // Loop until we find a sequence that is not in our target. Unique
+        // components never have more than one component per sequence.
+        while (!IsUniqueComponent<RT>::value && array[currentIndex].sequence == targetSequence)
         {
-          std::get<TupleIndex>(input) = &array[currentIndex].component;
+          std::get<TupleIndex>(input) = &array[currentIndex].get();
           // We don't need to check return value of RecurseExecute since any
           // lower component would have returned false on the first call. The
           // result of the first call is cached in reachedEnd.
@@ -710,7 +1104,7 @@ public:
         // Loop over static array (we've already executed the first element above).
         for (int i = 1; i < arraySize; ++i)
         {
-          std::get<TupleIndex>(input) = &array[i].component;
+          std::get<TupleIndex>(input) = &array[i].get();
           // We don't need to check return value of RecurseExecute since any
           // lower component would have returned false on the first call. The
           // result of the first call is cached in reachedEnd.
@@ -815,15 +1209,24 @@ public:
           // Set value before we reassign currentIndex.
           std::get<TupleIndex>(input).components = &array[currentIndex];
 
-          // Loop until we find a sequence that is not in our target.
-          while (array[currentIndex].sequence == targetSequence)
+          if (IsUniqueComponent<RT>::value)
           {
             ++currentIndex;
-            ++numComponents;
-            if (currentIndex == arraySize)
+            numComponents = 1;
+            endOfArray = (currentIndex == arraySize);
+          }
+          else
+          {
+            // Loop until we find a sequence that is not in our target.
+            while (array[currentIndex].sequence == targetSequence)
             {
-              endOfArray = true;
-              break;
+              ++currentIndex;
+              ++numComponents;
+              if (currentIndex == arraySize)
+              {
+                endOfArray = true;
+                break;
+              }
             }
           }
 
@@ -888,6 +1291,23 @@ public:
   /// which may be optional.
   virtual bool isComponentOptional(uint64_t templateID) override {return false;}
 
+  /// Override and return true for the components this system is the only
+  /// writer of, e.g. {return WrittenComponents<CompPosition>(templateID);}.
+  /// Such components are written in place through write() instead of being
+  /// copied through ComponentGroup::modify and the modification queue. Each
+  /// walk claims write access to them from the core, which throws if
+  /// another system claimed them since the last renormalize.
+  virtual bool isComponentWritten(uint64_t /* templateID */) {return false;}
+
+  /// Override and return true for components whose changes should trigger
+  /// this system, e.g. {return Changed<CompTransform>(templateID);}.
+  /// walkComponents then only visits entities for which one of these
+  /// components was added or changed (by renormalize or an in place write)
+  /// since this system last walked the same container. Changes must be
+  /// tracked for these components, see TrackComponentChanges. walkEntity and
+  /// walkEntities are not filtered.
+  virtual bool isChangeFiltered(uint64_t /* templateID */) {return false;}
+
   /// This function gets called before we start walking components from the
   /// walkComponents function.
   virtual void preWalkComponents(ESCoreBase& core)            {}
@@ -895,6 +1315,55 @@ public:
   /// This function gets called after we finish walking components from the
   /// walkComponents function.
   virtual void postWalkComponents(ESCoreBase& core)           {}
+
+protected:
+  /// Mutable access to a component passed to execute. The change is visible
+  /// to systems walked after this one right away, and is not undone by
+  /// renormalize, but modifications queued for the same component still
+  /// apply over it.
+  template <typename T>
+  T* write(const T* component) const
+  {
+    static_assert(   !TrackComponentChanges<T>::value
+                  || (!std::is_empty<T>::value && !IsOutOfLineComponent<T>::value),
+                  "Use write(group, componentNum) for tracked out of line components.");
+
+    checkWritten(query_detail::TypeIndex<T, Ts...>::value);
+    if (TrackComponentChanges<T>::value)
+    {
+      ComponentContainer<T>* container = mQuery.template getContainer<T>();
+      const char* first = reinterpret_cast<const char*>(&container->getComponentArray()[0].get());
+      size_t index = static_cast<size_t>(reinterpret_cast<const char*>(component) - first)
+                     / sizeof(typename ComponentContainer<T>::ComponentItem);
+      container->noteWrite(index);
+    }
+    return const_cast<T*>(component);
+  }
+
+  /// Same as above, for groupExecute.
+  template <typename T>
+  T& write(const ComponentGroup<T>& group, size_t componentNum = 0) const
+  {
+    checkWritten(query_detail::TypeIndex<T, Ts...>::value);
+    if (TrackComponentChanges<T>::value && group.container != nullptr)
+      group.container->noteWrite(group.containerIndex + componentNum);
+    return group.components[componentNum].get();
+  }
+
+  Query<Ts...> mQuery;  ///< Containers resolved from the last core we walked.
+  std::array<bool, sizeof...(Ts)> mWritten; ///< isComponentWritten, as of the last walk.
+
+  /// Change filter state: container and change version last walked, per
+  /// component.
+  std::array<const BaseComponentContainer*, sizeof...(Ts)> mChangeContainers;
+  std::array<uint64_t, sizeof...(Ts)> mChangeSeen;
+  std::vector<uint64_t>               mChangedSequences;
+
+  /// Archetype tables matching this system, as (table, column per component).
+  /// Valid for mArchetypeBuild of mArchetypeIndex.
+  std::vector<std::pair<size_t, std::array<int, sizeof...(Ts)>>> mArchetypeMatches;
+  const ArchetypeIndex* mArchetypeIndex;
+  uint64_t              mArchetypeBuild;
 };
 
 namespace optional_components_impl
@@ -927,6 +1396,20 @@ bool OptionalComponents(uint64_t templateID)
   return optional_components_impl::OptionalCompImpl<RTs...>::exec(templateID);
 }
 
+/// Helper for GenericSystem::isComponentWritten.
+template <typename... RTs>
+bool WrittenComponents(uint64_t templateID)
+{
+  return optional_components_impl::OptionalCompImpl<RTs...>::exec(templateID);
+}
+
+/// Helper for GenericSystem::isChangeFiltered.
+template <typename... RTs>
+bool Changed(uint64_t templateID)
+{
+  return optional_components_impl::OptionalCompImpl<RTs...>::exec(templateID);
+}
+
 } // namespace CPM_ES_NS
 
 #endif
@@ -0,0 +1,89 @@
+#ifndef IAUNS_ENTITY_SYSTEM_PREFAB_HPP
+#define IAUNS_ENTITY_SYSTEM_PREFAB_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "src/TemplateID.hpp"
+#include "src/PrefabComponents.hpp"
+
+namespace CPM_ES_NS {
+
+class ESCoreBase;
+
+/// Copies of all components of a template entity, for spawning many
+/// entities like it at once:
+///
+///   Prefab enemy = core.createPrefab(templateEntity);
+///   enemy.setOverride<CompPosition>(
+///       [](uint64_t entityID, size_t instance, CompPosition& p)
+///       {p.position = spawnPoint(instance);});
+///   uint64_t first = core.instantiatePrefab(enemy, 10000);
+///
+/// Instead of one addComponent per component, with a container lookup
+/// each, every container receives one run of components for all new
+/// entities, already sorted by entity ID. The prefab does not change when
+/// the template entity does, and can be instantiated any number of times,
+/// in any core holding containers for all of its component types.
+class Prefab
+{
+public:
+  Prefab() : mSourceEntityID(0) {}
+
+  /// Entity the components were captured from.
+  uint64_t getSourceEntityID() const {return mSourceEntityID;}
+
+  /// Number of component types captured.
+  size_t getNumComponentTypes() const {return mParts.size();}
+
+  /// Returns the captured components of type T, which may be edited before
+  /// instantiating, or nullptr if the source entity held none.
+  template <typename T>
+  std::vector<T>* getComponents()
+  {
+    PrefabComponents<T>* part = findPart<T>();
+    return part != nullptr ? &part->components : nullptr;
+  }
+
+  /// Calls \p fn on every copy of a component of type T before it is
+  /// queued, e.g. to place each new entity. Replaces the previous override
+  /// of T. Throws if no components of type T were captured.
+  template <typename T>
+  void setOverride(typename PrefabComponents<T>::Override fn)
+  {
+    PrefabComponents<T>* part = findPart<T>();
+    if (part == nullptr)
+    {
+      std::cerr << "cpm-entity-system: Attempting to override a component type the prefab does not hold." << std::endl;
+      throw std::runtime_error("Prefab does not hold the overridden component type.");
+    }
+    part->overrideComponent = fn;
+  }
+
+private:
+  friend class ESCoreBase;
+
+  template <typename T>
+  PrefabComponents<T>* findPart()
+  {
+    uint64_t templateID = TemplateID<typename std::decay<T>::type>::getID();
+    for (std::pair<uint64_t, std::unique_ptr<BasePrefabComponents>>& part : mParts)
+    {
+      if (part.first == templateID)
+        return static_cast<PrefabComponents<T>*>(part.second.get());
+    }
+    return nullptr;
+  }
+
+  uint64_t mSourceEntityID;
+  std::vector<std::pair<uint64_t, std::unique_ptr<BasePrefabComponents>>> mParts; ///< By template ID.
+};
+
+} // namespace CPM_ES_NS
+
+#endif
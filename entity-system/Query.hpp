@@ -0,0 +1,145 @@
+#ifndef IAUNS_ENTITY_SYSTEM_QUERY_HPP
+#define IAUNS_ENTITY_SYSTEM_QUERY_HPP
+
+#include <array>
+#include <tuple>
+#include <type_traits>
+#include "ESCoreBase.hpp"
+#include "src/ComponentContainer.hpp"
+#include "src/TemplateID.hpp"
+
+namespace CPM_ES_NS {
+
+namespace query_detail
+{
+
+/// Index of T within Ts. Fails to compile if T is not one of Ts.
+template <typename T, typename... Ts>
+struct TypeIndex;
+
+template <typename T, typename... Ts>
+struct TypeIndex<T, T, Ts...> : std::integral_constant<int, 0> {};
+
+template <typename T, typename U, typename... Ts>
+struct TypeIndex<T, U, Ts...> : std::integral_constant<int, 1 + TypeIndex<T, Ts...>::value> {};
+
+} // namespace query_detail
+
+/// A resolved set of component containers for the component types Ts, bound
+/// to one core. Resolving containers requires a map lookup and a dynamic_cast
+/// per component type. A Query performs these once and caches the results
+/// until containers are added to or deleted from the core it is bound to.
+/// Containers that do not exist (yet) are stored as nullptr.
+///
+/// Component arrays are *not* cached: they move whenever a container is
+/// renormalized. Always fetch them from the containers.
+template <typename... Ts>
+class Query
+{
+public:
+  typedef std::array<BaseComponentContainer*, sizeof...(Ts)> BaseContainers;
+  typedef std::tuple<ComponentContainer<Ts>*...>             Containers;
+
+  Query() :
+      mCore(nullptr),
+      mContainerVersion(0)
+  {
+    mBaseContainers.fill(nullptr);
+  }
+
+  explicit Query(ESCoreBase& core) :
+      mCore(nullptr),
+      mContainerVersion(0)
+  {
+    bind(core);
+  }
+
+  /// Binds the query to \p core. Containers are only re-resolved if the query
+  /// was bound to a different core, or if containers have been added to or
+  /// deleted from the core since they were last resolved. Deferred
+  /// renormalizes of the containers are performed (see
+  /// ESCoreBase::setLazyRenormalize).
+  void bind(ESCoreBase& core)
+  {
+    if (mCore != &core || mContainerVersion != core.getContainerVersion())
+    {
+      resolve(core);
+    }
+    else
+    {
+      for (BaseComponentContainer* cont : mBaseContainers)
+      {
+        if (cont != nullptr)
+          cont->flushRenormalize();
+      }
+    }
+  }
+
+  /// Returns true if the query is bound and up to date with its core.
+  bool isValid() const
+  {
+    return mCore != nullptr && mContainerVersion == mCore->getContainerVersion();
+  }
+
+  /// Forces the containers to be looked up again on the next call to bind.
+  void invalidate()
+  {
+    mCore = nullptr;
+  }
+
+  ESCoreBase* getCore() const {return mCore;}
+
+  /// Untyped containers, in the order of Ts. Entries may be nullptr.
+  const BaseContainers& getBaseContainers() const {return mBaseContainers;}
+
+  /// Typed containers, in the order of Ts. Entries may be nullptr.
+  const Containers& getContainers() const {return mContainers;}
+
+  /// Retrieves the typed container for component type T. May be nullptr.
+  template <typename T>
+  ComponentContainer<T>* getContainer() const
+  {
+    return std::get<query_detail::TypeIndex<T, Ts...>::value>(mContainers);
+  }
+
+private:
+
+  void resolve(ESCoreBase& core)
+  {
+    mCore = &core;
+    mContainerVersion = core.getContainerVersion();
+    mBaseContainers = {{ core.getComponentContainer(TemplateID<Ts>::getID())... }};
+    CastContainers<0, Ts...>::exec(mBaseContainers, mContainers);
+  }
+
+  template <int TupleIndex, typename... RTs>
+  struct CastContainers;
+
+  template <int TupleIndex, typename RT, typename... RTs>
+  struct CastContainers<TupleIndex, RT, RTs...>
+  {
+    static void exec(const BaseContainers& base, Containers& typed)
+    {
+      if (base[TupleIndex] != nullptr)
+        std::get<TupleIndex>(typed) = dynamic_cast<ComponentContainer<RT>*>(base[TupleIndex]);
+      else
+        std::get<TupleIndex>(typed) = nullptr;
+      CastContainers<TupleIndex + 1, RTs...>::exec(base, typed);
+    }
+  };
+
+  template <int TupleIndex>
+  struct CastContainers<TupleIndex>
+  {
+    static void exec(const BaseContainers&, Containers&) {}
+  };
+
+  ESCoreBase*     mCore;              ///< Core the containers were resolved from.
+  uint64_t        mContainerVersion;  ///< Core's container version at resolve time.
+  BaseContainers  mBaseContainers;
+  Containers      mContainers;
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef IAUNS_ENTITY_SYSTEM_REACTIVESYSTEM_HPP
+#define IAUNS_ENTITY_SYSTEM_REACTIVESYSTEM_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include "src/TemplateID.hpp"
+#include "src/ComponentContainer.hpp"
+
+namespace CPM_ES_NS {
+
+class ESCoreBase;
+
+/// Type erased interface of ReactiveSystem, see ESCoreBase::addReactiveSystem.
+class BaseReactiveSystem
+{
+public:
+  BaseReactiveSystem()          {}
+  virtual ~BaseReactiveSystem() {}
+
+  /// TemplateID of the component type the system reacts to.
+  virtual uint64_t getComponentTemplateID() const = 0;
+
+  /// Hands the batches recorded by \p container to the system.
+  virtual void react(ESCoreBase& core, BaseComponentContainer* container) = 0;
+};
+
+/// Receives, after each renormalize, all components of type T that it added
+/// and removed, as contiguous arrays of (entity ID, component) items:
+///
+///   class SpawnSystem : public ReactiveSystem<CompMesh>
+///   {
+///     void onAdded(ESCoreBase& core, const ComponentItem* items, size_t count) override
+///     {
+///       for (size_t i = 0; i < count; ++i)
+///         upload(items[i].sequence, items[i].get());
+///     }
+///   };
+///
+///   core.addReactiveSystem(&spawn);
+///
+/// Unlike componentConstruct / componentDestruct, which are still called
+/// for every component, a handler sees the whole batch at once and can
+/// process it in bulk or split it across threads. Added components are
+/// passed as they were after componentConstruct, removed ones as they were
+/// before componentDestruct, in the order they were queued. A component
+/// added and removed in the same frame appears in both batches. Empty
+/// batches are not passed. Changes the handlers queue are applied by the
+/// next renormalize.
+template <typename T>
+class ReactiveSystem : public BaseReactiveSystem
+{
+public:
+  typedef typename ComponentContainer<T>::ComponentItem ComponentItem;
+
+  uint64_t getComponentTemplateID() const override {return TemplateID<T>::getID();}
+
+  void react(ESCoreBase& core, BaseComponentContainer* container) override
+  {
+    ComponentContainer<T>* concrete = dynamic_cast<ComponentContainer<T>*>(container);
+    if (concrete == nullptr)
+      return;
+
+    const std::vector<ComponentItem>& added = concrete->getAddedBatch();
+    if (!added.empty())
+      onAdded(core, &added[0], added.size());
+
+    const std::vector<ComponentItem>& removed = concrete->getRemovedBatch();
+    if (!removed.empty())
+      onRemoved(core, &removed[0], removed.size());
+  }
+
+  virtual void onAdded(ESCoreBase& /* core */, const ComponentItem* /* items */, size_t /* count */)   {}
+  virtual void onRemoved(ESCoreBase& /* core */, const ComponentItem* /* items */, size_t /* count */) {}
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,250 @@
+#ifndef IAUNS_ENTITY_SYSTEM_ADAPTIVECOMPONENTCONTAINER_HPP
+#define IAUNS_ENTITY_SYSTEM_ADAPTIVECOMPONENTCONTAINER_HPP
+
+#include "ComponentContainer.hpp"
+#include "SparseSequenceIndex.hpp"
+
+namespace CPM_ES_NS {
+
+/// Storage strategies of AdaptiveComponentContainer.
+enum ADAPTIVE_STORAGE
+{
+  STORAGE_SORTED_VECTOR,  ///< As ComponentContainer.
+  STORAGE_SPARSE_SET      ///< As SparseComponentContainer.
+};
+
+/// Thresholds AdaptiveComponentContainer switches storage on. Rates are
+/// per renormalize, averaged over recent renormalizes. Each strategy is
+/// entered and left at different thresholds so that a workload close to a
+/// threshold does not switch back and forth.
+struct AdaptivePolicy
+{
+  AdaptivePolicy() :
+      smoothing(0.25),
+      minFramesBetweenSwitches(8),
+      sparseEnterLookups(256.0),
+      sparseExitLookups(64.0),
+      sparseLookupsPerWalk(16.0)
+  {}
+
+  double    smoothing;                ///< Weight of the latest renormalize in the averages.
+  uint64_t  minFramesBetweenSwitches; ///< Renormalizes to wait after a switch.
+  double    sparseEnterLookups;       ///< Lookups to switch to the sparse set.
+  double    sparseExitLookups;        ///< Lookups to leave the sparse set.
+  double    sparseLookupsPerWalk;     ///< Lookups per walk needed for the sparse set.
+};
+
+/// Access statistics gathered by AdaptiveComponentContainer.
+struct AdaptiveContainerStats
+{
+  AdaptiveContainerStats() :
+      storage(STORAGE_SORTED_VECTOR),
+      numSwitches(0),
+      frames(0),
+      lastSwitchFrame(0),
+      size(0),
+      addsPerFrame(0.0),
+      removesPerFrame(0.0),
+      lookupsPerFrame(0.0),
+      walksPerFrame(0.0)
+  {}
+
+  ADAPTIVE_STORAGE  storage;          ///< Current storage strategy.
+  uint64_t          numSwitches;      ///< Storage switches so far.
+  uint64_t          frames;           ///< Renormalizes so far.
+  uint64_t          lastSwitchFrame;  ///< Renormalize of the last switch.
+  size_t            size;             ///< Components after the last renormalize.
+  double            addsPerFrame;
+  double            removesPerFrame;
+  double            lookupsPerFrame;  ///< Lookups by sequence, e.g. walkEntity.
+  double            walksPerFrame;    ///< Walks of the entire container.
+};
+
+/// Component container that picks its storage strategy from the way it is
+/// used. It counts additions, removals, lookups by sequence and walks, and
+/// at renormalize switches between a plain sorted vector and a sorted vector
+/// with a sparse index (as SparseComponentContainer), according to an
+/// AdaptivePolicy. The components always live in the sorted array of the
+/// ComponentContainer; the sparse index is a separate member that is only
+/// kept up to date while in use. Systems always walk the same sorted array,
+/// so switches are invisible to them.
+///
+/// Many lookups relative to walks select the sparse set. No strategy beats
+/// the sorted vector under churn, so additions and removals are counted but
+/// do not select a strategy. The statistics and the current strategy are
+/// available through getStats. Static containers do not adapt.
+///
+/// Statistics are gathered per renormalize, so the container stays dirty and
+/// is renormalized every frame, whether or not it changed.
+template <typename T>
+class AdaptiveComponentContainer : public ComponentContainer<T>
+{
+public:
+  typedef ComponentContainer<T>                 Base;
+  typedef typename Base::ComponentItem          ComponentItem;
+
+  AdaptiveComponentContainer() :
+      mFrameAdds(0),
+      mFrameLookups(0),
+      mFrameWalks(0)
+  {}
+  virtual ~AdaptiveComponentContainer() {}
+
+  void setPolicy(const AdaptivePolicy& policy)  {mPolicy = policy;}
+  const AdaptivePolicy& getPolicy() const       {return mPolicy;}
+
+  const AdaptiveContainerStats& getStats() const {return mStats;}
+  ADAPTIVE_STORAGE getStorage() const            {return mStats.storage;}
+
+  void addComponent(uint64_t sequence, const T& component) override
+  {
+    ++mFrameAdds;
+    Base::addComponent(sequence, component);
+  }
+
+  void addComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted = false) override
+  {
+    mFrameAdds += count;
+    Base::addComponents(items, count, sorted);
+  }
+
+  void renormalize(bool stableSort) override
+  {
+    if (this->isStatic())
+    {
+      Base::renormalize(stableSort);
+      return;
+    }
+
+    size_t removes = this->mRemovals.size();
+    uint64_t layoutVersion = this->getLayoutVersion();
+    Base::renormalize(stableSort);
+    if (mStats.storage == STORAGE_SPARSE_SET && layoutVersion != this->getLayoutVersion())
+      rebuildIndex();
+
+    updateStats(removes);
+    ADAPTIVE_STORAGE storage = chooseStorage();
+    if (storage != mStats.storage)
+      switchStorage(storage);
+
+    // Frames without changes still count, stay on the core's dirty list.
+    this->markDirty();
+  }
+
+  void removeAllImmediately() override
+  {
+    Base::removeAllImmediately();
+    mIndex.clear();
+  }
+
+  void noteWalk() const override {++mFrameWalks;}
+
+  int getComponentItemIndexWithSequence(uint64_t sequence) const override
+  {
+    ++mFrameLookups;
+    int slot = findSlot(sequence);
+    if (slot == SparseSequenceIndex::NotIndexed)
+      return Base::getComponentItemIndexWithSequence(sequence);
+    return slot;
+  }
+
+  ComponentItem* getComponentItemWithSequence(uint64_t sequence) override
+  {
+    ++mFrameLookups;
+    int slot = findSlot(sequence);
+    if (slot == SparseSequenceIndex::NotIndexed)
+      return Base::getComponentItemWithSequence(sequence);
+    else if (slot == SparseSequenceIndex::NotFound)
+      return nullptr;
+    return &this->mComponents[slot];
+  }
+
+  std::pair<const T*, size_t> getComponent(uint64_t sequence) const override
+  {
+    ++mFrameLookups;
+    int slot = findSlot(sequence);
+    if (slot == SparseSequenceIndex::NotIndexed)
+      return Base::getComponent(sequence);
+    else if (slot == SparseSequenceIndex::NotFound)
+      return std::make_pair(nullptr, 0);
+    return std::make_pair(&this->mComponents[slot].get(), static_cast<size_t>(slot));
+  }
+
+protected:
+
+  /// Slot from the sparse index, or NotIndexed when it is not in use.
+  int findSlot(uint64_t sequence) const
+  {
+    if (mStats.storage != STORAGE_SPARSE_SET || this->isStatic())
+      return SparseSequenceIndex::NotIndexed;
+    return mIndex.find(sequence);
+  }
+
+  void rebuildIndex()
+  {
+    if (this->mLastSortedSize == 0)
+    {
+      mIndex.clear();
+      return;
+    }
+    mIndex.rebuild(&this->mComponents[0], static_cast<size_t>(this->mLastSortedSize));
+  }
+
+  void updateStats(size_t removes)
+  {
+    double a = mPolicy.smoothing;
+    if (mStats.frames == 0)
+      a = 1.0;
+
+    mStats.addsPerFrame    += a * (static_cast<double>(mFrameAdds)    - mStats.addsPerFrame);
+    mStats.removesPerFrame += a * (static_cast<double>(removes)       - mStats.removesPerFrame);
+    mStats.lookupsPerFrame += a * (static_cast<double>(mFrameLookups) - mStats.lookupsPerFrame);
+    mStats.walksPerFrame   += a * (static_cast<double>(mFrameWalks)   - mStats.walksPerFrame);
+    mStats.size = static_cast<size_t>(this->mLastSortedSize);
+    ++mStats.frames;
+
+    mFrameAdds = 0;
+    mFrameLookups = 0;
+    mFrameWalks = 0;
+  }
+
+  ADAPTIVE_STORAGE chooseStorage() const
+  {
+    ADAPTIVE_STORAGE current = mStats.storage;
+    if (   mStats.numSwitches > 0
+        && mStats.frames - mStats.lastSwitchFrame < mPolicy.minFramesBetweenSwitches)
+      return current;
+
+    double lookups = mStats.lookupsPerFrame;
+    double walkLookups = mStats.walksPerFrame * mPolicy.sparseLookupsPerWalk;
+    if (current == STORAGE_SPARSE_SET ? (lookups >= mPolicy.sparseExitLookups && 2.0 * lookups >= walkLookups)
+                                      : (lookups >= mPolicy.sparseEnterLookups && lookups >= walkLookups))
+      return STORAGE_SPARSE_SET;
+
+    return STORAGE_SORTED_VECTOR;
+  }
+
+  /// Called right after renormalize, when nothing is pending.
+  void switchStorage(ADAPTIVE_STORAGE storage)
+  {
+    if (storage == STORAGE_SPARSE_SET)
+      rebuildIndex();
+    else
+      mIndex.clear();
+
+    mStats.storage = storage;
+    mStats.lastSwitchFrame = mStats.frames;
+    ++mStats.numSwitches;
+  }
+
+  AdaptivePolicy          mPolicy;
+  AdaptiveContainerStats  mStats;
+  SparseSequenceIndex     mIndex;         ///< Used in STORAGE_SPARSE_SET.
+  size_t                  mFrameAdds;     ///< Since the last renormalize.
+  mutable size_t          mFrameLookups;  ///< Since the last renormalize.
+  mutable size_t          mFrameWalks;    ///< Since the last renormalize.
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,375 @@
+#include "ArchetypeIndex.hpp"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace CPM_ES_NS {
+
+int ArchetypeIndex::Table::findColumn(uint64_t templateID) const
+{
+  auto it = std::lower_bound(signature.begin(), signature.end(), templateID);
+  if (it != signature.end() && *it == templateID)
+    return static_cast<int>(it - signature.begin());
+  else
+    return -1;
+}
+
+ArchetypeIndex::ArchetypeIndex() :
+    mContainerVersion(0),
+    mBuildVersion(0),
+    mBuilt(false)
+{
+}
+
+void ArchetypeIndex::clear()
+{
+  mTables.clear();
+  mLayoutVersions.clear();
+  mBuilt = false;
+  ++mBuildVersion;
+}
+
+bool ArchetypeIndex::isCurrent(const BaseComponentContainer* container) const
+{
+  auto it = mLayoutVersions.find(container);
+  if (it == mLayoutVersions.end())
+    return false;
+  return it->second == container->getLayoutVersion();
+}
+
+bool ArchetypeIndex::needsRebuild(const std::map<uint64_t, BaseComponentContainer*>& containers,
+                                  uint64_t containerVersion) const
+{
+  if (!isCurrent(containerVersion))
+    return true;
+
+  for (auto it = containers.begin(); it != containers.end(); ++it)
+    if (!isCurrent(it->second))
+      return true;
+
+  return false;
+}
+
+namespace {
+
+/// Number of components of \p sequence in \p sequences, starting at \p i.
+size_t runLength(const std::vector<uint64_t>& sequences, size_t i, uint64_t sequence)
+{
+  size_t end = i;
+  while (end < sequences.size() && sequences[end] == sequence)
+    ++end;
+  return end - i;
+}
+
+/// Length of the common prefix of \p a and \p b, both \p size long.
+size_t matchingPrefix(const uint64_t* a, const uint64_t* b, size_t size)
+{
+  const size_t chunk = 64;
+  size_t i = 0;
+  while (i + chunk <= size && std::memcmp(a + i, b + i, chunk * sizeof(uint64_t)) == 0)
+    i += chunk;
+  while (i < size && a[i] == b[i])
+    ++i;
+  return i;
+}
+
+/// Removes the elements at \p removed (ascending, the last entry being the
+/// size of \p values) from \p values.
+template <typename T>
+void compactRows(std::vector<T>& values, const std::vector<size_t>& removed)
+{
+  size_t write = removed.front();
+  for (size_t r = 0; r + 1 < removed.size(); ++r)
+  {
+    size_t begin = removed[r] + 1;
+    size_t end = removed[r + 1];
+    std::copy(values.begin() + begin, values.begin() + end, values.begin() + write);
+    write += end - begin;
+  }
+  values.resize(write);
+}
+
+/// Inserts value(k) at row \p inserted[k] of \p values, where \p inserted
+/// holds ascending rows in the result. Rows move up from the back.
+template <typename T, typename Value>
+void insertRows(std::vector<T>& values, const std::vector<size_t>& inserted, Value value)
+{
+  size_t read = values.size();
+  values.resize(values.size() + inserted.size());
+  size_t write = values.size();
+  for (size_t k = inserted.size(); k > 0; --k)
+  {
+    while (write > inserted[k - 1] + 1)
+      values[--write] = values[--read];
+    values[--write] = value(k - 1);
+  }
+}
+
+int indexOf(const std::vector<uint64_t>& sequences, uint64_t sequence)
+{
+  return static_cast<int>(std::lower_bound(sequences.begin(), sequences.end(), sequence) - sequences.begin());
+}
+
+bool contains(const std::vector<uint64_t>& sequences, uint64_t sequence)
+{
+  return std::binary_search(sequences.begin(), sequences.end(), sequence);
+}
+
+} // namespace
+
+size_t ArchetypeIndex::findOrAddTable(const std::vector<uint64_t>& signature)
+{
+  auto found = mTableLookup.find(signature);
+  if (found != mTableLookup.end())
+    return found->second;
+
+  size_t tableIndex = mTables.size();
+  mTableLookup.insert(std::make_pair(signature, tableIndex));
+  mTables.push_back(Table());
+  mTables.back().signature = signature;
+  mTables.back().columns.resize(signature.size());
+  return tableIndex;
+}
+
+void ArchetypeIndex::build(const std::map<uint64_t, BaseComponentContainer*>& containers,
+                           uint64_t containerVersion)
+{
+  // Containers taking part in signatures. std::map iterates in template ID
+  // order, so signatures built from participants are sorted as well. A
+  // different set of participants rebuilds all tables.
+  bool full = !isCurrent(containerVersion);
+  size_t numParticipants = 0;
+  for (auto it = containers.begin(); it != containers.end(); ++it)
+  {
+    if (it->second->isStatic())
+      continue;
+    if (numParticipants >= mParticipants.size()
+        || mParticipants[numParticipants].container != it->second)
+      full = true;
+    ++numParticipants;
+  }
+  if (numParticipants != mParticipants.size())
+    full = true;
+
+  bool tablesChanged = false;
+  if (full)
+  {
+    tablesChanged = !mTables.empty();
+    mTables.clear();
+    mTableLookup.clear();
+    mParticipants.clear();
+    for (auto it = containers.begin(); it != containers.end(); ++it)
+    {
+      if (it->second->isStatic())
+        continue;
+      Participant participant;
+      participant.templateID = it->first;
+      participant.container  = it->second;
+      mParticipants.push_back(participant);
+    }
+  }
+
+  // Diff the components of each changed container against its sequences at
+  // the last build. Entities whose number of components changed shift the
+  // indices of all later entities; entities that gained or lost all of
+  // their components of a type also move to another table.
+  std::vector<std::vector<std::pair<uint64_t, int>>> shifts(mParticipants.size());
+  std::vector<std::vector<std::pair<uint64_t, bool>>> presence(mParticipants.size());  // (sequence, added)
+  std::vector<uint64_t> current;
+  for (size_t p = 0; p < mParticipants.size(); ++p)
+  {
+    Participant& participant = mParticipants[p];
+    BaseComponentContainer* cont = participant.container;
+    uint64_t from = 0;
+    if (!full)
+    {
+      auto found = mLayoutVersions.find(cont);
+      if (found != mLayoutVersions.end())
+        from = cont->getLayoutChangedFrom(found->second);
+    }
+    if (from == std::numeric_limits<uint64_t>::max())
+      continue;
+
+    // Components below the first changed sequence did not move.
+    std::vector<uint64_t>& previous = participant.sequences;
+    size_t first = static_cast<size_t>(indexOf(previous, from));
+    current.clear();
+    cont->appendSequences(static_cast<int>(first), current);
+
+    size_t i = first;
+    size_t j = 0;
+    for (;;)
+    {
+      // Unchanged entities line up one to one, only shifted.
+      size_t same = matchingPrefix(previous.data() + i, current.data() + j,
+                                   std::min(previous.size() - i, current.size() - j));
+      i += same;
+      j += same;
+      if (i == previous.size() && j == current.size())
+        break;
+
+      uint64_t sequence;
+      if (i == previous.size())
+        sequence = current[j];
+      else if (j == current.size())
+        sequence = previous[i];
+      else
+        sequence = std::min(previous[i], current[j]);
+
+      // Components of the changed entity that already lined up count for
+      // both sides.
+      size_t matched = 0;
+      while (matched < i - first && previous[i - matched - 1] == sequence)
+        ++matched;
+      size_t before = matched + runLength(previous, i, sequence);
+      size_t after  = matched + runLength(current, j, sequence);
+      shifts[p].push_back(std::make_pair(sequence, static_cast<int>(after) - static_cast<int>(before)));
+      if (before == 0 || after == 0)
+        presence[p].push_back(std::make_pair(sequence, after > 0));
+      i += before - matched;
+      j += after - matched;
+    }
+
+    if (first == 0)
+    {
+      previous.swap(current);
+    }
+    else
+    {
+      previous.resize(first);
+      previous.insert(previous.end(), current.begin(), current.end());
+    }
+  }
+
+  mLayoutVersions.clear();
+  for (auto it = containers.begin(); it != containers.end(); ++it)
+    mLayoutVersions[it->second] = it->second->getLayoutVersion();
+  mContainerVersion = containerVersion;
+  mBuilt = true;
+
+  // Work out the old and new table of every entity that changed signature.
+  // Presence in the other containers is the same before and after.
+  std::vector<std::vector<uint64_t>> removals(mTables.size());
+  std::vector<std::vector<uint64_t>> insertions(mTables.size());
+  std::vector<uint64_t> oldSignature;
+  std::vector<uint64_t> newSignature;
+  std::vector<size_t> cursors(mParticipants.size(), 0);
+  for (;;)
+  {
+    uint64_t sequence = std::numeric_limits<uint64_t>::max();
+    for (size_t p = 0; p < mParticipants.size(); ++p)
+      if (cursors[p] < presence[p].size())
+        sequence = std::min(sequence, presence[p][cursors[p]].first);
+    if (sequence == std::numeric_limits<uint64_t>::max())
+      break;
+
+    oldSignature.clear();
+    newSignature.clear();
+    for (size_t p = 0; p < mParticipants.size(); ++p)
+    {
+      bool before;
+      bool after;
+      if (cursors[p] < presence[p].size() && presence[p][cursors[p]].first == sequence)
+      {
+        after  = presence[p][cursors[p]].second;
+        before = !after;
+        ++cursors[p];
+      }
+      else
+      {
+        before = after = !full && contains(mParticipants[p].sequences, sequence);
+      }
+      if (before)
+        oldSignature.push_back(mParticipants[p].templateID);
+      if (after)
+        newSignature.push_back(mParticipants[p].templateID);
+    }
+
+    if (!oldSignature.empty())
+      removals[mTableLookup.find(oldSignature)->second].push_back(sequence);
+    if (!newSignature.empty())
+    {
+      size_t tableIndex = findOrAddTable(newSignature);
+      if (tableIndex >= insertions.size())
+      {
+        insertions.resize(tableIndex + 1);
+        tablesChanged = true;
+      }
+      insertions[tableIndex].push_back(sequence);
+    }
+  }
+
+  std::vector<size_t> columnParticipants;
+  std::vector<size_t> removedRows;
+  std::vector<size_t> insertedRows;
+  for (size_t t = 0; t < mTables.size(); ++t)
+  {
+    Table& table = mTables[t];
+    columnParticipants.clear();
+    for (uint64_t templateID : table.signature)
+    {
+      size_t p = 0;
+      while (mParticipants[p].templateID != templateID)
+        ++p;
+      columnParticipants.push_back(p);
+    }
+
+    // Drop the rows of entities that left this table. Rows between two
+    // removed ones move as a block.
+    if (t < removals.size() && !removals[t].empty())
+    {
+      removedRows.clear();
+      for (uint64_t entity : removals[t])
+        removedRows.push_back(static_cast<size_t>(indexOf(table.entities, entity)));
+      removedRows.push_back(table.entities.size());
+      compactRows(table.entities, removedRows);
+      for (std::vector<int>& column : table.columns)
+        compactRows(column, removedRows);
+    }
+
+    // Shift the indices of the remaining rows past every changed entity
+    // before them. Rows before the first changed entity keep their indices.
+    for (size_t c = 0; c < table.columns.size(); ++c)
+    {
+      const std::vector<std::pair<uint64_t, int>>& shift = shifts[columnParticipants[c]];
+      if (shift.empty())
+        continue;
+
+      std::vector<int>& column = table.columns[c];
+      size_t row = std::upper_bound(table.entities.begin(), table.entities.end(), shift.front().first)
+                   - table.entities.begin();
+      int delta = 0;
+      for (size_t next = 0; next < shift.size() && row < table.entities.size(); ++next)
+      {
+        delta += shift[next].second;
+        uint64_t end = (next + 1 < shift.size()) ? shift[next + 1].first : std::numeric_limits<uint64_t>::max();
+        for (; row < table.entities.size() && table.entities[row] <= end; ++row)
+          column[row] += delta;
+      }
+    }
+
+    // Insert the rows of entities that joined this table. Only rows after
+    // the first new one move.
+    if (t < insertions.size() && !insertions[t].empty())
+    {
+      const std::vector<uint64_t>& added = insertions[t];
+      insertedRows.clear();
+      for (size_t k = 0; k < added.size(); ++k)
+        insertedRows.push_back(static_cast<size_t>(indexOf(table.entities, added[k])) + k);
+
+      for (size_t c = 0; c < table.columns.size(); ++c)
+      {
+        const std::vector<uint64_t>& sequences = mParticipants[columnParticipants[c]].sequences;
+        insertRows(table.columns[c], insertedRows,
+                   [&](size_t k) {return indexOf(sequences, added[k]);});
+      }
+      insertRows(table.entities, insertedRows, [&](size_t k) {return added[k];});
+    }
+  }
+
+  if (tablesChanged)
+    ++mBuildVersion;
+}
+
+} // namespace CPM_ES_NS
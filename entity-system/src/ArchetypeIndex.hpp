@@ -0,0 +1,105 @@
+#ifndef IAUNS_ENTITY_SYSTEM_ARCHETYPEINDEX_HPP
+#define IAUNS_ENTITY_SYSTEM_ARCHETYPEINDEX_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <vector>
+#include "BaseComponentContainer.hpp"
+
+namespace CPM_ES_NS {
+
+/// Groups entities by component signature (the set of non-static component
+/// types they have) into tables. Each table row is one entity, and holds,
+/// for each component type in the signature, the index of the entity's first
+/// component in that type's container.
+///
+/// Component data stays in the component containers, so a table walk still
+/// gathers components from one array per type. Indices handed out through a
+/// table are the same ones GenericSystem and ComponentGroup::modify use. The index is updated at renormalize (see ArchetypeESCore) and lets a
+/// system iterate the rows of matching tables directly instead of performing
+/// a merge join over all of its containers. As rows are ordered by entity
+/// within each table, such a walk visits entities table by table rather
+/// than in ascending entity order.
+class ArchetypeIndex
+{
+public:
+  struct Table
+  {
+    /// Sorted template IDs of the component types in this table.
+    std::vector<uint64_t>         signature;
+
+    /// Entity IDs, ascending.
+    std::vector<uint64_t>         entities;
+
+    /// columns[c][row] is the index, in the container for signature[c], of
+    /// the first component belonging to entities[row].
+    std::vector<std::vector<int>> columns;
+
+    /// Returns the column for \p templateID, or -1 if the type is not part
+    /// of this table's signature.
+    int findColumn(uint64_t templateID) const;
+  };
+
+  ArchetypeIndex();
+
+  /// Brings the tables up to date with \p containers. Only entities that
+  /// gained or lost all components of a type move: their rows are removed
+  /// from the old table and inserted into the new one. Rows of every other
+  /// entity stay where they are, and only their indices into containers
+  /// whose layout changed are shifted (see
+  /// BaseComponentContainer::getLayoutChangedFrom). A different set of
+  /// containers, or a container becoming static, rebuilds all tables.
+  /// Static containers do not take part in signatures. Tables left without
+  /// rows are kept until the next full rebuild.
+  void build(const std::map<uint64_t, BaseComponentContainer*>& containers,
+             uint64_t containerVersion);
+
+  /// Returns true if the index was built against the current layout of
+  /// \p container. Containers that did not take part in the last build are
+  /// only current if they are empty or static.
+  bool isCurrent(const BaseComponentContainer* container) const;
+
+  /// Returns true if the index was built from the core's current set of
+  /// containers.
+  bool isCurrent(uint64_t containerVersion) const {return mBuilt && containerVersion == mContainerVersion;}
+
+  /// Returns true if any container's layout changed since the last build.
+  bool needsRebuild(const std::map<uint64_t, BaseComponentContainer*>& containers,
+                    uint64_t containerVersion) const;
+
+  const std::vector<Table>& getTables() const {return mTables;}
+
+  /// Incremented whenever tables are added or removed. Systems use this to
+  /// know when to recompute which tables match their component types.
+  uint64_t getBuildVersion() const {return mBuildVersion;}
+
+  /// Removes all tables.
+  void clear();
+
+private:
+  /// A non-static container and the sequences of its components at the
+  /// last build, which changes are diffed against.
+  struct Participant
+  {
+    uint64_t                templateID;
+    BaseComponentContainer* container;
+    std::vector<uint64_t>   sequences;
+  };
+
+  /// Returns the table with \p signature (sorted template IDs), creating it
+  /// if needed.
+  size_t findOrAddTable(const std::vector<uint64_t>& signature);
+
+  std::vector<Table>                                mTables;
+  std::map<std::vector<uint64_t>, size_t>           mTableLookup;   ///< Signature to table.
+  std::vector<Participant>                          mParticipants;  ///< In template ID order.
+  std::map<const BaseComponentContainer*, uint64_t> mLayoutVersions;  ///< Per container, at build time.
+  uint64_t                                          mContainerVersion;
+  uint64_t                                          mBuildVersion;
+  bool                                              mBuilt;
+};
+
+} // namespace CPM_ES_NS
+
+#endif
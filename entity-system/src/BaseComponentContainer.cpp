@@ -1,8 +1,41 @@
 #include "BaseComponentContainer.hpp"
+#include <algorithm>
+#include <limits>
 
 namespace CPM_ES_NS {
 
 const int BaseComponentContainer::StaticEntID = 1;
+const size_t BaseComponentContainer::LayoutHistory;
+
+uint64_t BaseComponentContainer::getLayoutChangedFrom(uint64_t layoutVersion) const
+{
+  if (layoutVersion >= mLayoutVersion)
+    return (layoutVersion == mLayoutVersion) ? std::numeric_limits<uint64_t>::max() : 0;
+
+  // mLayoutChanges holds the changes that led to the last
+  // mLayoutChanges.size() layout versions.
+  uint64_t numChanges = mLayoutVersion - layoutVersion;
+  if (numChanges > mLayoutChanges.size())
+    return 0;
+
+  return *std::min_element(mLayoutChanges.end() - static_cast<std::ptrdiff_t>(numChanges),
+                           mLayoutChanges.end());
+}
+
+void BaseComponentContainer::appendSequences(int index, std::vector<uint64_t>& sequences) const
+{
+  int size = static_cast<int>(getNumComponents());
+  for (int i = std::max(index, 0); i < size; ++i)
+    sequences.push_back(getSequenceFromIndex(i));
+}
+
+void BaseComponentContainer::changeLayout(uint64_t fromSequence)
+{
+  if (mLayoutChanges.size() == LayoutHistory)
+    mLayoutChanges.erase(mLayoutChanges.begin());
+  mLayoutChanges.push_back(fromSequence);
+  ++mLayoutVersion;
+}
 
 } // namespace CPM_ES_NS
 
@@ -2,6 +2,8 @@
 #define IAUNS_ENTITY_SYSTEM_BASECOMPONENTCONTAINER_HPP
 
 #include <cstdint>
+#include <vector>
+#include "PrefabComponents.hpp"
 
 namespace CPM_ES_NS {
 
@@ -9,11 +11,34 @@ namespace CPM_ES_NS {
 class BaseComponentContainer
 {
 public:
-  BaseComponentContainer()           {}
+  BaseComponentContainer() :
+      mLayoutVersion(0),
+      mDirty(false),
+      mRenormalizePending(false),
+      mPendingStableSort(false),
+      mDirtyList(nullptr)
+  {}
   virtual ~BaseComponentContainer()  {}
   
   virtual void renormalize(bool stableSort) = 0;
 
+  /// Double-buffered renormalize, see ESCoreBase::prepareRenormalize.
+  /// Containers that are not double-buffered renormalize in place here, and
+  /// ignore buildBackBuffer and swapBuffers.
+  /// @{
+  virtual void prepareRenormalize(bool stableSort)
+  {
+    if (isDirty() || !tracksDirty())
+      renormalize(stableSort);
+  }
+  virtual void buildBackBuffer()  {}
+  virtual void swapBuffers()      {}
+  /// @}
+
+  /// True between prepareRenormalize and buildBackBuffer if the container
+  /// has a back buffer to build.
+  virtual bool isBuildPending() const {return false;}
+
   /// Get the least sequence held by the component.
   virtual uint64_t getLowerSequence() const = 0;
 
@@ -56,13 +81,152 @@ public:
   /// If the index is not present, the function returns 0 (an invalid sequence).
   virtual uint64_t getSequenceFromIndex(int index) const = 0;
 
+  /// Appends the sequences of the components from \p index to the end of
+  /// the container to \p sequences. Cheaper than calling
+  /// getSequenceFromIndex for every component.
+  virtual void appendSequences(int index, std::vector<uint64_t>& sequences) const;
+
   /// Retrieves the number of components associated with a particular sequence.
   /// This function also counts the components *to be added*! Seeing the
   /// components to be added is important when we want debugging information
   /// related to if we have satisfied a particular system.
   virtual int getNumComponentsWithSequence(uint64_t sequence) const = 0;
 
+  /// Called by GenericSystem::walkComponents before it walks the container
+  /// from beginning to end. Lets containers that adapt to their access
+  /// pattern tell walks from lookups by sequence.
+  virtual void noteWalk() const {}
+
+  /// Returns true if systems may write to the components in place (see
+  /// GenericSystem::isComponentWritten) until the next renormalize.
+  /// Containers holding a second copy of their components, which such
+  /// writes would bypass, return false.
+  virtual bool canWriteInPlace() const {return true;}
+
+  /// Change tracking (see TrackComponentChanges). Containers that do not
+  /// track changes report version 0 and no changed components.
+  /// @{
+  virtual bool isTrackingChanges() const {return false;}
+
+  /// Version of the latest change. Grows with every renormalize that
+  /// applies changes and every in place write.
+  virtual uint64_t getChangeVersion() const {return 0;}
+
+  /// Appends the sequences of the components added or changed after
+  /// \p version to \p sequences, in ascending order and without repeats.
+  virtual void collectChangedSequences(uint64_t /* version */, std::vector<uint64_t>& /* sequences */) {}
+  /// @}
+
+  /// Reactive systems (see ReactiveSystem). While reactive, the container
+  /// records the components each renormalize adds and removes, until
+  /// clearReactiveBatches is called.
+  /// @{
+  virtual void setReactive(bool /* reactive */) {}
+  virtual bool isReactive() const {return false;}
+  virtual bool hasReactiveBatches() const {return false;}
+  virtual void clearReactiveBatches() {}
+  /// @}
+
+  /// Prefabs (see ESCoreBase::createPrefab). capturePrefabComponents
+  /// returns copies of the components held by \p sequence, or nullptr if it
+  /// holds none. The caller takes ownership. instantiatePrefabComponents
+  /// queues the captured components for \p count new entities with
+  /// consecutive IDs starting at \p firstSequence.
+  /// @{
+  virtual BasePrefabComponents* capturePrefabComponents(uint64_t /* sequence */) const {return nullptr;}
+  virtual void instantiatePrefabComponents(const BasePrefabComponents& /* prefab */,
+                                           uint64_t /* firstSequence */, size_t /* count */) {}
+  /// @}
+
+  /// Returns a counter that changes whenever components are sorted into or
+  /// removed from the container. Indices into the container obtained while
+  /// the layout version was the same remain valid.
+  uint64_t getLayoutVersion() const {return mLayoutVersion;}
+
+  /// Returns the smallest sequence whose components may have moved, or been
+  /// added or removed, since the layout version was \p layoutVersion.
+  /// Indices of components with smaller sequences are unchanged. Returns 0
+  /// if the changes are too far back to be known, and the largest uint64_t
+  /// if the layout did not change.
+  uint64_t getLayoutChangedFrom(uint64_t layoutVersion) const;
+
+  /// Returns true if the container calls markDirty before queuing any
+  /// change. ESCoreBase renormalizes containers that do not at every
+  /// renormalize, whether they are dirty or not.
+  virtual bool tracksDirty() const {return false;}
+
+  /// Returns true if changes have been queued since the last renormalize.
+  /// Only meaningful if tracksDirty returns true.
+  bool isDirty() const {return mDirty;}
+
+  /// Returns true if a renormalize was deferred (see deferRenormalize) and
+  /// has not been performed yet.
+  bool isRenormalizePending() const {return mRenormalizePending;}
+
+  /// Lazy renormalize. Records that the container should be renormalized
+  /// with \p stableSort before it is next accessed or changed. Does nothing
+  /// if the container is not dirty.
+  void deferRenormalize(bool stableSort)
+  {
+    if (mDirty && !mRenormalizePending)
+    {
+      mRenormalizePending = true;
+      mPendingStableSort = stableSort;
+    }
+  }
+
+  /// Performs a deferred renormalize, if there is one.
+  void flushRenormalize()
+  {
+    if (mRenormalizePending)
+      renormalize(mPendingStableSort);
+  }
+
+  /// The container appends itself to \p list whenever it becomes dirty.
+  /// Used by ESCoreBase to only visit changed containers at renormalize.
+  void setDirtyList(std::vector<BaseComponentContainer*>* list) {mDirtyList = list;}
+
   static const int StaticEntID;
+
+protected:
+
+  /// Containers must call this *before* queuing a change. A deferred
+  /// renormalize is performed first, so that the change is applied by the
+  /// next renormalize, not by the deferred one.
+  void markDirty()
+  {
+    if (mRenormalizePending)
+      renormalize(mPendingStableSort);
+
+    if (!mDirty)
+    {
+      mDirty = true;
+      if (mDirtyList != nullptr)
+        mDirtyList->push_back(this);
+    }
+  }
+
+  /// Containers call this at the beginning of renormalize.
+  void clearDirty()
+  {
+    mDirty = false;
+    mRenormalizePending = false;
+  }
+
+  /// Containers call this whenever their layout changes, with the smallest
+  /// sequence affected (see getLayoutChangedFrom). Bumps the layout version.
+  void changeLayout(uint64_t fromSequence);
+
+private:
+  /// Number of layout changes getLayoutChangedFrom looks back over.
+  static const size_t LayoutHistory = 16;
+
+  uint64_t                              mLayoutVersion;  ///< See getLayoutVersion.
+  std::vector<uint64_t>                 mLayoutChanges;  ///< Smallest sequence per layout change, the most recent last.
+  bool                                  mDirty;
+  bool                                  mRenormalizePending;
+  bool                                  mPendingStableSort;
+  std::vector<BaseComponentContainer*>* mDirtyList;
 };
 
 } // namespace CPM_ES_NS 
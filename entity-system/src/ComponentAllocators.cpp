@@ -0,0 +1,280 @@
+#include "ComponentAllocators.hpp"
+
+#include <algorithm>
+
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+#endif
+
+namespace CPM_ES_NS {
+
+namespace {
+
+// Precedes every FrameArena allocation. 16 bytes keep the allocation itself
+// 16-byte aligned.
+struct alignas(16) ArenaHeader
+{
+  void* shared;   ///< FrameArena::Shared.
+};
+
+size_t alignUp(size_t value, size_t alignment)
+{
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+}
+
+const size_t FrameArena::DefaultChunkSize;
+const size_t BlockPool::MinBlockSize;
+const size_t BlockPool::MaxBlockSize;
+const size_t HugePageMemory::HugePageSize;
+const size_t HugePageMemory::MinHugeBytes;
+
+//------------------------------------------------------------------------------
+// FrameArena
+//------------------------------------------------------------------------------
+
+struct FrameArena::Shared
+{
+  Shared() : refs(1) {}
+
+  std::atomic<size_t> refs;     ///< Live allocations, plus one for the arena.
+  std::vector<Chunk>  chunks;   ///< Handed over by the destroyed arena.
+};
+
+FrameArena::FrameArena() :
+    mOffset(0),
+    mPeak(0),
+    mUsed(0),
+    mShared(new Shared())
+{}
+
+FrameArena::~FrameArena()
+{
+  // Allocations still alive (owned by a container on another thread) keep
+  // the chunks until the last of them is freed.
+  mShared->chunks.swap(mChunks);
+  release(mShared);
+}
+
+void FrameArena::release(Shared* shared)
+{
+  if (--shared->refs != 0)
+    return;
+  for (Chunk& chunk : shared->chunks)
+    ::operator delete(chunk.data);
+  delete shared;
+}
+
+FrameArena& FrameArena::local()
+{
+  static thread_local FrameArena arena;
+  return arena;
+}
+
+void* FrameArena::allocate(size_t bytes)
+{
+  if (mShared->refs.load() == 1)
+    reset();
+
+  size_t needed = sizeof(ArenaHeader) + alignUp(bytes, sizeof(ArenaHeader));
+  if (mChunks.empty() || mOffset + needed > mChunks.back().size)
+    addChunk(needed);
+
+  char* p = mChunks.back().data + mOffset;
+  mOffset += needed;
+  mUsed += needed;
+  ++mShared->refs;
+
+  reinterpret_cast<ArenaHeader*>(p)->shared = mShared;
+  return p + sizeof(ArenaHeader);
+}
+
+void FrameArena::deallocate(void* p)
+{
+  if (p == nullptr)
+    return;
+  ArenaHeader* header = reinterpret_cast<ArenaHeader*>(static_cast<char*>(p) - sizeof(ArenaHeader));
+  release(static_cast<Shared*>(header->shared));
+}
+
+size_t FrameArena::getNumLiveAllocations() const
+{
+  return mShared->refs.load() - 1;
+}
+
+size_t FrameArena::getReservedBytes() const
+{
+  size_t bytes = 0;
+  for (const Chunk& chunk : mChunks)
+    bytes += chunk.size;
+  return bytes;
+}
+
+void FrameArena::reset()
+{
+  mPeak = std::max(mPeak, mUsed);
+  mUsed = 0;
+  mOffset = 0;
+
+  // Replace several chunks by one that holds everything used so far.
+  if (mChunks.size() > 1)
+  {
+    for (Chunk& chunk : mChunks)
+      ::operator delete(chunk.data);
+    mChunks.clear();
+    addChunk(mPeak);
+  }
+}
+
+void FrameArena::addChunk(size_t minBytes)
+{
+  Chunk chunk;
+  chunk.size = std::max(DefaultChunkSize, alignUp(minBytes, DefaultChunkSize));
+  chunk.data = static_cast<char*>(::operator new(chunk.size));
+  mChunks.push_back(chunk);
+  mOffset = 0;
+}
+
+//------------------------------------------------------------------------------
+// BlockPool
+//------------------------------------------------------------------------------
+
+BlockPool::BlockPool() :
+    mFree(sizeClass(MaxBlockSize) + 1)
+{}
+
+BlockPool& BlockPool::instance()
+{
+  // Never destroyed: containers with static storage duration may return
+  // blocks during exit.
+  static BlockPool* pool = new BlockPool();
+  return *pool;
+}
+
+size_t BlockPool::sizeClass(size_t bytes)
+{
+  size_t c = 0;
+  size_t size = MinBlockSize;
+  while (size < bytes)
+  {
+    size <<= 1;
+    ++c;
+  }
+  return c;
+}
+
+void* BlockPool::allocate(size_t bytes)
+{
+  if (bytes > MaxBlockSize)
+    return ::operator new(bytes);
+
+  size_t c = sizeClass(bytes);
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mFree[c].empty())
+    {
+      void* p = mFree[c].back();
+      mFree[c].pop_back();
+      return p;
+    }
+  }
+  return ::operator new(MinBlockSize << c);
+}
+
+void BlockPool::deallocate(void* p, size_t bytes)
+{
+  if (p == nullptr)
+    return;
+  if (bytes > MaxBlockSize)
+  {
+    ::operator delete(p);
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  mFree[sizeClass(bytes)].push_back(p);
+}
+
+size_t BlockPool::getNumFreeBlocks() const
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  size_t n = 0;
+  for (const std::vector<void*>& blocks : mFree)
+    n += blocks.size();
+  return n;
+}
+
+//------------------------------------------------------------------------------
+// HugePageMemory
+//------------------------------------------------------------------------------
+
+#ifdef _WIN32
+
+void* HugePageMemory::allocate(size_t bytes)
+{
+  if (bytes < MinHugeBytes)
+    return ::operator new(bytes);
+
+  void* p = VirtualAlloc(nullptr, alignUp(bytes, HugePageSize), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+  if (p == nullptr)
+    throw std::bad_alloc();
+  return p;
+}
+
+void HugePageMemory::deallocate(void* p, size_t bytes)
+{
+  if (p == nullptr)
+    return;
+  if (bytes < MinHugeBytes)
+    ::operator delete(p);
+  else
+    VirtualFree(p, 0, MEM_RELEASE);
+}
+
+#else
+
+void* HugePageMemory::allocate(size_t bytes)
+{
+  if (bytes < MinHugeBytes)
+    return ::operator new(bytes);
+
+  // Map one huge page more than needed, then trim to an aligned range.
+  size_t size = alignUp(bytes, HugePageSize);
+  size_t mapped = size + HugePageSize;
+  void* raw = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+    throw std::bad_alloc();
+
+  char* begin = static_cast<char*>(raw);
+  char* aligned = reinterpret_cast<char*>(alignUp(reinterpret_cast<uintptr_t>(begin), HugePageSize));
+  size_t head = static_cast<size_t>(aligned - begin);
+  if (head > 0)
+    munmap(begin, head);
+  if (mapped - head > size)
+    munmap(aligned + size, mapped - head - size);
+
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+void HugePageMemory::deallocate(void* p, size_t bytes)
+{
+  if (p == nullptr)
+    return;
+  if (bytes < MinHugeBytes)
+    ::operator delete(p);
+  else
+    munmap(p, alignUp(bytes, HugePageSize));
+}
+
+#endif
+
+} // namespace CPM_ES_NS
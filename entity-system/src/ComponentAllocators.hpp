@@ -0,0 +1,172 @@
+#ifndef IAUNS_ENTITY_SYSTEM_COMPONENTALLOCATORS_HPP
+#define IAUNS_ENTITY_SYSTEM_COMPONENTALLOCATORS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "ComponentStorage.hpp"
+
+namespace CPM_ES_NS {
+
+/// Allocators for AllocatorComponentStorage. All of them are stateless, so
+/// containers using them can be swapped and moved freely. For example, to
+/// keep a large component type in huge pages and its queues in the frame
+/// arena:
+///
+///   template <> struct ComponentStorageType<CompTransform>
+///       : AllocatorComponentStorage<HugePageAllocator, FrameArenaAllocator, true> {};
+
+/// Bump allocator for memory that lives for about a frame, such as the
+/// removal and modification queues of containers. Each thread has its own
+/// arena (see local). Allocation moves a pointer forward; freeing only
+/// counts. When every allocation has been freed, the arena starts over from
+/// the beginning of a single chunk sized to the largest amount used so far,
+/// so after a few frames it allocates nothing from the system.
+///
+/// Memory may be freed on another thread than the one that allocated it
+/// (DoubleBufferedComponentContainer builds on a worker thread), also after
+/// that thread exited (ModificationBuffer filled by a worker): the chunks of
+/// a destroyed arena are released with its last allocation.
+class FrameArena
+{
+public:
+  static const size_t DefaultChunkSize = size_t(64) << 10;
+
+  FrameArena();
+  ~FrameArena();
+
+  FrameArena(const FrameArena&) = delete;
+  FrameArena& operator=(const FrameArena&) = delete;
+
+  /// The calling thread's arena.
+  static FrameArena& local();
+
+  /// Returns 16-byte aligned memory.
+  void* allocate(size_t bytes);
+
+  /// Frees memory returned by allocate on any arena.
+  static void deallocate(void* p);
+
+  /// Number of allocations not freed yet.
+  size_t getNumLiveAllocations() const;
+
+  /// Bytes reserved from the system.
+  size_t getReservedBytes() const;
+
+private:
+  struct Chunk
+  {
+    char*   data;
+    size_t  size;
+  };
+
+  struct Shared;
+
+  void reset();
+  void addChunk(size_t minBytes);
+  static void release(Shared* shared);
+
+  std::vector<Chunk>  mChunks;
+  size_t              mOffset;    ///< In the last chunk.
+  size_t              mPeak;      ///< Largest total used before a reset.
+  size_t              mUsed;      ///< Since the last reset.
+  Shared*             mShared;    ///< Outlives the arena while allocations do.
+};
+
+/// Pool of memory blocks in power-of-two size classes, shared by all
+/// threads. Freed blocks are kept for reuse and never returned to the
+/// system. Suited to arrays that are allocated and freed repeatedly at the
+/// same sizes, such as the temporary queues of derived containers.
+class BlockPool
+{
+public:
+  static const size_t MinBlockSize = 64;
+  static const size_t MaxBlockSize = size_t(1) << 20;
+
+  static BlockPool& instance();
+
+  /// Blocks larger than MaxBlockSize come straight from operator new.
+  void* allocate(size_t bytes);
+  void  deallocate(void* p, size_t bytes);
+
+  /// Number of free blocks held in the pool.
+  size_t getNumFreeBlocks() const;
+
+private:
+  BlockPool();
+  static size_t sizeClass(size_t bytes);
+
+  mutable std::mutex                mMutex;
+  std::vector<std::vector<void*>>   mFree;  ///< Free blocks, by size class.
+};
+
+/// Maps large blocks (MinHugeBytes and up) directly from the system, 2 MB
+/// aligned and rounded to 2 MB, and asks for them to be backed by
+/// transparent huge pages, which cuts TLB misses when walking big
+/// containers. Small blocks come from operator new. On Windows large blocks
+/// are plain VirtualAlloc allocations: large pages there need a privilege
+/// the process usually does not hold.
+class HugePageMemory
+{
+public:
+  static const size_t HugePageSize  = size_t(2) << 20;
+  static const size_t MinHugeBytes  = size_t(1) << 20;
+
+  static void* allocate(size_t bytes);
+  static void  deallocate(void* p, size_t bytes);
+};
+
+template <typename T>
+class FrameArenaAllocator
+{
+public:
+  typedef T value_type;
+
+  FrameArenaAllocator() {}
+  template <typename U> FrameArenaAllocator(const FrameArenaAllocator<U>&) {}
+
+  T* allocate(size_t n)           {return static_cast<T*>(FrameArena::local().allocate(n * sizeof(T)));}
+  void deallocate(T* p, size_t)   {FrameArena::deallocate(p);}
+
+  template <typename U> bool operator==(const FrameArenaAllocator<U>&) const {return true;}
+  template <typename U> bool operator!=(const FrameArenaAllocator<U>&) const {return false;}
+};
+
+template <typename T>
+class PoolAllocator
+{
+public:
+  typedef T value_type;
+
+  PoolAllocator() {}
+  template <typename U> PoolAllocator(const PoolAllocator<U>&) {}
+
+  T* allocate(size_t n)           {return static_cast<T*>(BlockPool::instance().allocate(n * sizeof(T)));}
+  void deallocate(T* p, size_t n) {BlockPool::instance().deallocate(p, n * sizeof(T));}
+
+  template <typename U> bool operator==(const PoolAllocator<U>&) const {return true;}
+  template <typename U> bool operator!=(const PoolAllocator<U>&) const {return false;}
+};
+
+template <typename T>
+class HugePageAllocator
+{
+public:
+  typedef T value_type;
+
+  HugePageAllocator() {}
+  template <typename U> HugePageAllocator(const HugePageAllocator<U>&) {}
+
+  T* allocate(size_t n)           {return static_cast<T*>(HugePageMemory::allocate(n * sizeof(T)));}
+  void deallocate(T* p, size_t n) {HugePageMemory::deallocate(p, n * sizeof(T));}
+
+  template <typename U> bool operator==(const HugePageAllocator<U>&) const {return true;}
+  template <typename U> bool operator!=(const HugePageAllocator<U>&) const {return false;}
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -2,19 +2,141 @@
 #define IAUNS_ENTITY_SYSTEM_COMPONENTCONTAINER_HPP
 
 #include <cstdint>
+#include <cstring>
+#include <limits>
 #include <vector>
+#include <utility>
 #include <algorithm>
+#include <type_traits>
 #include "TemplateID.hpp"
 #include "BaseComponentContainer.hpp"
+#include "ComponentStorage.hpp"
+#include "ComponentSlab.hpp"
+#include "ComponentPatch.hpp"
+#include "ModificationBuffer.hpp"
+#include "SparseSequenceIndex.hpp"
 
 namespace CPM_ES_NS {
 
+/// Sequence and component storage for ComponentContainer<T>::ComponentItem.
+template <typename T,
+          bool IsTag = std::is_empty<T>::value,
+          bool OutOfLine = IsOutOfLineComponent<T>::value>
+struct ComponentItemData
+{
+  ComponentItemData(uint64_t seq) : sequence(seq), component() {}
+  ComponentItemData(uint64_t seq, const T& comp) : sequence(seq), component(comp) {}
+  ComponentItemData(uint64_t seq, T&& comp) : sequence(seq), component(std::forward<T>(comp)) {}
+
+  T&        get()       {return component;}
+  const T&  get() const {return component;}
+
+  uint64_t  sequence;   ///< Commonly used element in the first cacheline.
+  T         component;  ///< Copy constructable component data.
+};
+
+/// Tag components (empty types such as 'Selected' or 'Dead') carry no data.
+/// Every item shares one static instance, so an item is only its sequence:
+/// the container degenerates into a sorted column of entity IDs. Systems
+/// still receive a valid pointer to the shared instance.
+template <typename T>
+struct ComponentItemData<T, true, false>
+{
+  ComponentItemData(uint64_t seq) : sequence(seq) {}
+  ComponentItemData(uint64_t seq, const T&) : sequence(seq) {}
+
+  T&        get()       {return component;}
+  const T&  get() const {return component;}
+
+  uint64_t  sequence;
+  static T  component;  ///< Shared by all items.
+};
+
+template <typename T> T ComponentItemData<T, true, false>::component;
+
+/// Large components live in ComponentSlab<T> and the item holds a handle to
+/// its component (see DefaultComponentStorage::OutOfLineBytes). Copying an
+/// item copies the component; moving it only moves the handle. The
+/// component's address is stable for as long as the item holds it.
+template <typename T>
+struct ComponentItemData<T, false, true>
+{
+  ComponentItemData(uint64_t seq) : sequence(seq) {}
+  ComponentItemData(uint64_t seq, const T& comp) : sequence(seq), handle(comp) {}
+  ComponentItemData(uint64_t seq, T&& comp) : sequence(seq), handle(std::forward<T>(comp)) {}
+
+  T&        get()       {return *handle;}
+  const T&  get() const {return *handle;}
+
+  uint64_t            sequence;
+  ComponentSlabPtr<T> handle;
+};
+
+/// Specialize with value = true to have ComponentContainer<T> record when
+/// each component was last added or changed, e.g. for components that
+/// systems upload or replicate only when they change:
+///
+///   namespace CPM_ES_NS {
+///   template <> struct TrackComponentChanges<CompTransform> : std::true_type {};
+///   }
+///
+/// See ComponentContainer::getChangeVersion and
+/// GenericSystem::isChangeFiltered.
+template <typename T>
+struct TrackComponentChanges : std::false_type {};
+
+/// Change version of a ComponentItem. Empty unless changes are tracked.
+template <bool Track>
+struct ComponentItemVersion
+{
+  uint64_t  getVersion() const  {return 0;}
+  void      setVersion(uint64_t) {}
+};
+
+template <>
+struct ComponentItemVersion<true>
+{
+  ComponentItemVersion() : version(0) {}
+
+  uint64_t  getVersion() const          {return version;}
+  void      setVersion(uint64_t versionIn) {version = versionIn;}
+
+  uint64_t  version;  ///< ComponentContainer::getChangeVersion of the last change.
+};
+
+/// Compile-time properties of component type T that select the fast paths
+/// of ComponentContainer.
+template <typename T>
+struct ComponentTraits
+{
+private:
+  template <class V>
+  static auto testConstruct(int) -> decltype(std::declval<V&>().componentConstruct(uint64_t(0)), std::true_type());
+  template <class V>
+  static std::false_type testConstruct(long);
+
+  template <class V>
+  static auto testDestruct(int) -> decltype(std::declval<V&>().componentDestruct(uint64_t(0)), std::true_type());
+  template <class V>
+  static std::false_type testDestruct(long);
+
+public:
+  static const bool HasConstructHook = decltype(testConstruct<T>(0))::value;
+  static const bool HasDestructHook = decltype(testDestruct<T>(0))::value;
+
+  /// Plain data (e.g. glm structs) without hooks. Their items are relocated
+  /// with memmove and modifications are applied with memcpy.
+  static const bool IsTrivial =
+      std::is_trivially_copyable<T>::value && !HasConstructHook && !HasDestructHook;
+};
+
 /// Component container.
 /// \todo Add maximum size caps to the container. Should also check size
 ///       caps for the number of removed components as well.
 template <typename T>
 class ComponentContainer : public BaseComponentContainer
 {
+protected:
   // SFINAE implementation of possible function calls inside of component
   // structures.
   template<class V>
@@ -41,9 +163,15 @@ class ComponentContainer : public BaseComponentContainer
 public:
   ComponentContainer() :
       mIsStatic(false),
+      mCoalesceModifications(false),
+      mClearPending(false),
+      mAddedInOrder(true),
       mLastSortedSize(0),
       mUpperSequence(0),
-      mLowerSequence(0)
+      mLowerSequence(0),
+      mChangeVersion(0),
+      mChangeBlocksLayout(~uint64_t(0)),
+      mReactive(false)
   {
     /// \todo Extract information from global table regarding default / max size
     ///       of components.
@@ -58,38 +186,46 @@ public:
   }
 
   /// Item that represents one component paired with a sequence.
-  struct ComponentItem
+  struct ComponentItem : public ComponentItemData<T>,
+                         public ComponentItemVersion<TrackComponentChanges<T>::value>
   {
-    ComponentItem() : sequence(0)
+    ComponentItem() : ComponentItemData<T>(0)
     {
     }
 
     ComponentItem(uint64_t seq, const T& comp) :
-        sequence(seq),
-        component(comp)
+        ComponentItemData<T>(seq, comp)
     {}
 
     ComponentItem(uint64_t seq, T&& comp) :
-        sequence(seq),
-        component(std::forward<T>(comp))
+        ComponentItemData<T>(seq, std::forward<T>(comp))
     {}
 
     bool operator<(const ComponentItem& other) const
     {
-      return (sequence < other.sequence);
+      return (this->sequence < other.sequence);
     }
 
     bool operator<(uint64_t sequenceIn) const
     {
-      return sequence < sequenceIn;
+      return this->sequence < sequenceIn;
     }
-
-    uint64_t  sequence;   ///< Commonly used element in the first cacheline.
-    T         component;  ///< Copy constructable component data.
   };
 
+  /// Array holding the components, see ComponentStorageType.
+  typedef typename ComponentStorageType<T>::template array<ComponentItem>::type ComponentArray;
+
+  /// True when items can be relocated with memmove (see ComponentTraits).
+  /// Out-of-line items own their slab slot and never qualify.
+  static const bool TrivialItems =
+      ComponentTraits<T>::IsTrivial && std::is_trivially_copyable<ComponentItem>::value;
+  typedef std::integral_constant<bool, TrivialItems> TrivialItemsTag;
+
   /// Returns -1 if no component of the given sequence is found.
-  int getComponentItemIndexWithSequence(uint64_t sequence) const
+  /// The lookup functions below are virtual so that derived containers can
+  /// replace the binary search with their own index (see
+  /// SparseComponentContainer).
+  virtual int getComponentItemIndexWithSequence(uint64_t sequence) const
   {
     if (mComponents.size() == 0)
       return -1;
@@ -102,7 +238,7 @@ public:
     auto last = mComponents.cbegin() + mLastSortedSize;
     auto it = std::lower_bound(mComponents.cbegin(), last, sequence);
 
-    if (it->sequence == sequence)
+    if (it != last && it->sequence == sequence)
     {
       return it - mComponents.cbegin();
     }
@@ -112,7 +248,7 @@ public:
     }
   }
 
-  ComponentItem* getComponentItemWithSequence(uint64_t sequence)
+  virtual ComponentItem* getComponentItemWithSequence(uint64_t sequence)
   {
     if (mComponents.size() == 0)
       return nullptr;
@@ -126,7 +262,7 @@ public:
     // Our vector is always sorted, so we can pull this off.
     auto it = std::lower_bound(mComponents.begin(), last, sequence);
 
-    if (it->sequence == sequence)
+    if (it != last && it->sequence == sequence)
     {
       return &(*it);
     }
@@ -141,21 +277,21 @@ public:
   {
     ComponentItem* item = getComponentItemWithSequence(sequence);
     if (item)
-      &item->component;
+      return &item->get();
     else
-      return item;
+      return nullptr;
   }
 
   /// Retrieves the component for the given sequence. Returns both a pointer
   /// to the component and its index in the component container. You can
   /// use this index to modify the components value using modifyIndex.
-  std::pair<const T*, size_t> getComponent(uint64_t sequence) const
+  virtual std::pair<const T*, size_t> getComponent(uint64_t sequence) const
   {
     if (mComponents.size() == 0)
       return std::make_pair(nullptr, 0);
 
     if (isStatic())
-      return std::make_pair(&mComponents.front().component, 0);
+      return std::make_pair(&mComponents.front().get(), 0);
 
     auto last = mComponents.cbegin() + mLastSortedSize;
 
@@ -163,10 +299,10 @@ public:
     // Our vector is always sorted, so we can pull this off.
     auto it = std::lower_bound(mComponents.cbegin(), last, sequence);
 
-    if (it->sequence == sequence)
+    if (it != last && it->sequence == sequence)
     {
       size_t index = it - mComponents.cbegin();
-      return std::make_pair(&it->component, index);
+      return std::make_pair(&it->get(), index);
     }
     else
     {
@@ -186,7 +322,7 @@ public:
     // Our vector is always sorted, so we can pull this off.
     auto it = std::lower_bound(mComponents.cbegin(), mComponents.cend(), sequence);
 
-    if (it->sequence != sequence) { return 0; }
+    if (it == mComponents.cend() || it->sequence != sequence) { return 0; }
 
     const ComponentItem* item = &(*it);
 
@@ -208,12 +344,23 @@ public:
     return numComponents;
   }
 
+  bool tracksDirty() const override {return true;}
+
   /// Sorts in added components and removes deleted components.
   /// Neither of these operations (addition or deletion) take affect when the
   /// system is operating. This way, each timestep is completely deterministic.
   /// The same set of data is acted upon by all systems.
   void renormalize(bool stableSort) override
   {
+    clearDirty();
+
+    // Everything applied below is stamped with the same version.
+    if (TrackComponentChanges<T>::value)
+      ++mChangeVersion;
+
+    if (mClearPending)
+      applyClear();
+
     // Changes should come FIRST. Changes rely on direct indices to values.
     // No additions or removals should come before modifications.
 
@@ -225,7 +372,22 @@ public:
     // stable sort is used. Then removal from the beginning or end of the list
     // is guaranteed to be consistent.
 
-    if (mModifications.size() > 0)
+    if (mModifications.size() > 0 && mCoalesceModifications)
+    {
+      // Conflicts were resolved as modifications were queued, each
+      // component has a single winner.
+      for (const ModificationItem& mod : mModifications)
+      {
+        if (mod.componentIndex < mComponents.size())
+        {
+          assignComponent(mComponents[mod.componentIndex].get(), mod.getValue(), TrivialItemsTag());
+          stampChange(mod.componentIndex, mChangeVersion);
+        }
+        else
+          std::cerr << "cpm-entity-system - renormalize: Bad index!" << std::endl;
+      }
+    }
+    else if (mModifications.size() > 0)
     {
       // Sort modifications to maintain some semblance of cache friendliness
       // and to detect modification conflicts and resolve with priority.
@@ -251,7 +413,9 @@ public:
         // Now we have 1 fully resolved modification.
         if (mModifications[resolvedIndex].componentIndex < mComponents.size())
         {
-          mComponents[mModifications[resolvedIndex].componentIndex].component = mModifications[resolvedIndex].value;
+          assignComponent(mComponents[mModifications[resolvedIndex].componentIndex].get(),
+                          mModifications[resolvedIndex].getValue(), TrivialItemsTag());
+          stampChange(mModifications[resolvedIndex].componentIndex, mChangeVersion);
         }
         else
         {
@@ -259,9 +423,18 @@ public:
         }
         ++attemptIdx;
       }
+    }
 
+    // Field and functor patches apply on top of whole-component
+    // modifications, which are still queued here.
+    if (!mPatches.empty())
+      applyPatches();
+
+    if (mModifications.size() > 0)
+    {
       // Clear all modifications.
-      mModifications.clear();
+      clearQueue(mModifications);
+      mModificationIndex.clear();
     }
 
     // Check to see if components were added. If so, then sort them into
@@ -270,23 +443,40 @@ public:
     {
       if (mLastSortedSize != mComponents.size())
       {
-       // Iterate through the components to-be-constructed array, and construct.
-        auto it = mComponents.begin() + mLastSortedSize;
-        for (; it != mComponents.end(); ++it)
+        if (TrackComponentChanges<T>::value)
         {
-          // Construct added components
-          maybe_component_construct(it->component, it->sequence, 0);
+          for (auto it = mComponents.begin() + mLastSortedSize; it != mComponents.end(); ++it)
+            it->setVersion(mChangeVersion);
+        }
+
+        // Iterate through the components to-be-constructed array, and construct.
+        if (ComponentTraits<T>::HasConstructHook)
+        {
+          auto it = mComponents.begin() + mLastSortedSize;
+          for (; it != mComponents.end(); ++it)
+          {
+            // Construct added components
+            maybe_component_construct(it->get(), it->sequence, 0);
+          }
+        }
+        recordAdded(mComponents.begin() + mLastSortedSize, mComponents.end());
+
+        uint64_t firstAdded = mComponents[mLastSortedSize].sequence;
+        if (!mAddedInOrder)
+        {
+          for (auto it = mComponents.begin() + mLastSortedSize; it != mComponents.end(); ++it)
+            firstAdded = std::min(firstAdded, it->sequence);
         }
 
-        // Sort the entire vector (not just to mLastSortedSize).
         // We *always* stable sort static components. This way we guarantee
-        // the correct ordering.
-        if (!stableSort && !isStatic())
-          std::sort(mComponents.begin(), mComponents.end());
-        else
-          std::stable_sort(mComponents.begin(), mComponents.end());
+        // the correct ordering. Additions appended in order after the sorted
+        // components (see addComponents) are already in place.
+        if (!mAddedInOrder)
+          sortAddedItems(stableSort || isStatic(), TrivialItemsTag());
+        mAddedInOrder = true;
 
         mLastSortedSize = mComponents.size();
+        changeLayout(firstAdded);
       }
 
       mLowerSequence = mComponents.front().sequence;
@@ -301,75 +491,7 @@ public:
 
     // Perform requested removals.
     if (mRemovals.size() > 0)
-    {
-      for (RemovalItem& rem : mRemovals)
-      {
-        auto last = mComponents.begin() + mLastSortedSize;
-        auto it = std::lower_bound(mComponents.begin(), last, rem.sequence);
-
-        if (rem.removeType == REMOVE_ALL)
-        {
-          while (it != mComponents.end() && it->sequence == rem.sequence)
-          {
-            // Call components destructor (we need to do this at the end).
-            maybe_component_destruct(it->component, rem.sequence, 0);
-
-            it = mComponents.erase(it);
-            --mLastSortedSize;
-          }
-        }
-        else if (rem.removeType == REMOVE_LAST)
-        {
-          auto priorIt = it;
-          if (it != mComponents.end()) ++it;
-          while (it != mComponents.end() && it->sequence == rem.sequence)
-          {
-            priorIt = it;
-            ++it;
-          }
-
-          // Call component's destructor (we need to do this at the end).
-          if (priorIt != mComponents.end() && priorIt->sequence == rem.sequence)
-          {
-            maybe_component_destruct(priorIt->component, rem.sequence, 0);
-            priorIt = mComponents.erase(priorIt);
-            --mLastSortedSize;
-          }
-        }
-        else if (rem.removeType == REMOVE_INDEX)
-        {
-          int index = 0;
-          while (it != mComponents.end() && it->sequence == rem.sequence)
-          {
-            if (index == rem.removeIndex)
-            {
-              // Call component's destructor (we need to do this at the end).
-              maybe_component_destruct(it->component, rem.sequence, 0);
-
-              it = mComponents.erase(it);
-              --mLastSortedSize;
-              break;
-            }
-            else
-            {
-              ++it;
-            }
-            ++index;
-          }
-        }
-        else // if (rem.removeType == REMOVE_FIRST)
-        {
-          if (it != mComponents.end() && it->sequence == rem.sequence)
-          {
-            maybe_component_destruct(it->component, rem.sequence, 0);
-
-            it = mComponents.erase(it);
-            --mLastSortedSize;
-          }
-        }
-      }
-      mRemovals.clear();
-    }
+      applyRemovals();
   }
 
   /// Get the least sequence held by the component.
@@ -390,10 +512,24 @@ public:
     return mComponents[index].sequence;
   }
 
+  /// Copies sequences straight out of the sorted components.
+  void appendSequences(int index, std::vector<uint64_t>& sequences) const override
+  {
+    index = std::max(index, 0);
+    if (index >= mLastSortedSize)
+      return;
+    size_t out = sequences.size();
+    sequences.resize(out + static_cast<size_t>(mLastSortedSize - index));
+    for (int i = index; i < mLastSortedSize; ++i)
+      sequences[out++] = mComponents[i].sequence;
+  }
+
   /// Adds the component to the end of our components list. It will only become
   /// available upon renormalization (which usually occurs at the end of
-  /// a frame).
-  void addComponent(uint64_t sequence, const T& component)
+  /// a frame). Containers that queue additions elsewhere override this, so
+  /// that adds through ESCore reach them whatever container type the caller
+  /// names.
+  virtual void addComponent(uint64_t sequence, const T& component)
   {
     // Add the component to the end of mComponents and wait for a renormalize.
     if (isStatic() == true)
@@ -402,9 +538,36 @@ public:
       throw std::runtime_error("Attempting to add entityID component to static component container!");
       return;
     }
+    markDirty();
+    mAddedInOrder = false;
     mComponents.emplace_back(sequence, component);
   }
 
+  /// Adds \p count (entity ID, component) pairs at once, e.g. when loading a
+  /// level. Same as calling addComponent for each pair, but the array grows
+  /// once. With \p sorted, the pairs are checked to be in ascending order of
+  /// entity ID. Sorted runs that follow the components queued before them
+  /// are not sorted at renormalize; any other addition sorts them all.
+  virtual void addComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted = false)
+  {
+    if (count == 0)
+      return;
+
+    if (isStatic() == true)
+    {
+      std::cerr << "Attempting to add entityID component to a static component container!" << std::endl;
+      throw std::runtime_error("Attempting to add entityID component to static component container!");
+    }
+    checkAddedComponents(items, count, sorted);
+
+    markDirty();
+    if (!sorted || (!mComponents.empty() && items[0].first < mComponents.back().sequence))
+      mAddedInOrder = false;
+    mComponents.reserve(mComponents.size() + count);
+    for (size_t i = 0; i < count; ++i)
+      mComponents.emplace_back(items[i].first, items[i].second);
+  }
+
   //void addComponent(uint64_t sequence, T&& component)
   //{
   //  // Add the component to the end of mComponents and wait for a renormalize.
@@ -456,6 +619,7 @@ public:
        setStatic(true);
      }
    }
+   markDirty();
    size_t newIndex = mComponents.size();
    mComponents.emplace_back(StaticEntID, component);
    return newIndex;
@@ -478,6 +642,7 @@ public:
        setStatic(true);
      }
    }
+   markDirty();
    size_t newIndex = mComponents.size();
    mComponents.emplace_back(StaticEntID, std::forward<T>(component));
    return newIndex;
@@ -487,50 +652,64 @@ public:
   {
     /// \todo Check size of mRemovals. Ensure it is not greater than the size
     ///       mComponents is allowed to grow to.
+    markDirty();
     mRemovals.emplace_back(sequence, REMOVE_ALL);
   }
 
   void removeFirstSequence(uint64_t sequence) override
   {
+    markDirty();
     mRemovals.emplace_back(sequence, REMOVE_FIRST);
   }
 
   void removeLastSequence(uint64_t sequence) override
   {
+    markDirty();
     mRemovals.emplace_back(sequence, REMOVE_LAST);
   }
 
   void removeSequenceWithIndex(uint64_t sequence, int32_t componentID) override
   {
+    markDirty();
     mRemovals.emplace_back(sequence, REMOVE_INDEX, componentID);
   }
 
+  /// Removes every sorted component at the next renormalize, in a single
+  /// pass: componentDestruct is called on each in order, then they are
+  /// dropped from the front of the array. Pending additions, queued before
+  /// or after the call, are kept and sorted in as usual, and queued removals
+  /// apply to them. Modifications could only refer to the removed components
+  /// and are dropped.
   void removeAll() override
   {
-    // Iterate through all active components and mark every one for removal.
-    uint64_t lastComponent = 0; // No component will ever be 0, including static components
-                                // (and because of static components...).
-    auto last = mComponents.begin() + mLastSortedSize;
-    for (auto it = mComponents.begin(); it != last; ++it)
-    {
-      if (lastComponent != it->sequence)
-      {
-        removeSequence(it->sequence);
-      }
-      lastComponent = it->sequence;
-    }
+    if (mLastSortedSize == 0)
+      return;
+
+    markDirty();
+    mClearPending = true;
   }
 
+  /// Returns true if removeAll was called since the last renormalize.
+  bool isClearPending() const {return mClearPending;}
+
   void removeAllImmediately() override
   {
-    for (auto it = mComponents.begin(); it != mComponents.begin() + mLastSortedSize; ++it)
+    if (ComponentTraits<T>::HasDestructHook)
     {
-      maybe_component_destruct(it->component, it->sequence, 0);
+      for (auto it = mComponents.begin(); it != mComponents.begin() + mLastSortedSize; ++it)
+      {
+        maybe_component_destruct(it->get(), it->sequence, 0);
+      }
     }
 
     mComponents.clear();
-    mRemovals.clear();
-    mModifications.clear();
+    clearQueue(mRemovals);
+    clearQueue(mModifications);
+    mModificationIndex.clear();
+    mPatches.clear();
+    mClearPending = false;
+    mAddedInOrder = true;
+    changeLayout(0);
 
     // Clear state related to mComponents.
     mLastSortedSize = 0;
@@ -548,14 +727,140 @@ public:
 
   void modifyIndex(const T& val, size_t index, int priority)
   {
+    // Tags have no value to modify.
+    if (std::is_empty<T>::value)
+      return;
+
+    markDirty();
+    if (mCoalesceModifications)
+    {
+      int slot = mModificationIndex.find(index);
+      if (slot >= 0)
+      {
+        // Only a higher priority replaces the current winner, so on equal
+        // priorities the earliest modification wins.
+        if (priority > mModifications[slot].priority)
+          mModifications[slot] = ModificationItem(val, index, priority);
+        return;
+      }
+      mModificationIndex.insert(index, static_cast<int>(mModifications.size()));
+    }
     mModifications.emplace_back(val, index, priority);
   }
 
+  /// When enabled, modifyIndex keeps only the winning modification of each
+  /// component instead of queueing every call: the queue is bounded by the
+  /// number of distinct components modified, and renormalize does not sort
+  /// it. As in the sorted path the highest priority wins. Between equal
+  /// priorities the sorted path picks whichever std::sort places first;
+  /// here the earliest modification wins. Pays off when many systems modify
+  /// the same components every frame.
+  void setCoalesceModifications(bool coalesce)
+  {
+    mCoalesceModifications = coalesce;
+    mModificationIndex.clear();
+    if (coalesce)
+      reindexModifications();
+  }
+
+  bool getCoalesceModifications() const {return mCoalesceModifications;}
+
+  /// Number of whole-component modifications queued.
+  size_t getNumPendingModifications() const {return mModifications.size();}
+
   //void modifyIndex(T&& val, size_t index, int priority)
   //{
   //  mModifications.emplace_back(std::move(val), index, priority);
   //}
 
+  /// Sets only \p field of the component at \p index to \p value at the
+  /// next renormalize. Patches of the same field resolve by priority like
+  /// modifyIndex; patches of different fields all apply. A patch applies
+  /// over a whole-component modification of the same component unless that
+  /// modification has a higher priority.
+  template <typename Field, typename V>
+  void modifyFieldIndex(Field T::* field, const V& value, size_t index, int priority)
+  {
+    if (std::is_empty<T>::value)
+      return;
+
+    if (index >= mComponents.size())
+    {
+      std::cerr << "cpm-entity-system - modifyFieldIndex: Bad index!" << std::endl;
+      return;
+    }
+
+    const T& component = mComponents[index].get();
+    size_t fieldOffset = static_cast<size_t>(reinterpret_cast<const char*>(&(component.*field))
+                                             - reinterpret_cast<const char*>(&component));
+    markDirty();
+    mPatches.addField(index, fieldOffset, field, Field(value), priority);
+  }
+
+  /// Calls \p functor(T&) on the component at \p index at the next
+  /// renormalize, after field patches. Functors of one component run in
+  /// order of increasing priority, so the highest priority has the last
+  /// word, and are skipped if a whole-component modification of a higher
+  /// priority replaced the component.
+  template <typename F>
+  void modifyIndexWith(F&& functor, size_t index, int priority)
+  {
+    if (std::is_empty<T>::value)
+      return;
+
+    markDirty();
+    mPatches.addFunctor(index, std::forward<F>(functor), priority);
+  }
+
+  /// Combines \p value into the component at \p index at the next
+  /// renormalize: component = op(component, value), where op is CombineSum,
+  /// CombineMin, CombineMax or any other associative functor. Unlike
+  /// modifyIndex, combining modifications of one component do not replace
+  /// each other: they are all folded, in order of increasing priority, then
+  /// source and queue position (see ModificationBuffer). They run with the
+  /// functors of modifyIndexWith and are skipped the same way if a
+  /// whole-component modification of a higher priority replaced the
+  /// component.
+  template <typename Op>
+  void combineIndex(const T& value, size_t index, Op op, int priority)
+  {
+    if (std::is_empty<T>::value)
+      return;
+
+    markDirty();
+    mPatches.addCombine(index, value, op, priority);
+  }
+
+  /// Like combineIndex, for a single field:
+  /// component.*field = op(component.*field, value).
+  template <typename Field, typename V, typename Op>
+  void combineFieldIndex(Field T::* field, const V& value, size_t index, Op op, int priority)
+  {
+    if (std::is_empty<T>::value)
+      return;
+
+    markDirty();
+    mPatches.addFieldCombine(index, field, Field(value), op, priority);
+  }
+
+  /// Moves the modifications queued in \p buffer, typically filled by a
+  /// worker thread, to this container. Buffers may be merged in any order:
+  /// the result of the next renormalize only depends on their sources.
+  void mergeModifications(ModificationBuffer<T>& buffer)
+  {
+    if (buffer.empty())
+      return;
+
+    markDirty();
+    mPatches.append(buffer.patches());
+  }
+
+  /// True if modifications or patches are queued.
+  bool hasPendingModifications() const
+  {
+    return mModifications.size() > 0 || !mPatches.empty();
+  }
+
   /// Retrieves the active size of the vector backing this component container.
   /// Used only for debugging purposes (see addStaticComponent in ESCore).
   size_t getSizeOfBackingContainer()  {return mComponents.size();}
@@ -563,6 +868,121 @@ public:
   bool isStatic() const override    {return mIsStatic;}
   void setStatic(bool truth)        {mIsStatic = truth;}
 
+  /// Change tracking, see TrackComponentChanges. Each component keeps the
+  /// change version of its last addition, modification or in place write.
+  /// A summary holding the latest version of every block of ChangeBlockSize
+  /// components lets collectChangedSequences skip unchanged blocks without
+  /// reading their components.
+  /// @{
+  static const size_t ChangeBlockSize = 64;
+
+  bool isTrackingChanges() const override {return TrackComponentChanges<T>::value && !mIsStatic;}
+  uint64_t getChangeVersion() const override {return mChangeVersion;}
+
+  /// Change version of the component at \p index. Always 0 if changes are
+  /// not tracked.
+  uint64_t getComponentVersion(size_t index) const {return mComponents[index].getVersion();}
+
+  /// Records an in place write to the component at \p index, see
+  /// GenericSystem::write.
+  void noteWrite(size_t index)
+  {
+    if (TrackComponentChanges<T>::value && index < static_cast<size_t>(mLastSortedSize))
+      stampChange(index, ++mChangeVersion);
+  }
+
+  void collectChangedSequences(uint64_t version, std::vector<uint64_t>& sequences) override
+  {
+    if (!isTrackingChanges() || version >= mChangeVersion)
+      return;
+
+    size_t size = static_cast<size_t>(mLastSortedSize);
+    if (mChangeBlocksLayout != getLayoutVersion() || mChangeBlocks.size() != (size + ChangeBlockSize - 1) / ChangeBlockSize)
+      rebuildChangeBlocks();
+
+    for (size_t block = 0; block < mChangeBlocks.size(); ++block)
+    {
+      if (mChangeBlocks[block] <= version)
+        continue;
+      size_t end = std::min(size, (block + 1) * ChangeBlockSize);
+      for (size_t i = block * ChangeBlockSize; i < end; ++i)
+      {
+        if (   mComponents[i].getVersion() > version
+            && (sequences.empty() || sequences.back() != mComponents[i].sequence))
+          sequences.push_back(mComponents[i].sequence);
+      }
+    }
+  }
+  /// @}
+
+  /// Reactive batches, see ReactiveSystem. Added components are recorded
+  /// after componentConstruct, in the order they were added; removed ones
+  /// before componentDestruct, in the order they were removed. Components
+  /// dropped by removeAllImmediately are not recorded.
+  /// @{
+  void setReactive(bool reactive) override
+  {
+    mReactive = reactive;
+    if (!reactive)
+      clearReactiveBatches();
+  }
+
+  bool isReactive() const override          {return mReactive;}
+  bool hasReactiveBatches() const override  {return !mAddedBatch.empty() || !mRemovedBatch.empty();}
+
+  void clearReactiveBatches() override
+  {
+    mAddedBatch.clear();
+    mRemovedBatch.clear();
+  }
+
+  const std::vector<ComponentItem>& getAddedBatch() const   {return mAddedBatch;}
+  const std::vector<ComponentItem>& getRemovedBatch() const {return mRemovedBatch;}
+  /// @}
+
+  /// Prefabs. Static components are shared by all entities and are not
+  /// captured.
+  /// @{
+  BasePrefabComponents* capturePrefabComponents(uint64_t sequence) const override
+  {
+    if (isStatic())
+      return nullptr;
+
+    int index = getComponentItemIndexWithSequence(sequence);
+    if (index < 0)
+      return nullptr;
+
+    PrefabComponents<T>* prefab = new PrefabComponents<T>();
+    for (int i = index; i < mLastSortedSize && mComponents[i].sequence == sequence; ++i)
+      prefab->components.push_back(mComponents[i].get());
+    return prefab;
+  }
+
+  void instantiatePrefabComponents(const BasePrefabComponents& base,
+                                   uint64_t firstSequence, size_t count) override
+  {
+    const PrefabComponents<T>& prefab = static_cast<const PrefabComponents<T>&>(base);
+    if (count == 0 || prefab.components.empty())
+      return;
+
+    // One run, already in entity ID order, so that renormalize appends it
+    // without sorting when the new IDs follow the components already held.
+    std::vector<std::pair<uint64_t, T>> items;
+    items.reserve(count * prefab.components.size());
+    for (size_t instance = 0; instance < count; ++instance)
+    {
+      uint64_t sequence = firstSequence + instance;
+      for (const T& component : prefab.components)
+      {
+        items.emplace_back(sequence, component);
+        if (prefab.overrideComponent)
+          prefab.overrideComponent(sequence, instance, items.back().second);
+      }
+    }
+    addComponents(&items[0], items.size(), true);
+  }
+  /// @}
+
   int mLastSortedSize;                ///< Unsorted elements can be added to the end
                                       ///< of mComponents. This represents the last
                                       ///< sorted element inside mComponents.
@@ -572,6 +992,23 @@ public:
   bool mIsStatic;                     ///< True if this container contains static
                                       ///< component data.
 
+  bool mCoalesceModifications;        ///< See setCoalesceModifications.
+
+  bool mClearPending;                 ///< See removeAll.
+
+  bool mAddedInOrder;                 ///< True while the additions queued since the
+                                      ///< last renormalize are sorted runs, each
+                                      ///< following the components before it (see
+                                      ///< addComponents). They are not sorted then.
+
+  uint64_t mChangeVersion;            ///< See getChangeVersion.
+  std::vector<uint64_t> mChangeBlocks;  ///< Latest version per block of ChangeBlockSize.
+  uint64_t mChangeBlocksLayout;       ///< Layout version mChangeBlocks was built for.
+
+  bool mReactive;                     ///< See setReactive.
+  std::vector<ComponentItem> mAddedBatch;   ///< Added since clearReactiveBatches.
+  std::vector<ComponentItem> mRemovedBatch; ///< Removed since clearReactiveBatches.
+
   /// \todo Look into possibly optimizing binary search by having a separate
   ///       vector containing component sequences. We are at less of a risk
   ///       of cache hits that way.
@@ -608,34 +1045,472 @@ public:
         priority(pri)
     {}
 
+    const T& getValue() const {return ComponentValue<T>::get(value);}
+
     //ModificationItem(T&& val, size_t idx, int pri) :
     //    value(std::move(val)),
     //    componentIndex(idx),
     //    priority(pri)
     //{}
 
-    T value;
+    typename ComponentValue<T>::type value;  ///< In the slab for out-of-line components.
     size_t componentIndex; 
     int priority;
   };
 
+  /// Queues of changes applied at renormalize, see ComponentStorageType.
+  typedef typename ComponentStorageType<T>::template queue<RemovalItem>::type       RemovalQueue;
+  typedef typename ComponentStorageType<T>::template queue<ModificationItem>::type  ModificationQueue;
+
   static bool modificationCompare(const ModificationItem& a, const ModificationItem& b)
   {
     return a.componentIndex < b.componentIndex;
   }
 
 protected:
+  typedef ComponentPatchQueue<T>          PatchQueue;
+  typedef typename PatchQueue::Patch      Patch;
+
+  static bool patchCompare(const Patch& a, const Patch& b)
+  {
+    if (a.componentIndex != b.componentIndex)
+      return a.componentIndex < b.componentIndex;
+    if (a.fieldOffset != b.fieldOffset)
+      return a.fieldOffset < b.fieldOffset;
+    return a.order < b.order;
+  }
+
+  /// Rebuilds the coalescing index after mModifications was changed
+  /// directly, merging modifications of the same component like modifyIndex
+  /// would have. Does nothing unless coalescing is enabled.
+  void reindexModifications()
+  {
+    if (!mCoalesceModifications)
+      return;
+
+    mModificationIndex.clear();
+    size_t write = 0;
+    for (size_t read = 0; read != mModifications.size(); ++read)
+    {
+      size_t index = mModifications[read].componentIndex;
+      int slot = mModificationIndex.find(index);
+      if (slot >= 0)
+      {
+        if (mModifications[read].priority > mModifications[slot].priority)
+          mModifications[slot] = mModifications[read];
+        continue;
+      }
+      mModificationIndex.insert(index, static_cast<int>(write));
+      if (write != read)
+        mModifications[write] = mModifications[read];
+      ++write;
+    }
+    mModifications.erase(mModifications.begin() + write, mModifications.end());
+  }
+
+  /// Applies mPatches and clears them. Unless coalesced, mModifications
+  /// must be sorted.
+  void applyPatches()
+  {
+    std::vector<Patch>& patches = mPatches.patches();
+    std::stable_sort(patches.begin(), patches.end(), patchCompare);
+
+    size_t mod = 0;
+    size_t numPatches = patches.size();
+    for (size_t first = 0; first != numPatches;)
+    {
+      size_t index = patches[first].componentIndex;
+      size_t last = first;
+      while (last != numPatches && patches[last].componentIndex == index)
+        ++last;
+
+      if (index >= mComponents.size())
+      {
+        std::cerr << "cpm-entity-system - renormalize: Bad patch index!" << std::endl;
+        first = last;
+        continue;
+      }
+
+      // Patches below the priority of a whole-component modification of the
+      // same component are overridden by it.
+      int floor = std::numeric_limits<int>::min();
+      if (mCoalesceModifications)
+      {
+        int slot = mModificationIndex.find(index);
+        if (slot >= 0)
+          floor = mModifications[slot].priority;
+      }
+      else
+      {
+        while (mod != mModifications.size() && mModifications[mod].componentIndex < index)
+          ++mod;
+        for (size_t m = mod; m != mModifications.size() && mModifications[m].componentIndex == index; ++m)
+          floor = std::max(floor, mModifications[m].priority);
+      }
+
+      T& component = mComponents[index].get();
+      for (size_t field = first; field != last;)
+      {
+        size_t fieldEnd = field + 1;
+        while (fieldEnd != last && patches[fieldEnd].fieldOffset == patches[field].fieldOffset)
+          ++fieldEnd;
+
+        if (patches[field].fieldOffset == PatchQueue::AnyField)
+        {
+          std::stable_sort(patches.begin() + field, patches.begin() + fieldEnd,
+                           [](const Patch& a, const Patch& b)
+                           {
+                             if (a.priority != b.priority)
+                               return a.priority < b.priority;
+                             return a.order < b.order;
+                           });
+          for (size_t i = field; i != fieldEnd; ++i)
+          {
+            if (patches[i].priority >= floor)
+            {
+              PatchQueue::apply(patches[i], component);
+              stampChange(index, mChangeVersion);
+            }
+          }
+        }
+        else
+        {
+          // Highest priority wins, the earliest patch on ties.
+          size_t resolved = field;
+          for (size_t i = field + 1; i != fieldEnd; ++i)
+          {
+            if (patches[i].priority > patches[resolved].priority)
+              resolved = i;
+          }
+          if (patches[resolved].priority >= floor)
+          {
+            PatchQueue::apply(patches[resolved], component);
+            stampChange(index, mChangeVersion);
+          }
+        }
+        field = fieldEnd;
+      }
+      first = last;
+    }
+
+    mPatches.clear();
+  }
+
+  /// Sorts the items added since the last renormalize into the array.
+  void sortAddedItems(bool stable, std::false_type)
+  {
+    // Sort the entire vector (not just to mLastSortedSize).
+    if (!stable)
+      std::sort(mComponents.begin(), mComponents.end());
+    else
+      std::stable_sort(mComponents.begin(), mComponents.end());
+  }
+
+  /// Trivial items: sorts only the added items, then merges them into the
+  /// sorted prefix from the back. Prefix items are shifted with one memmove
+  /// per added item instead of being sorted again.
+  void sortAddedItems(bool stable, std::true_type)
+  {
+    size_t sorted = static_cast<size_t>(mLastSortedSize);
+    if (sorted == 0)
+    {
+      sortAddedItems(stable, std::false_type());
+      return;
+    }
+
+    ComponentItem* items = &mComponents[0];
+    size_t size = mComponents.size();
+    if (!stable)
+      std::sort(items + sorted, items + size);
+    else
+      std::stable_sort(items + sorted, items + size);
+
+    std::vector<ComponentItem> added(items + sorted, items + size);
+    auto sequenceLess = [](uint64_t sequence, const ComponentItem& item) {return sequence < item.sequence;};
+
+    size_t dest = size;
+    size_t prefix = sorted;
+    for (size_t i = added.size(); i > 0; --i)
+    {
+      // upper_bound: prefix items with the same sequence stay in front, as
+      // with a stable sort of the whole array.
+      const ComponentItem& item = added[i - 1];
+      size_t pos = std::upper_bound(items, items + prefix, item.sequence, sequenceLess) - items;
+      size_t run = prefix - pos;
+      dest -= run;
+      std::memmove(static_cast<void*>(items + dest), items + pos, run * sizeof(ComponentItem));
+      prefix = pos;
+      items[--dest] = item;
+    }
+  }
+
+  /// Validates the input of addComponents. Throws on entity ID 0 and, with
+  /// \p sorted, on pairs out of order.
+  static void checkAddedComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted)
+  {
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (items[i].first == 0)
+      {
+        std::cerr << "cpm-entity-system: Attempting to add a component of entityID 0! Not allowed." << std::endl;
+        throw std::runtime_error("Attempting to add a component of entityID 0.");
+      }
+      if (sorted && i > 0 && items[i].first < items[i - 1].first)
+      {
+        std::cerr << "cpm-entity-system: Components passed to addComponents as sorted are not sorted by entity ID." << std::endl;
+        throw std::runtime_error("Components passed as sorted are not sorted.");
+      }
+    }
+  }
+
+  /// Performs the queued removals on the sorted components. Removed
+  /// components are marked first and the array is compacted in a single
+  /// pass afterwards, so each removal does not shift the tail of the array.
+  void applyRemovals()
+  {
+    std::vector<bool> removed;
+    size_t firstRemoved = markRemovals(removed);
+    eraseRemoved(removed, firstRemoved);
+  }
+
+  /// First half of applyRemovals: runs the removal hooks of the components
+  /// the queued removals remove, flags them in \p removed, one flag per
+  /// sorted component, and empties the queue. Returns the index of the first
+  /// removed component, or the number of sorted components if none is.
+  size_t markRemovals(std::vector<bool>& removed)
+  {
+    size_t size = static_cast<size_t>(mLastSortedSize);
+    removed.assign(size, false);
+    size_t firstRemoved = size;
+
+    auto markRemoved = [&](size_t index)
+    {
+      recordRemoved(mComponents[index]);
+      maybe_component_destruct(mComponents[index].get(), mComponents[index].sequence, 0);
+      removed[index] = true;
+      firstRemoved = std::min(firstRemoved, index);
+    };
+
+    for (RemovalItem& rem : mRemovals)
+    {
+      auto first = mComponents.begin();
+      size_t begin = std::lower_bound(first, first + size, rem.sequence) - first;
+      size_t end = begin;
+      while (end < size && mComponents[end].sequence == rem.sequence)
+        ++end;
+
+      // Components removed by earlier removals this frame are skipped,
+      // exactly as if they had been erased already.
+      if (rem.removeType == REMOVE_ALL)
+      {
+        for (size_t i = begin; i < end; ++i)
+        {
+          if (!removed[i])
+            markRemoved(i);
+        }
+      }
+      else if (rem.removeType == REMOVE_LAST)
+      {
+        for (size_t i = end; i > begin; --i)
+        {
+          if (!removed[i - 1])
+          {
+            markRemoved(i - 1);
+            break;
+          }
+        }
+      }
+      else if (rem.removeType == REMOVE_INDEX)
+      {
+        int index = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+          if (removed[i])
+            continue;
+          if (index == rem.removeIndex)
+          {
+            markRemoved(i);
+            break;
+          }
+          ++index;
+        }
+      }
+      else // if (rem.removeType == REMOVE_FIRST)
+      {
+        for (size_t i = begin; i < end; ++i)
+        {
+          if (!removed[i])
+          {
+            markRemoved(i);
+            break;
+          }
+        }
+      }
+    }
+
+    clearQueue(mRemovals);
+    return firstRemoved;
+  }
+
+  /// Second half of applyRemovals: erases the sorted components flagged in
+  /// \p removed, starting at \p firstRemoved, in a single pass.
+  void eraseRemoved(const std::vector<bool>& removed, size_t firstRemoved)
+  {
+    size_t size = static_cast<size_t>(mLastSortedSize);
+    uint64_t changedFrom = std::numeric_limits<uint64_t>::max();
+    if (firstRemoved < size)
+    {
+      changedFrom = mComponents[firstRemoved].sequence;
+
+      // Move each run of kept items down in one go.
+      ComponentItem* items = &mComponents[0];
+      size_t write = firstRemoved;
+      size_t read = firstRemoved + 1;
+      while (read < size)
+      {
+        while (read < size && removed[read])
+          ++read;
+        size_t runEnd = read;
+        while (runEnd < size && !removed[runEnd])
+          ++runEnd;
+        relocateItems(items + write, items + read, items + runEnd, TrivialItemsTag());
+        write += runEnd - read;
+        read = runEnd;
+      }
+      mComponents.erase(mComponents.begin() + write, mComponents.end());
+      mLastSortedSize = static_cast<int>(write);
+    }
+    changeLayout(changedFrom);
+  }
+
+  /// Drops the sorted components for removeAll. Modifications could only
+  /// refer to them.
+  void applyClear()
+  {
+    mClearPending = false;
+    clearQueue(mModifications);
+    mModificationIndex.clear();
+    mPatches.clear();
+
+    size_t size = static_cast<size_t>(mLastSortedSize);
+    if (ComponentTraits<T>::HasDestructHook || mReactive)
+    {
+      for (size_t i = 0; i < size; ++i)
+      {
+        recordRemoved(mComponents[i]);
+        maybe_component_destruct(mComponents[i].get(), mComponents[i].sequence, 0);
+      }
+    }
+
+    // Pending additions move to the front and are sorted in as usual.
+    if (size == mComponents.size())
+      mComponents.clear();
+    else
+      mComponents.erase(mComponents.begin(), mComponents.begin() + size);
+    mLastSortedSize = 0;
+    changeLayout(0);
+  }
+
+  /// Derived containers call these next to componentConstruct and
+  /// componentDestruct, see setReactive.
+  /// @{
+  template <typename It>
+  void recordAdded(It first, It last)
+  {
+    if (mReactive)
+      mAddedBatch.insert(mAddedBatch.end(), first, last);
+  }
+
+  void recordRemoved(const ComponentItem& item)
+  {
+    if (mReactive)
+      mRemovedBatch.push_back(item);
+  }
+  /// @}
+
+  /// Stamps the component at \p index with \p version.
+  void stampChange(size_t index, uint64_t version)
+  {
+    if (!TrackComponentChanges<T>::value)
+      return;
+
+    mComponents[index].setVersion(version);
+    size_t block = index / ChangeBlockSize;
+    if (mChangeBlocksLayout == getLayoutVersion() && block < mChangeBlocks.size())
+      mChangeBlocks[block] = std::max(mChangeBlocks[block], version);
+  }
+
+  void rebuildChangeBlocks()
+  {
+    size_t size = static_cast<size_t>(mLastSortedSize);
+    mChangeBlocks.assign((size + ChangeBlockSize - 1) / ChangeBlockSize, 0);
+    for (size_t i = 0; i < size; ++i)
+    {
+      uint64_t& block = mChangeBlocks[i / ChangeBlockSize];
+      block = std::max(block, mComponents[i].getVersion());
+    }
+    mChangeBlocksLayout = getLayoutVersion();
+  }
+
+  /// Moves the items in [first, last) down to dest (dest <= first).
+  static void relocateItems(ComponentItem* dest, ComponentItem* first, ComponentItem* last, std::false_type)
+  {
+    std::move(first, last, dest);
+  }
+
+  static void relocateItems(ComponentItem* dest, ComponentItem* first, ComponentItem* last, std::true_type)
+  {
+    if (dest != first)
+      std::memmove(static_cast<void*>(dest), first, (last - first) * sizeof(ComponentItem));
+  }
+
+  static void assignComponent(T& dest, const T& value, std::false_type) {dest = value;}
+  static void assignComponent(T& dest, const T& value, std::true_type)
+  {
+    std::memcpy(static_cast<void*>(&dest), &value, sizeof(T));
+  }
+
+  /// Empties a change queue. Frees its memory if the storage policy asks for
+  /// it (see DefaultComponentStorage::ReleaseQueues).
+  template <typename Queue>
+  static void clearQueue(Queue& queue)
+  {
+    if (ComponentStorageType<T>::ReleaseQueues)
+      Queue().swap(queue);
+    else
+      queue.clear();
+  }
+
   /// \todo Separate out additions to mComponents instead of having them
   ///       added into mComponents. We don't want the address of mComponents
   ///       to change during the frame if we want to execute tasks
   ///       asynchronously against the components. In this sense, we could
   ///       execute systems asynchronously as long as they don't generate
   ///       unintended mutations of global state.
-  std::vector<ComponentItem>    mComponents;    ///< All components currently in the system.
-  std::vector<RemovalItem>      mRemovals;      ///< An array of objects to remove during
+  ComponentArray                mComponents;    ///< All components currently in the system.
+  RemovalQueue                  mRemovals;      ///< An array of objects to remove during
                                                 ///< renormalization.
-  std::vector<ModificationItem> mModifications; ///< An array of objects whose values need
+  ModificationQueue             mModifications; ///< An array of objects whose values need
                                                 ///< to be updated during renormalization.
+  PatchQueue                    mPatches;       ///< Field and functor modifications, applied
+                                                ///< after mModifications.
+  SparseSequenceIndex           mModificationIndex; ///< Component index to slot in
+                                                    ///< mModifications, when coalescing.
+};
+
+/// Selects the container created for components of type T when none is
+/// given explicitly to ESCoreBase::coreAddComponent or coreAddStaticComponent.
+/// Specialize this for a component type to change how it is stored, e.g.:
+///
+///   template <> struct ComponentContainerType<Transform>
+///   {typedef UniqueComponentContainer<Transform> type;};
+///
+/// The specialization must be visible wherever the component is added or
+/// walked by a GenericSystem.
+template <typename T>
+struct ComponentContainerType
+{
+  typedef ComponentContainer<T> type;
 };
 
 } // namespace CPM_ES_NS 
@@ -39,9 +39,9 @@ struct ComponentGroup
     bool operator==(const iterator& other) {return  p_ == other.p_; }
     bool operator!=(const iterator& other) {return  p_ != other.p_; }
 
-    T& operator[](const int& n) {return (p_+n)->component;}
-    T& operator*() {return  p_->component;}
-    T* operator->(){return &p_->component;}
+    T& operator[](const int& n) {return (p_+n)->get();}
+    T& operator*() {return  p_->get();}
+    T* operator->(){return &p_->get();}
 
     uint64_t getEntityID() const {return p_->sequence;}
 
@@ -79,9 +79,9 @@ struct ComponentGroup
     bool operator==(const const_iterator& other) const {return p_ == other.p_; }
     bool operator!=(const const_iterator& other) const {return p_ != other.p_; }
 
-    const T& operator[](const int& n) const {return (p_+n)->component;}
-    const T& operator*()  const {return p_->component;}
-    const T* operator->() const {return  &p_->component;}
+    const T& operator[](const int& n) const {return (p_+n)->get();}
+    const T& operator*()  const {return p_->get();}
+    const T* operator->() const {return  &p_->get();}
 
     uint64_t getEntityID() const {return p_->sequence;}
 
@@ -89,7 +89,7 @@ struct ComponentGroup
     const typename ComponentContainer<T>::ComponentItem* p_;
   };
 
-  const T& operator[](std::size_t idx) const {return components[idx];}
+  const T& operator[](std::size_t idx) const {return components[idx].get();}
   //T& operator[](std::size_t& idx) {return component[idx];}
   std::size_t size() const {return numComponents;}
 
@@ -102,7 +102,7 @@ struct ComponentGroup
   {
     if (numComponents != 0)
     {
-      return components->component;
+      return components->get();
     }
     else
     {
@@ -114,7 +114,7 @@ struct ComponentGroup
   {
     if (numComponents != 0)
     {
-      return components[numComponents - 1].component;
+      return components[numComponents - 1].get();
     }
     else
     {
@@ -140,6 +140,67 @@ struct ComponentGroup
     }
   }
 
+  /// Sets only one field of a component, e.g.
+  /// group.modifyField(&CompAI::alertness, 1.0f). Cheaper than modify for
+  /// large components. See ComponentContainer::modifyFieldIndex.
+  template <typename Field, typename V>
+  void modifyField(Field T::* field, const V& value, size_t componentNum = 0, int priority = 1) const
+  {
+    if (container != nullptr)
+    {
+      container->modifyFieldIndex(field, value, containerIndex + componentNum, priority);
+    }
+    else
+    {
+      std::cerr << "Attempted to modify non-existante container!" << std::endl;
+    }
+  }
+
+  /// Runs functor(T&) on a component at the next renormalize. See
+  /// ComponentContainer::modifyIndexWith.
+  template <typename F>
+  void modifyWith(F&& functor, size_t componentNum = 0, int priority = 1) const
+  {
+    if (container != nullptr)
+    {
+      container->modifyIndexWith(std::forward<F>(functor), containerIndex + componentNum, priority);
+    }
+    else
+    {
+      std::cerr << "Attempted to modify non-existante container!" << std::endl;
+    }
+  }
+
+  /// Combines val into a component, e.g. group.combine(force, CombineSum()).
+  /// See ComponentContainer::combineIndex.
+  template <typename Op>
+  void combine(const T& val, Op op, size_t componentNum = 0, int priority = 1) const
+  {
+    if (container != nullptr)
+    {
+      container->combineIndex(val, containerIndex + componentNum, op, priority);
+    }
+    else
+    {
+      std::cerr << "Attempted to modify non-existante container!" << std::endl;
+    }
+  }
+
+  /// Combines value into one field of a component, e.g.
+  /// group.combineField(&CompHealth::damage, 10, CombineSum()).
+  template <typename Field, typename V, typename Op>
+  void combineField(Field T::* field, const V& value, Op op, size_t componentNum = 0, int priority = 1) const
+  {
+    if (container != nullptr)
+    {
+      container->combineFieldIndex(field, value, containerIndex + componentNum, op, priority);
+    }
+    else
+    {
+      std::cerr << "Attempted to modify non-existante container!" << std::endl;
+    }
+  }
+
   //void modify(T&& val, size_t componentNum = 0, int priority = 1) const
   //{
   //  // Modify value by storing index, in raw array, to modified component.
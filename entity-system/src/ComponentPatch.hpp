@@ -0,0 +1,249 @@
+#ifndef IAUNS_ENTITY_SYSTEM_COMPONENTPATCH_HPP
+#define IAUNS_ENTITY_SYSTEM_COMPONENTPATCH_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ComponentAllocators.hpp"
+
+namespace CPM_ES_NS {
+
+/// Combine policies for combining modifications (see
+/// ComponentContainer::combineIndex). Any associative binary functor
+/// V(const V&, const V&) can be used as well.
+/// @{
+struct CombineSum
+{
+  template <typename V>
+  V operator()(const V& a, const V& b) const {return a + b;}
+};
+
+struct CombineMin
+{
+  template <typename V>
+  V operator()(const V& a, const V& b) const {return (b < a) ? b : a;}
+};
+
+struct CombineMax
+{
+  template <typename V>
+  V operator()(const V& a, const V& b) const {return (a < b) ? b : a;}
+};
+/// @}
+
+/// Queue of partial modifications of components of type T: a single field
+/// set to a value (modifyFieldIndex), a functor run on the component
+/// (modifyIndexWith) or a value combined into the component or one of its
+/// fields (combineIndex, combineFieldIndex). Only the field and its new value
+/// are queued, not a copy of the whole component. Payloads are
+/// bump-allocated from the FrameArena and freed when the queue is cleared at
+/// renormalize.
+///
+/// Every patch gets an order key: the queue's source in the high 32 bits and
+/// its position in the queue in the low bits. Patches merged from several
+/// queues (see ModificationBuffer) therefore resolve the same way whatever
+/// the order in which the queues were merged.
+template <typename T>
+class ComponentPatchQueue
+{
+public:
+  /// Field offset of functor patches, which may touch the whole component.
+  static const size_t AnyField = ~size_t(0);
+
+  struct Patch
+  {
+    size_t    componentIndex;
+    size_t    fieldOffset;    ///< Byte offset of the patched field, or AnyField.
+    uint64_t  order;          ///< Source and position, see above.
+    int       priority;
+    void*     payload;        ///< In the FrameArena.
+    void      (*apply)(T&, void*);
+    void      (*destroy)(void*);
+  };
+
+  explicit ComponentPatchQueue(uint32_t source = 0) :
+      mSource(source),
+      mNextOrder(uint64_t(source) << 32)
+  {}
+  ~ComponentPatchQueue() {clear();}
+
+  ComponentPatchQueue(const ComponentPatchQueue&) = delete;
+  ComponentPatchQueue& operator=(const ComponentPatchQueue&) = delete;
+
+  template <typename Field>
+  void addField(size_t index, size_t fieldOffset, Field T::* field, const Field& value, int priority)
+  {
+    push(index, fieldOffset, priority, new (allocate<FieldPayload<Field>>()) FieldPayload<Field>(field, value));
+  }
+
+  template <typename F>
+  void addFunctor(size_t index, F&& functor, int priority)
+  {
+    typedef FunctorPayload<typename std::decay<F>::type> Payload;
+    push(index, AnyField, priority, new (allocate<Payload>()) Payload(std::forward<F>(functor)));
+  }
+
+  /// component = op(component, value).
+  template <typename Op>
+  void addCombine(size_t index, const T& value, Op op, int priority)
+  {
+    addFunctor(index, CombineComponent<Op>(op, value), priority);
+  }
+
+  /// component.*field = op(component.*field, value).
+  template <typename Field, typename Op>
+  void addFieldCombine(size_t index, Field T::* field, const Field& value, Op op, int priority)
+  {
+    addFunctor(index, CombineField<Field, Op>(field, op, value), priority);
+  }
+
+  /// Moves all patches of \p other to the end of this queue. Their order
+  /// keys are kept.
+  void append(ComponentPatchQueue& other)
+  {
+    mPatches.insert(mPatches.end(), other.mPatches.begin(), other.mPatches.end());
+    other.mPatches.clear();
+    other.mNextOrder = uint64_t(other.mSource) << 32;
+  }
+
+  bool    empty() const {return mPatches.empty();}
+  size_t  size() const  {return mPatches.size();}
+
+  std::vector<Patch>&       patches()       {return mPatches;}
+  const std::vector<Patch>& patches() const {return mPatches;}
+
+  static void apply(const Patch& patch, T& component) {patch.apply(component, patch.payload);}
+
+  /// Destroys all patches. Keeps the memory of the patch list.
+  void clear()
+  {
+    for (Patch& patch : mPatches)
+    {
+      if (patch.destroy != nullptr)
+        patch.destroy(patch.payload);
+      FrameArena::deallocate(patch.payload);
+    }
+    mPatches.clear();
+    mNextOrder = uint64_t(mSource) << 32;
+  }
+
+  void swap(ComponentPatchQueue& other)
+  {
+    mPatches.swap(other.mPatches);
+    std::swap(mNextOrder, other.mNextOrder);
+  }
+
+  /// Replaces the component index of every patch by remap(index). Patches
+  /// for which remap returns AnyField are dropped.
+  template <typename Remap>
+  void remapIndices(Remap remap)
+  {
+    size_t write = 0;
+    for (Patch& patch : mPatches)
+    {
+      size_t index = remap(patch.componentIndex);
+      if (index == AnyField)
+      {
+        if (patch.destroy != nullptr)
+          patch.destroy(patch.payload);
+        FrameArena::deallocate(patch.payload);
+        continue;
+      }
+      patch.componentIndex = index;
+      mPatches[write++] = patch;
+    }
+    mPatches.resize(write);
+  }
+
+private:
+  template <typename Field>
+  struct FieldPayload
+  {
+    FieldPayload(Field T::* fieldIn, const Field& valueIn) : field(fieldIn), value(valueIn) {}
+
+    static void apply(T& component, void* p)
+    {
+      FieldPayload* payload = static_cast<FieldPayload*>(p);
+      component.*(payload->field) = payload->value;
+    }
+
+    Field T::*  field;
+    Field       value;
+  };
+
+  template <typename F>
+  struct FunctorPayload
+  {
+    template <typename G>
+    FunctorPayload(G&& functorIn) : functor(std::forward<G>(functorIn)) {}
+
+    static void apply(T& component, void* p)
+    {
+      static_cast<FunctorPayload*>(p)->functor(component);
+    }
+
+    F functor;
+  };
+
+  template <typename Op>
+  struct CombineComponent
+  {
+    CombineComponent(Op opIn, const T& valueIn) : op(opIn), value(valueIn) {}
+    void operator()(T& component) {component = op(static_cast<const T&>(component), value);}
+
+    Op  op;
+    T   value;
+  };
+
+  template <typename Field, typename Op>
+  struct CombineField
+  {
+    CombineField(Field T::* fieldIn, Op opIn, const Field& valueIn) : field(fieldIn), op(opIn), value(valueIn) {}
+    void operator()(T& component)
+    {
+      component.*field = op(static_cast<const Field&>(component.*field), value);
+    }
+
+    Field T::*  field;
+    Op          op;
+    Field       value;
+  };
+
+  template <typename Payload>
+  static void destroyPayload(void* p)
+  {
+    static_cast<Payload*>(p)->~Payload();
+  }
+
+  template <typename Payload>
+  static void* allocate()
+  {
+    static_assert(alignof(Payload) <= 16, "FrameArena allocations are 16-byte aligned.");
+    return FrameArena::local().allocate(sizeof(Payload));
+  }
+
+  template <typename Payload>
+  void push(size_t index, size_t fieldOffset, int priority, Payload* payload)
+  {
+    Patch patch;
+    patch.componentIndex = index;
+    patch.fieldOffset = fieldOffset;
+    patch.order = mNextOrder++;
+    patch.priority = priority;
+    patch.payload = payload;
+    patch.apply = &Payload::apply;
+    patch.destroy = std::is_trivially_destructible<Payload>::value ? nullptr : &destroyPayload<Payload>;
+    mPatches.push_back(patch);
+  }
+
+  uint32_t            mSource;
+  uint64_t            mNextOrder;
+  std::vector<Patch>  mPatches;
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef IAUNS_ENTITY_SYSTEM_COMPONENTSLAB_HPP
+#define IAUNS_ENTITY_SYSTEM_COMPONENTSLAB_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "ComponentStorage.hpp"
+
+namespace CPM_ES_NS {
+
+/// True when the components of type T are stored out of line: the
+/// container's items then hold a ComponentSlabPtr instead of the component,
+/// see DefaultComponentStorage::OutOfLineBytes.
+template <typename T>
+struct IsOutOfLineComponent : public std::integral_constant<bool,
+       !std::is_empty<T>::value
+    && ComponentStorageType<T>::OutOfLineBytes != 0
+    && sizeof(T) >= ComponentStorageType<T>::OutOfLineBytes>
+{};
+
+/// Stable storage for out-of-line components of type T. Components are
+/// placed in fixed-size slots carved out of large chunks and never move until
+/// destroyed. Freed slots are reused first. One slab per component type is
+/// shared by all containers and threads.
+template <typename T>
+class ComponentSlab
+{
+public:
+  static const size_t ChunkBytes = size_t(256) << 10;
+
+  static ComponentSlab& instance()
+  {
+    // Never destroyed: containers with static storage duration may destroy
+    // components during exit.
+    static ComponentSlab* slab = new ComponentSlab();
+    return *slab;
+  }
+
+  template <class... Args>
+  T* create(Args&&... args)
+  {
+    Slot* slot = acquire();
+    try
+    {
+      return new (&slot->storage) T(std::forward<Args>(args)...);
+    }
+    catch (...)
+    {
+      release(slot);
+      throw;
+    }
+  }
+
+  void destroy(T* component)
+  {
+    component->~T();
+    release(reinterpret_cast<Slot*>(component));
+  }
+
+  /// Number of components alive in the slab.
+  size_t getNumComponents() const
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mNumLive;
+  }
+
+private:
+  union Slot
+  {
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    Slot* next;
+  };
+
+  static const size_t SlotsPerChunk = (ChunkBytes / sizeof(Slot) > 16) ? ChunkBytes / sizeof(Slot) : 16;
+
+  ComponentSlab() :
+      mFree(nullptr),
+      mNumLive(0)
+  {}
+
+  Slot* acquire()
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mFree == nullptr)
+    {
+      // Thread the new chunk's slots onto the free list, first slot first.
+      Slot* chunk = static_cast<Slot*>(::operator new(SlotsPerChunk * sizeof(Slot)));
+      mChunks.push_back(chunk);
+      for (size_t i = SlotsPerChunk; i > 0; --i)
+      {
+        chunk[i - 1].next = mFree;
+        mFree = &chunk[i - 1];
+      }
+    }
+    Slot* slot = mFree;
+    mFree = slot->next;
+    ++mNumLive;
+    return slot;
+  }
+
+  void release(Slot* slot)
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    slot->next = mFree;
+    mFree = slot;
+    --mNumLive;
+  }
+
+  mutable std::mutex  mMutex;
+  std::vector<Slot*>  mChunks;
+  Slot*               mFree;
+  size_t              mNumLive;
+};
+
+/// Owning handle to a component in ComponentSlab<T>. Copying copies the
+/// component into a new slot; moving and swapping only move the pointer,
+/// which is what makes sorting and erasing out-of-line items cheap.
+template <typename T>
+class ComponentSlabPtr
+{
+public:
+  ComponentSlabPtr() : mPtr(ComponentSlab<T>::instance().create()) {}
+  explicit ComponentSlabPtr(const T& component) : mPtr(ComponentSlab<T>::instance().create(component)) {}
+  explicit ComponentSlabPtr(T&& component) : mPtr(ComponentSlab<T>::instance().create(std::move(component))) {}
+
+  ComponentSlabPtr(const ComponentSlabPtr& other) :
+      mPtr(other.mPtr ? ComponentSlab<T>::instance().create(*other.mPtr) : nullptr)
+  {}
+
+  ComponentSlabPtr(ComponentSlabPtr&& other) noexcept : mPtr(other.mPtr)
+  {
+    other.mPtr = nullptr;
+  }
+
+  ~ComponentSlabPtr()
+  {
+    if (mPtr != nullptr)
+      ComponentSlab<T>::instance().destroy(mPtr);
+  }
+
+  ComponentSlabPtr& operator=(const ComponentSlabPtr& other)
+  {
+    if (mPtr != nullptr && other.mPtr != nullptr)
+      *mPtr = *other.mPtr;
+    else
+      ComponentSlabPtr(other).swap(*this);
+    return *this;
+  }
+
+  ComponentSlabPtr& operator=(ComponentSlabPtr&& other) noexcept
+  {
+    swap(other);
+    return *this;
+  }
+
+  void swap(ComponentSlabPtr& other) noexcept {std::swap(mPtr, other.mPtr);}
+
+  T&        operator*()         {return *mPtr;}
+  const T&  operator*() const   {return *mPtr;}
+  T*        get() const         {return mPtr;}
+
+private:
+  T* mPtr;
+};
+
+template <typename T>
+void swap(ComponentSlabPtr<T>& a, ComponentSlabPtr<T>& b) {a.swap(b);}
+
+/// How a component value is held outside of the component array (e.g. in
+/// ModificationItem): by value, or in the slab for out-of-line components.
+template <typename T, bool OutOfLine = IsOutOfLineComponent<T>::value>
+struct ComponentValue
+{
+  typedef T type;
+  static const T& get(const type& value) {return value;}
+};
+
+template <typename T>
+struct ComponentValue<T, true>
+{
+  typedef ComponentSlabPtr<T> type;
+  static const T& get(const type& value) {return *value;}
+};
+
+} // namespace CPM_ES_NS
+
+#endif
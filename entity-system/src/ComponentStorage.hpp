@@ -0,0 +1,89 @@
+#ifndef IAUNS_ENTITY_SYSTEM_COMPONENTSTORAGE_HPP
+#define IAUNS_ENTITY_SYSTEM_COMPONENTSTORAGE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace CPM_ES_NS {
+
+/// Storage policy of ComponentContainer: the array holding the components
+/// and the queues holding removals and modifications until renormalize.
+/// Storage policies derive from this one and replace what they change.
+struct DefaultComponentStorage
+{
+  template <typename Item>
+  struct array {typedef std::vector<Item> type;};
+
+  template <typename Item>
+  struct queue {typedef std::vector<Item> type;};
+
+  /// When true, renormalize frees the memory of the removal and
+  /// modification queues instead of keeping it for the next frame. Set by
+  /// policies whose queue allocator reclaims memory in bulk once every
+  /// allocation was returned (FrameArenaAllocator).
+  static const bool ReleaseQueues = false;
+
+  /// Components at least this large are stored out of line: the array then
+  /// holds only (sequence, handle) pairs pointing into a ComponentSlab, so
+  /// sorting, merging and erasing move 16 bytes per component instead of the
+  /// whole component. 0, the default, keeps every component in the array.
+  /// Component types opt in through ComponentStorageType, e.g. with
+  /// OutOfLineComponentStorage. Out-of-line items have no 'component'
+  /// member; use ComponentItem::get(), or reach them through ComponentGroup
+  /// and system execute pointers as usual.
+  static const size_t OutOfLineBytes = 0;
+};
+
+/// Storage policy using std::vector with the given allocators for the
+/// component array and for the removal and modification queues. See
+/// ComponentAllocators.hpp for allocators.
+template <template <typename> class ArrayAlloc = std::allocator,
+          template <typename> class QueueAlloc = std::allocator,
+          bool ReleaseQueuesAtRenormalize = false>
+struct AllocatorComponentStorage : public DefaultComponentStorage
+{
+  template <typename Item>
+  struct array {typedef std::vector<Item, ArrayAlloc<Item>> type;};
+
+  template <typename Item>
+  struct queue {typedef std::vector<Item, QueueAlloc<Item>> type;};
+
+  static const bool ReleaseQueues = ReleaseQueuesAtRenormalize;
+};
+
+/// Storage policy storing components out of line regardless of their size.
+struct OutOfLineComponentStorage : public DefaultComponentStorage
+{
+  static const size_t OutOfLineBytes = 1;
+};
+
+/// Storage policy storing components of at least \p Bytes out of line,
+/// e.g. for a component type whose size differs between builds.
+template <size_t Bytes>
+struct LargeOutOfLineComponentStorage : public DefaultComponentStorage
+{
+  static const size_t OutOfLineBytes = Bytes;
+};
+
+/// Storage policy keeping components in the array regardless of their size.
+struct InlineComponentStorage : public DefaultComponentStorage
+{
+  static const size_t OutOfLineBytes = 0;
+};
+
+/// Selects the storage policy of ComponentContainer<T>. Specialize this for
+/// a component type to change how its components and queues are stored,
+/// e.g.:
+///
+///   template <> struct ComponentStorageType<Transform>
+///       : AllocatorComponentStorage<HugePageAllocator> {};
+///
+/// Like ComponentContainerType, the specialization must be visible wherever
+/// the component's container is instantiated.
+template <typename T>
+struct ComponentStorageType : public DefaultComponentStorage {};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,331 @@
+#ifndef IAUNS_ENTITY_SYSTEM_DOUBLEBUFFEREDCOMPONENTCONTAINER_HPP
+#define IAUNS_ENTITY_SYSTEM_DOUBLEBUFFEREDCOMPONENTCONTAINER_HPP
+
+#include <iostream>
+#include <stdexcept>
+#include "ComponentContainer.hpp"
+
+namespace CPM_ES_NS {
+
+/// Component container whose next layout is built in a back buffer while
+/// systems keep reading the current (front) one.
+///
+/// Additions are queued in a separate array instead of being appended to
+/// the component array, so nothing writes to the front buffer between
+/// renormalizes. prepareRenormalize hands the queued modifications, additions
+/// and removals to the back buffer. buildBackBuffer copies the front buffer
+/// and applies them, exactly as ComponentContainer::renormalize would
+/// (including componentConstruct / componentDestruct calls, which therefore
+/// happen on the building thread). swapBuffers makes the result the front
+/// buffer, and hands the components added and removed by the back buffer to
+/// reactive systems (see ReactiveSystem).
+///
+/// Modifications queued while the back buffer is built refer to indices in
+/// the old front buffer. swapBuffers maps each to the component at the same
+/// position among its entity's components in the new front buffer, and drops
+/// it if that component no longer exists.
+///
+/// renormalize performs all three steps at once, so the container can be
+/// used with ESCoreBase::renormalize like any other. Static containers are
+/// always renormalized in place.
+template <typename T>
+class DoubleBufferedComponentContainer : public ComponentContainer<T>
+{
+public:
+  typedef ComponentContainer<T>                 Base;
+  typedef typename Base::ComponentItem          ComponentItem;
+  typedef typename Base::RemovalItem            RemovalItem;
+  typedef typename Base::ModificationItem       ModificationItem;
+
+  DoubleBufferedComponentContainer() :
+      mState(IDLE),
+      mBuildLayout(0),
+      mStableSort(false),
+      mAdditionsInOrder(true),
+      mBuildAdditionsInOrder(true)
+  {}
+  virtual ~DoubleBufferedComponentContainer()
+  {
+    // A back buffer that was not swapped in only holds copies.
+    mBack.release();
+  }
+
+  void addComponent(uint64_t sequence, const T& component) override
+  {
+    if (this->isStatic())
+    {
+      Base::addComponent(sequence, component);
+      return;
+    }
+    this->markDirty();
+    mAdditionsInOrder = false;
+    mAdditions.emplace_back(sequence, component);
+  }
+
+  void addComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted = false) override
+  {
+    if (this->isStatic() || count == 0)
+    {
+      Base::addComponents(items, count, sorted);
+      return;
+    }
+    Base::checkAddedComponents(items, count, sorted);
+    this->markDirty();
+    if (!sorted || (!mAdditions.empty() && items[0].first < mAdditions.back().sequence))
+      mAdditionsInOrder = false;
+    mAdditions.reserve(mAdditions.size() + count);
+    for (size_t i = 0; i < count; ++i)
+      mAdditions.emplace_back(items[i].first, items[i].second);
+  }
+
+  int getNumComponentsWithSequence(uint64_t sequence) const override
+  {
+    int numComponents = Base::getNumComponentsWithSequence(sequence);
+    for (const ComponentItem& item : mAdditions)
+    {
+      if (item.sequence == sequence)
+        ++numComponents;
+    }
+    return numComponents;
+  }
+
+  /// Not while a back buffer is built from the front buffer: the writes
+  /// would be lost at swapBuffers.
+  bool canWriteInPlace() const override {return this->isStatic() || mState == IDLE;}
+
+  void renormalize(bool stableSort) override
+  {
+    if (this->isStatic())
+    {
+      Base::renormalize(stableSort);
+      return;
+    }
+
+    // Finish an overlapped renormalize that is still in progress.
+    if (mState != IDLE)
+      swapBuffers();
+
+    prepareRenormalize(stableSort);
+    buildBackBuffer();
+    swapBuffers();
+  }
+
+  void prepareRenormalize(bool stableSort) override
+  {
+    if (this->isStatic())
+    {
+      Base::renormalize(stableSort);
+      return;
+    }
+
+    if (mState != IDLE)
+    {
+      std::cerr << "cpm-entity-system: prepareRenormalize called before the previous back buffer was swapped in." << std::endl;
+      throw std::runtime_error("prepareRenormalize called before swapBuffers.");
+    }
+
+    this->clearDirty();
+
+    mBack.modifications().swap(this->mModifications);
+    mBack.patches().swap(this->mPatches);
+    this->reindexModifications();
+    mBack.removals().swap(this->mRemovals);
+    mBack.clearPending() = this->mClearPending;
+    this->mClearPending = false;
+    mBuildAdditions.swap(mAdditions);
+    mBuildAdditionsInOrder = mAdditionsInOrder;
+    mAdditionsInOrder = true;
+    mStableSort = stableSort;
+
+    // If nothing changes, the front buffer stays as it is and there is no
+    // back buffer to build.
+    if (   mBack.hasPendingModifications() || !mBack.removals().empty()
+        || !mBuildAdditions.empty() || mBack.clearPending())
+      mState = PREPARED;
+  }
+
+  bool isBuildPending() const override {return mState == PREPARED;}
+
+  void buildBackBuffer() override
+  {
+    if (mState != PREPARED)
+      return;
+
+    // The additions need no sort if they are in order and follow the front
+    // buffer, which may have changed since they were queued.
+    typename Base::ComponentArray& back = mBack.components();
+    back.assign(this->mComponents.begin(), this->mComponents.begin() + this->mLastSortedSize);
+    mBack.addedInOrder() = mBuildAdditionsInOrder
+        && (back.empty() || mBuildAdditions.empty() || !(mBuildAdditions.front() < back.back()));
+    back.insert(back.end(), mBuildAdditions.begin(), mBuildAdditions.end());
+    mBuildAdditions.clear();
+
+    mBack.mLastSortedSize = this->mLastSortedSize;
+    mBack.changeVersion() = this->mChangeVersion;
+    mBack.setReactive(this->mReactive);
+    mBuildLayout = mBack.getLayoutVersion();
+    mBack.renormalize(mStableSort);
+    mState = BUILT;
+  }
+
+  void swapBuffers() override
+  {
+    if (mState == PREPARED)
+      buildBackBuffer();
+
+    if (mState != BUILT)
+      return;
+
+    // Translate modifications and patches queued against the old front
+    // buffer into (sequence, position within the entity's components).
+    auto target = [this](size_t componentIndex)
+    {
+      if (componentIndex >= static_cast<size_t>(this->mLastSortedSize))
+        return std::make_pair(uint64_t(0), size_t(0));
+      uint64_t sequence = this->mComponents[componentIndex].sequence;
+      size_t first = static_cast<size_t>(this->getComponentItemIndexWithSequence(sequence));
+      return std::make_pair(sequence, componentIndex - first);
+    };
+
+    std::vector<std::pair<uint64_t, size_t>> targets;
+    targets.reserve(this->mModifications.size() + this->mPatches.size());
+    for (const ModificationItem& mod : this->mModifications)
+      targets.push_back(target(mod.componentIndex));
+    for (const typename Base::Patch& patch : this->mPatches.patches())
+      targets.push_back(target(patch.componentIndex));
+
+    this->mComponents.swap(mBack.components());
+    this->mLastSortedSize = mBack.mLastSortedSize;
+    this->mUpperSequence  = mBack.mUpperSequence;
+    this->mLowerSequence  = mBack.mLowerSequence;
+    this->mChangeVersion  = mBack.changeVersion();
+    this->changeLayout(mBack.getLayoutChangedFrom(mBuildLayout));
+    if (this->mReactive)
+    {
+      this->mAddedBatch.insert(this->mAddedBatch.end(), mBack.getAddedBatch().begin(), mBack.getAddedBatch().end());
+      this->mRemovedBatch.insert(this->mRemovedBatch.end(), mBack.getRemovedBatch().begin(), mBack.getRemovedBatch().end());
+    }
+    mBack.clearReactiveBatches();
+    mBack.release();
+
+    // Index of a target in the new front buffer, or AnyField if its
+    // component is gone.
+    auto resolve = [this](const std::pair<uint64_t, size_t>& t)
+    {
+      if (t.first == 0)
+        return Base::PatchQueue::AnyField;
+
+      int first = this->getComponentItemIndexWithSequence(t.first);
+      if (first == -1)
+        return Base::PatchQueue::AnyField;
+
+      size_t index = static_cast<size_t>(first) + t.second;
+      if (   index < static_cast<size_t>(this->mLastSortedSize)
+          && this->mComponents[index].sequence == t.first)
+        return index;
+      return Base::PatchQueue::AnyField;
+    };
+
+    typename Base::ModificationQueue mods;
+    mods.swap(this->mModifications);
+    for (size_t i = 0; i < mods.size(); ++i)
+    {
+      size_t index = resolve(targets[i]);
+      if (index != Base::PatchQueue::AnyField)
+      {
+        mods[i].componentIndex = index;
+        this->mModifications.push_back(mods[i]);
+      }
+    }
+
+    this->reindexModifications();
+
+    size_t patch = mods.size();
+    this->mPatches.remapIndices([&](size_t) {return resolve(targets[patch++]);});
+
+    mState = IDLE;
+  }
+
+  /// While a back buffer is built, the additions handed to it are still
+  /// pending and must survive the clear, but they are merged into the front
+  /// buffer at swapBuffers. The entities of the current front buffer are
+  /// removed one by one instead.
+  void removeAll() override
+  {
+    if (mState == IDLE || this->isStatic())
+    {
+      Base::removeAll();
+      return;
+    }
+
+    uint64_t last = 0;
+    for (int i = 0; i < this->mLastSortedSize; ++i)
+    {
+      if (this->mComponents[i].sequence != last)
+      {
+        last = this->mComponents[i].sequence;
+        this->removeSequence(last);
+      }
+    }
+  }
+
+  void removeAllImmediately() override
+  {
+    Base::removeAllImmediately();
+    mAdditions.clear();
+    mBuildAdditions.clear();
+    mAdditionsInOrder = true;
+    mBack.release();
+    mState = IDLE;
+  }
+
+protected:
+
+  /// Exposes the buffers of a ComponentContainer used as back buffer.
+  class BackBuffer : public ComponentContainer<T>
+  {
+  public:
+    typename Base::ComponentArray&    components()    {return this->mComponents;}
+    typename Base::RemovalQueue&      removals()      {return this->mRemovals;}
+    typename Base::ModificationQueue& modifications() {return this->mModifications;}
+    typename Base::PatchQueue&        patches()       {return this->mPatches;}
+    uint64_t&                         changeVersion() {return this->mChangeVersion;}
+    bool&                             clearPending()  {return this->mClearPending;}
+    bool&                             addedInOrder()  {return this->mAddedInOrder;}
+
+    /// Forgets all components without calling componentDestruct. The
+    /// components are owned by the front buffer.
+    void release()
+    {
+      this->mComponents.clear();
+      this->mRemovals.clear();
+      this->mModifications.clear();
+      this->mPatches.clear();
+      this->mClearPending = false;
+      this->mAddedInOrder = true;
+      this->mLastSortedSize = 0;
+      this->mUpperSequence = 0;
+      this->mLowerSequence = 0;
+    }
+  };
+
+  enum BUILD_STATE
+  {
+    IDLE,       ///< No renormalize in progress.
+    PREPARED,   ///< Changes handed to the back buffer.
+    BUILT       ///< Back buffer holds the next layout.
+  };
+
+  BackBuffer                  mBack;
+  std::vector<ComponentItem>  mAdditions;       ///< Queued since the last prepareRenormalize.
+  std::vector<ComponentItem>  mBuildAdditions;  ///< Handed to the back buffer.
+  BUILD_STATE                 mState;
+  uint64_t                    mBuildLayout;     ///< Layout version of mBack before it was built.
+  bool                        mStableSort;
+  bool                        mAdditionsInOrder;      ///< See ComponentContainer::mAddedInOrder.
+  bool                        mBuildAdditionsInOrder; ///< Same, for mBuildAdditions.
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,267 @@
+#ifndef IAUNS_ENTITY_SYSTEM_DUPLICATEAWARECOMPONENTCONTAINER_HPP
+#define IAUNS_ENTITY_SYSTEM_DUPLICATEAWARECOMPONENTCONTAINER_HPP
+
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include "ComponentContainer.hpp"
+
+namespace CPM_ES_NS {
+
+/// Hash used by DuplicateAwareComponentContainer. Defaults to std::hash<T>.
+/// Specialize this for component types that have no std::hash.
+template <typename T>
+struct ComponentHash
+{
+  size_t operator()(const T& component) const {return std::hash<T>()(component);}
+};
+
+/// Interface through which hasDuplicateComponent queries containers that
+/// index their component values. Independent of the hash in use, so testing
+/// for it does not require T to be hashable.
+template <typename T>
+class ComponentDuplicateIndex
+{
+public:
+  virtual ~ComponentDuplicateIndex() {}
+
+  /// Returns true if \p sequence has a component equal to \p component,
+  /// including components added since the last renormalize.
+  virtual bool hasDuplicate(uint64_t sequence, const T& component) const = 0;
+};
+
+/// Component container that indexes component values per entity, so
+/// hasDuplicate can tell whether an entity already holds a component equal
+/// to a given one without walking the entity's components.
+///
+/// Every component is indexed by (sequence, value hash) along with its
+/// position in the component array, so a hash hit is confirmed by comparing
+/// against that one component with operator==, which T must provide, as
+/// does hasDuplicateComponent. Pending additions are indexed separately by
+/// their position in the pending part of the array, so they are covered by
+/// hasDuplicate before the next renormalize as well. Renormalize only
+/// reindexes the components from the first one that moved or was modified.
+/// Static components are not indexed.
+///
+/// With setDropDuplicates(true), renormalize removes every component that
+/// is equal to another component of the same entity, keeping one.
+template <typename T>
+class DuplicateAwareComponentContainer : public ComponentContainer<T>,
+                                         public ComponentDuplicateIndex<T>
+{
+public:
+  typedef ComponentContainer<T>                 Base;
+  typedef typename Base::ComponentItem          ComponentItem;
+
+  DuplicateAwareComponentContainer() : mDropDuplicates(false) {}
+  virtual ~DuplicateAwareComponentContainer() {}
+
+  /// When true, duplicate components of an entity are removed during
+  /// renormalize.
+  void setDropDuplicates(bool drop)  {mDropDuplicates = drop;}
+  bool getDropDuplicates() const     {return mDropDuplicates;}
+
+  void addComponent(uint64_t sequence, const T& component) override
+  {
+    // May perform a deferred renormalize, which moves pending additions.
+    this->markDirty();
+    size_t index = this->mComponents.size();
+    Base::addComponent(sequence, component);
+    mPending.insert(std::make_pair(Key(sequence, mHash(component)), index));
+  }
+
+  void addComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted = false) override
+  {
+    if (count == 0)
+      return;
+
+    this->markDirty();
+    size_t index = this->mComponents.size();
+    Base::addComponents(items, count, sorted);
+    for (size_t i = 0; i < count; ++i)
+      mPending.insert(std::make_pair(Key(items[i].first, mHash(items[i].second)), index + i));
+  }
+
+  /// In place writes would bypass the value index.
+  bool canWriteInPlace() const override {return this->isStatic();}
+
+  bool hasDuplicate(uint64_t sequence, const T& component) const override
+  {
+    Key key(sequence, mHash(component));
+
+    auto range = mSorted.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (this->mComponents[it->second].get() == component)
+        return true;
+    }
+
+    range = mPending.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (this->mComponents[it->second].get() == component)
+        return true;
+    }
+
+    return false;
+  }
+
+  void renormalize(bool stableSort) override
+  {
+    // Modified components keep their position, but may change their value.
+    uint64_t modifiedFrom = firstModifiedSequence();
+    uint64_t layoutVersion = this->getLayoutVersion();
+    bool added = !mPending.empty();
+
+    Base::renormalize(stableSort);
+
+    if (this->isStatic())
+      return;
+
+    if (mDropDuplicates && (added || modifiedFrom != std::numeric_limits<uint64_t>::max()))
+      dropDuplicates();
+
+    uint64_t from = std::min(modifiedFrom, this->getLayoutChangedFrom(layoutVersion));
+    if (from != std::numeric_limits<uint64_t>::max())
+      reindexFrom(from);
+    mPending.clear();
+  }
+
+  void removeAllImmediately() override
+  {
+    Base::removeAllImmediately();
+    mSorted.clear();
+    mKeys.clear();
+    mPending.clear();
+  }
+
+protected:
+
+  struct Key
+  {
+    Key(uint64_t seq, size_t h) : sequence(seq), hash(h) {}
+
+    bool operator==(const Key& other) const
+    {
+      return sequence == other.sequence && hash == other.hash;
+    }
+
+    uint64_t  sequence;
+    size_t    hash;
+  };
+
+  struct KeyHash
+  {
+    size_t operator()(const Key& key) const
+    {
+      size_t h = std::hash<uint64_t>()(key.sequence);
+      return h ^ (key.hash + 0x9e3779b9 + (h << 6) + (h >> 2));
+    }
+  };
+
+  /// Sequence of the first component with a queued modification or patch.
+  uint64_t firstModifiedSequence() const
+  {
+    size_t first = static_cast<size_t>(this->mLastSortedSize);
+    for (const typename Base::ModificationItem& mod : this->mModifications)
+      first = std::min(first, mod.componentIndex);
+    for (const typename Base::Patch& patch : this->mPatches.patches())
+      first = std::min(first, patch.componentIndex);
+
+    if (first >= static_cast<size_t>(this->mLastSortedSize))
+      return std::numeric_limits<uint64_t>::max();
+    return this->mComponents[first].sequence;
+  }
+
+  /// Reindexes the sorted components with sequences from \p from onwards.
+  /// Components before them kept their position and value.
+  void reindexFrom(uint64_t from)
+  {
+    auto bySequence = [](const Key& key, uint64_t sequence) {return key.sequence < sequence;};
+    size_t keep = std::lower_bound(mKeys.begin(), mKeys.end(), from, bySequence) - mKeys.begin();
+    if (keep == 0)
+    {
+      mSorted.clear();
+    }
+    else
+    {
+      for (size_t i = keep; i < mKeys.size(); ++i)
+      {
+        auto range = mSorted.equal_range(mKeys[i]);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+          if (it->second == i)
+          {
+            mSorted.erase(it);
+            break;
+          }
+        }
+      }
+    }
+    mKeys.erase(mKeys.begin() + keep, mKeys.end());
+
+    size_t size = static_cast<size_t>(this->mLastSortedSize);
+    for (size_t i = keep; i < size; ++i)
+    {
+      const ComponentItem& item = this->mComponents[i];
+      Key key(item.sequence, mHash(item.get()));
+      mKeys.push_back(key);
+      mSorted.insert(std::make_pair(key, i));
+    }
+  }
+
+  /// Removes components equal to an earlier component of the same entity.
+  void dropDuplicates()
+  {
+    int size = this->mLastSortedSize;
+    int write = 0;
+    int runStart = 0;
+    uint64_t changedFrom = std::numeric_limits<uint64_t>::max();
+    for (int read = 0; read < size; ++read)
+    {
+      ComponentItem& item = this->mComponents[read];
+      if (write == 0 || this->mComponents[write - 1].sequence != item.sequence)
+        runStart = write;
+
+      // Runs are short, compare against the kept components of the entity.
+      bool duplicate = false;
+      for (int k = runStart; k < write; ++k)
+      {
+        if (this->mComponents[k].get() == item.get())
+        {
+          duplicate = true;
+          break;
+        }
+      }
+
+      if (duplicate)
+      {
+        changedFrom = std::min(changedFrom, item.sequence);
+        this->recordRemoved(item);
+        Base::maybe_component_destruct(item.get(), item.sequence, 0);
+        continue;
+      }
+
+      if (write != read)
+        this->mComponents[write] = std::move(item);
+      ++write;
+    }
+
+    if (write == size)
+      return;
+
+    this->mComponents.erase(this->mComponents.begin() + write, this->mComponents.end());
+    this->mLastSortedSize = write;
+    this->changeLayout(changedFrom);
+  }
+
+  bool                                                  mDropDuplicates;
+  ComponentHash<T>                                      mHash;
+  std::unordered_multimap<Key, size_t, KeyHash>         mSorted;   ///< Sorted components, by index.
+  std::vector<Key>                                      mKeys;     ///< Key of each sorted component.
+  std::unordered_multimap<Key, size_t, KeyHash>         mPending;  ///< Pending additions, by index.
+};
+
+} // namespace CPM_ES_NS
+
+#endif
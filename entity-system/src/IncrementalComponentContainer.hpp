@@ -0,0 +1,736 @@
+#ifndef IAUNS_ENTITY_SYSTEM_INCREMENTALCOMPONENTCONTAINER_HPP
+#define IAUNS_ENTITY_SYSTEM_INCREMENTALCOMPONENTCONTAINER_HPP
+
+#include <chrono>
+#include <limits>
+#include "ComponentContainer.hpp"
+
+namespace CPM_ES_NS {
+
+/// Component container that can spread the cost of sorting in large numbers
+/// of additions over several renormalizes.
+///
+/// Additions are staged outside of the component array. At renormalize the
+/// staged additions are sealed into a batch, which is advanced step by step
+/// until the time budget for the renormalize is spent. No step handles more
+/// than RunSize components: the batch is sorted in runs of RunSize, the runs
+/// are merged pairwise into a second buffer, and the sorted batch is merged
+/// with the visible components into a third one, each merge resuming from
+/// saved cursors. The merged components become visible together, when the
+/// third buffer is swapped with the component array. Systems never see a
+/// partially merged batch. The buffers are emptied again RunSize components
+/// per step. Additions made while a batch is in progress go into the next
+/// batch.
+///
+/// While the visible components are being merged, they are copied, not
+/// moved, since systems still walk them. Modifications and removals of
+/// components that were already copied are applied to their copy as well,
+/// and systems cannot write in place (see canWriteInPlace). Removed copies
+/// are erased when the batch becomes visible, in the single pass any
+/// renormalize with removals makes.
+///
+/// Removals of all of an entity's components (removeEntity) also drop the
+/// entity's additions that are not visible yet. Any other removal (first,
+/// last or by index) applies to the entity's components that are visible
+/// once the renormalize's merge steps are done, so with a time budget it may
+/// not see additions still in progress. Modifications only apply to visible
+/// components, as usual. Components are always stable sorted.
+///
+/// componentConstruct is called as added components are merged. Reactive
+/// batches (see ReactiveSystem) and change versions report them when they
+/// become visible.
+///
+/// A time budget of zero, the default, merges all additions synchronously
+/// at every renormalize, with one sort and one in place merge.
+template <typename T>
+class IncrementalComponentContainer : public ComponentContainer<T>
+{
+public:
+  typedef ComponentContainer<T>                 Base;
+  typedef typename Base::ComponentItem          ComponentItem;
+  typedef typename Base::RemovalItem            RemovalItem;
+  typedef typename Base::ModificationItem       ModificationItem;
+
+  /// Largest number of components handled by one step.
+  static const size_t RunSize = 4096;
+
+  IncrementalComponentContainer() :
+      mBudget(0),
+      mPhase(IDLE),
+      mCursor(0),
+      mWidth(0),
+      mLeft(0),
+      mRight(0),
+      mOut(0),
+      mVisibleCursor(0),
+      mNumDead(0),
+      mFirstAdded(0),
+      mMergeVersion(0),
+      mStepsDone(0),
+      mStepsTotal(0),
+      mLargestStep(0)
+  {}
+  virtual ~IncrementalComponentContainer() {}
+
+  /// Time spent merging additions per renormalize. At least one step is
+  /// always performed.
+  void setTimeBudget(std::chrono::microseconds budget)  {mBudget = budget;}
+  std::chrono::microseconds getTimeBudget() const       {return mBudget;}
+
+  void addComponent(uint64_t sequence, const T& component) override
+  {
+    if (this->isStatic())
+    {
+      Base::addComponent(sequence, component);
+      return;
+    }
+    this->markDirty();
+    mStaged.emplace_back(sequence, component);
+  }
+
+  void addComponents(const std::pair<uint64_t, T>* items, size_t count, bool sorted = false) override
+  {
+    if (this->isStatic() || count == 0)
+    {
+      Base::addComponents(items, count, sorted);
+      return;
+    }
+    Base::checkAddedComponents(items, count, sorted);
+    this->markDirty();
+    mStaged.reserve(mStaged.size() + count);
+    for (size_t i = 0; i < count; ++i)
+      mStaged.emplace_back(items[i].first, items[i].second);
+  }
+
+  /// Returns true while added components are waiting to become visible.
+  bool isMergeInProgress() const {return isBatchActive() || !mStaged.empty();}
+
+  /// Number of added components that are not visible yet. Includes
+  /// components that will be dropped by removals when their batch completes.
+  size_t getNumPendingComponents() const
+  {
+    return mStaged.size() + (isBatchActive() ? mBatch.size() : 0);
+  }
+
+  /// Fraction, in [0, 1], of the current batch's merge steps that have been
+  /// performed. 1 if no batch is in progress.
+  double getMergeProgress() const
+  {
+    if (!isBatchActive() || mStepsTotal == 0)
+      return 1.0;
+    return static_cast<double>(mStepsDone) / static_cast<double>(mStepsTotal);
+  }
+
+  /// Estimated number of merge steps left in the current batch.
+  size_t getRemainingMergeSteps() const {return isBatchActive() ? mStepsTotal - mStepsDone : 0;}
+
+  /// Largest number of components a single step has handled so far. Never
+  /// more than RunSize.
+  size_t getLargestStepSize() const {return mLargestStep;}
+
+  /// Merges all pending additions immediately.
+  void finishMerge()
+  {
+    // Systems that walked since the last renormalize have seen the current
+    // change version; the merged components need a later one.
+    if (TrackComponentChanges<T>::value && isMergeInProgress())
+      ++this->mChangeVersion;
+    completeMerge();
+  }
+
+  /// In place writes would not reach the copies of visible components.
+  bool canWriteInPlace() const override {return mPhase != FINAL;}
+
+  void renormalize(bool stableSort) override
+  {
+    if (this->isStatic())
+    {
+      Base::renormalize(stableSort);
+      return;
+    }
+
+    // Modifications refer to the visible layout: apply them before merging.
+    // Removals are applied once, after this renormalize's merge steps.
+    bool copying = (mPhase == FINAL);
+    bool cleared = this->isClearPending();
+    std::vector<size_t> modified;
+    if (copying && !cleared)
+      collectModified(modified);
+
+    typename Base::RemovalQueue removals;
+    removals.swap(this->mRemovals);
+    Base::renormalize(stableSort);
+    this->mRemovals.swap(removals);
+
+    if (copying)
+    {
+      if (cleared)
+        dropVisibleCopies();
+      else
+        copyModified(modified);
+    }
+
+    if (mBudget.count() == 0)
+    {
+      completeMerge();
+    }
+    else
+    {
+      dropPending(this->mRemovals);
+      advance(std::chrono::steady_clock::now() + mBudget);
+    }
+
+    if (this->mRemovals.size() > 0)
+    {
+      std::vector<bool> removed;
+      size_t firstRemoved = this->markRemovals(removed);
+      if (mPhase == FINAL)
+        dropRemovedCopies(removed, firstRemoved);
+      this->eraseRemoved(removed, firstRemoved);
+    }
+
+    // Stay on the core's dirty list until the merge completes and its
+    // buffers are emptied.
+    if (mPhase != IDLE || !mStaged.empty())
+      this->markDirty();
+  }
+
+  int getNumComponentsWithSequence(uint64_t sequence) const override
+  {
+    int numComponents = Base::getNumComponentsWithSequence(sequence);
+    for (const ComponentItem& item : mStaged)
+    {
+      if (item.sequence == sequence)
+        ++numComponents;
+    }
+    // Merged batch components keep their sequence.
+    if (isBatchActive() && !isDropped(sequence))
+    {
+      for (const ComponentItem& item : mBatch)
+      {
+        if (item.sequence == sequence)
+          ++numComponents;
+      }
+    }
+    return numComponents;
+  }
+
+  void collectChangedSequences(uint64_t version, std::vector<uint64_t>& sequences) override
+  {
+    // Components are stamped as they are merged but only become visible
+    // with their batch. Report them to anyone who had not seen a version
+    // older than the batch's first merge step.
+    for (auto it = mMergeVersions.rbegin(); it != mMergeVersions.rend(); ++it)
+    {
+      if (version >= it->first && version < it->second)
+        version = it->first - 1;
+    }
+    Base::collectChangedSequences(version, sequences);
+  }
+
+  void removeAllImmediately() override
+  {
+    Base::removeAllImmediately();
+    mStaged.clear();
+    mBatch.clear();
+    mScratch.clear();
+    mMerged.clear();
+    mMergedState.clear();
+    mDropped.clear();
+    mAdded.clear();
+    mRemoved.clear();
+    mNumDead = 0;
+    mPhase = IDLE;
+  }
+
+protected:
+
+  enum MERGE_PHASE
+  {
+    IDLE,       ///< No batch in progress.
+    SORT_RUNS,  ///< Sorting runs of RunSize components.
+    MERGE_RUNS, ///< Merging pairs of sorted ranges of mWidth components into mScratch.
+    FINAL,      ///< Merging the sorted batch and the visible components into mMerged.
+    RELEASE     ///< Emptying the buffers of the completed batch.
+  };
+
+  /// Origin of each component in mMerged.
+  enum MERGED_STATE
+  {
+    MERGED_VISIBLE,   ///< Copy of a visible component.
+    MERGED_BATCH,     ///< Component of the batch.
+    MERGED_DEAD       ///< Removed since it was merged.
+  };
+
+  bool isBatchActive() const {return mPhase != IDLE && mPhase != RELEASE;}
+
+  void advance(std::chrono::steady_clock::time_point deadline)
+  {
+    do
+    {
+      if (mPhase == IDLE)
+      {
+        if (mStaged.empty())
+          return;
+        startBatch();
+      }
+      step(false);
+    } while (std::chrono::steady_clock::now() < deadline);
+  }
+
+  /// Completes the current and the staged batch, then empties the buffers
+  /// without bounding the work.
+  void completeMerge()
+  {
+    // Nothing reads the visible components until the batch completes.
+    while (isBatchActive())
+      step(true);
+    releaseAll();
+
+    if (!mStaged.empty())
+      mergeStaged();
+  }
+
+  /// Sorts the staged additions and merges them into the component array
+  /// in place, as ComponentContainer does.
+  void mergeStaged()
+  {
+    std::stable_sort(mStaged.begin(), mStaged.end());
+
+    size_t visible = static_cast<size_t>(this->mLastSortedSize);
+    this->mComponents.reserve(visible + mStaged.size());
+    for (ComponentItem& item : mStaged)
+    {
+      item.setVersion(this->mChangeVersion);
+      Base::maybe_component_construct(item.get(), item.sequence, 0);
+      this->mComponents.push_back(std::move(item));
+    }
+    mStaged.clear();
+    this->recordAdded(this->mComponents.begin() + visible, this->mComponents.end());
+
+    uint64_t firstAdded = this->mComponents[visible].sequence;
+    std::inplace_merge(this->mComponents.begin(), this->mComponents.begin() + visible,
+                       this->mComponents.end());
+    this->mLastSortedSize = static_cast<int>(this->mComponents.size());
+    this->mLowerSequence = this->mComponents.front().sequence;
+    this->mUpperSequence = this->mComponents.back().sequence;
+    this->changeLayout(firstAdded);
+  }
+
+  void startBatch()
+  {
+    mBatch.swap(mStaged);
+    mStaged.clear();
+    mDropped.clear();
+
+    size_t n = mBatch.size();
+    size_t steps = (n + RunSize - 1) / RunSize;
+    size_t passes = 0;
+    for (size_t w = RunSize; w < n; w *= 2)
+      ++passes;
+    size_t visible = static_cast<size_t>(this->mLastSortedSize);
+    mStepsTotal = steps * (passes + 1) + (visible + n + RunSize - 1) / RunSize;
+    mStepsDone = 0;
+    mCursor = 0;
+    mPhase = SORT_RUNS;
+  }
+
+  /// Performs one unit of work, handling at most RunSize components. With
+  /// \p moveVisible, visible components are moved instead of copied.
+  void step(bool moveVisible)
+  {
+    size_t n = mBatch.size();
+    size_t handled = 0;
+
+    if (mPhase == SORT_RUNS)
+    {
+      size_t end = std::min(mCursor + RunSize, n);
+      std::stable_sort(mBatch.begin() + mCursor, mBatch.begin() + end);
+      handled = end - mCursor;
+      mCursor = end;
+      if (mCursor >= n)
+      {
+        mWidth = RunSize;
+        if (mWidth >= n)
+          startFinal();
+        else
+          startPass();
+      }
+    }
+    else if (mPhase == MERGE_RUNS)
+    {
+      handled = mergeRuns();
+    }
+    else if (mPhase == FINAL)
+    {
+      handled = mergeVisible(moveVisible);
+    }
+    else if (mPhase == RELEASE)
+    {
+      handled = release(RunSize);
+    }
+
+    mLargestStep = std::max(mLargestStep, handled);
+    if (isBatchActive())
+      mStepsDone = std::min(mStepsDone + 1, mStepsTotal - 1);
+  }
+
+  void startPass()
+  {
+    mScratch.reserve(mBatch.size());
+    mCursor = 0;
+    mLeft = 0;
+    mRight = std::min(mWidth, mBatch.size());
+    mOut = 0;
+    mPhase = MERGE_RUNS;
+  }
+
+  /// Merges pairs of sorted ranges of mWidth components of mBatch into
+  /// mScratch, resuming at the saved cursors.
+  size_t mergeRuns()
+  {
+    size_t n = mBatch.size();
+    size_t handled = 0;
+    while (handled < RunSize && mOut < n)
+    {
+      size_t middle = std::min(mCursor + mWidth, n);
+      size_t end = std::min(mCursor + 2 * mWidth, n);
+      if (mLeft == middle && mRight == end)
+      {
+        mCursor = end;
+        mLeft = end;
+        mRight = std::min(end + mWidth, n);
+        continue;
+      }
+
+      size_t take;
+      if (mRight == end || (mLeft < middle && !(mBatch[mRight].sequence < mBatch[mLeft].sequence)))
+        take = mLeft++;
+      else
+        take = mRight++;
+
+      // The first pass fills mScratch, later passes reuse its items.
+      if (mScratch.size() < n)
+        mScratch.push_back(std::move(mBatch[take]));
+      else
+        mScratch[mOut] = std::move(mBatch[take]);
+      ++mOut;
+      ++handled;
+    }
+
+    if (mOut == n)
+    {
+      mBatch.swap(mScratch);
+      mWidth *= 2;
+      if (mWidth >= n)
+        startFinal();
+      else
+        startPass();
+    }
+    return handled;
+  }
+
+  void startFinal()
+  {
+    size_t visible = static_cast<size_t>(this->mLastSortedSize);
+    mMerged.reserve(visible + mBatch.size());
+    mMergedState.reserve(visible + mBatch.size());
+    mCursor = 0;
+    mVisibleCursor = 0;
+    mNumDead = 0;
+    mFirstAdded = std::numeric_limits<uint64_t>::max();
+    mMergeVersion = this->mChangeVersion;
+    mPhase = FINAL;
+  }
+
+  /// Merges the sorted batch and the visible components into mMerged,
+  /// resuming at the saved cursors. Completes the batch once both are
+  /// merged.
+  size_t mergeVisible(bool moveVisible)
+  {
+    size_t n = mBatch.size();
+    size_t visible = static_cast<size_t>(this->mLastSortedSize);
+    size_t handled = 0;
+    while (handled < RunSize && (mVisibleCursor < visible || mCursor < n))
+    {
+      ++handled;
+
+      // Existing components go before added ones of the same entity.
+      if (   mCursor == n
+          || (   mVisibleCursor < visible
+              && !(mBatch[mCursor].sequence < this->mComponents[mVisibleCursor].sequence)))
+      {
+        if (moveVisible)
+          mMerged.push_back(std::move(this->mComponents[mVisibleCursor]));
+        else
+          mMerged.push_back(this->mComponents[mVisibleCursor]);
+        mMergedState.push_back(MERGED_VISIBLE);
+        ++mVisibleCursor;
+        continue;
+      }
+
+      ComponentItem& item = mBatch[mCursor++];
+      if (isDropped(item.sequence))
+        continue;
+      item.setVersion(this->mChangeVersion);
+      Base::maybe_component_construct(item.get(), item.sequence, 0);
+      if (this->isReactive())
+        mAdded.push_back(item);
+      mFirstAdded = std::min(mFirstAdded, item.sequence);
+      mMerged.push_back(std::move(item));
+      mMergedState.push_back(MERGED_BATCH);
+    }
+
+    if (mVisibleCursor == visible && mCursor == n)
+      completeBatch();
+    return handled;
+  }
+
+  /// Makes the merged components visible.
+  void completeBatch()
+  {
+    this->mComponents.swap(mMerged);
+    this->mLastSortedSize = static_cast<int>(this->mComponents.size());
+    if (this->mComponents.empty())
+    {
+      this->mLowerSequence = 0;
+      this->mUpperSequence = 0;
+    }
+    else
+    {
+      this->mLowerSequence = this->mComponents.front().sequence;
+      this->mUpperSequence = this->mComponents.back().sequence;
+    }
+    if (mFirstAdded != std::numeric_limits<uint64_t>::max())
+      this->changeLayout(mFirstAdded);
+
+    if (mNumDead > 0)
+    {
+      size_t size = mMergedState.size();
+      std::vector<bool> removed(size, false);
+      size_t firstRemoved = size;
+      for (size_t i = 0; i < size; ++i)
+      {
+        if (mMergedState[i] == MERGED_DEAD)
+        {
+          removed[i] = true;
+          firstRemoved = std::min(firstRemoved, i);
+        }
+      }
+      this->eraseRemoved(removed, firstRemoved);
+    }
+    mMergedState.clear();
+    mNumDead = 0;
+
+    publish(mAdded, this->mAddedBatch);
+    publish(mRemoved, this->mRemovedBatch);
+    if (TrackComponentChanges<T>::value && mMergeVersion < this->mChangeVersion)
+      mMergeVersions.push_back(std::make_pair(mMergeVersion, this->mChangeVersion));
+
+    mDropped.clear();
+    mStepsDone = mStepsTotal;
+    mPhase = RELEASE;
+  }
+
+  /// Appends reactive records of the batch to \p batch.
+  static void publish(std::vector<ComponentItem>& records, std::vector<ComponentItem>& batch)
+  {
+    if (batch.empty())
+      batch.swap(records);
+    else
+      batch.insert(batch.end(), records.begin(), records.end());
+    records.clear();
+  }
+
+  /// Destroys up to \p count components left in the buffers of the last
+  /// batch. Returns the number destroyed.
+  size_t release(size_t count)
+  {
+    size_t handled = 0;
+    for (auto buffer : {&mBatch, &mScratch})
+    {
+      while (handled < count && !buffer->empty())
+      {
+        buffer->pop_back();
+        ++handled;
+      }
+    }
+    while (handled < count && !mMerged.empty())
+    {
+      mMerged.pop_back();
+      ++handled;
+    }
+    if (mBatch.empty() && mScratch.empty() && mMerged.empty())
+      mPhase = IDLE;
+    return handled;
+  }
+
+  void releaseAll()
+  {
+    if (mPhase != RELEASE)
+      return;
+    mBatch.clear();
+    mScratch.clear();
+    mMerged.clear();
+    mPhase = IDLE;
+  }
+
+  /// Position in mMerged of the copy of the visible component \p index.
+  /// Within an entity, copies are in the same order as the visible
+  /// components, ahead of added components.
+  size_t findCopy(size_t index) const
+  {
+    const ComponentItem& item = this->mComponents[index];
+    auto visible = this->mComponents.begin();
+    size_t rank = index - (std::lower_bound(visible, visible + index, item.sequence) - visible);
+
+    size_t pos = std::lower_bound(mMerged.begin(), mMerged.end(), item.sequence) - mMerged.begin();
+    for (;; ++pos)
+    {
+      if (mMergedState[pos] != MERGED_VISIBLE)
+        continue;
+      if (rank == 0)
+        return pos;
+      --rank;
+    }
+  }
+
+  /// Indices of the visible components modifications were queued for.
+  void collectModified(std::vector<size_t>& modified) const
+  {
+    for (const ModificationItem& mod : this->mModifications)
+      modified.push_back(mod.componentIndex);
+    for (const typename Base::Patch& patch : this->mPatches.patches())
+      modified.push_back(patch.componentIndex);
+    std::sort(modified.begin(), modified.end());
+    modified.erase(std::unique(modified.begin(), modified.end()), modified.end());
+  }
+
+  /// Brings the copies of modified components up to date.
+  void copyModified(const std::vector<size_t>& modified)
+  {
+    for (size_t index : modified)
+    {
+      if (index >= mVisibleCursor)
+        break;
+      mMerged[findCopy(index)] = this->mComponents[index];
+    }
+  }
+
+  /// Marks the copies of the components flagged in \p removed dead, and
+  /// moves the visible cursor back over the removed components.
+  void dropRemovedCopies(const std::vector<bool>& removed, size_t firstRemoved)
+  {
+    // Find every copy before marking any, findCopy counts live copies.
+    std::vector<size_t> copies;
+    size_t end = std::min(mVisibleCursor, removed.size());
+    for (size_t i = firstRemoved; i < end; ++i)
+    {
+      if (removed[i])
+        copies.push_back(findCopy(i));
+    }
+    for (size_t pos : copies)
+      mMergedState[pos] = MERGED_DEAD;
+    mNumDead += copies.size();
+    mVisibleCursor -= copies.size();
+  }
+
+  /// removeAll emptied the visible components: all copies are dead.
+  void dropVisibleCopies()
+  {
+    for (size_t i = 0; i < mMergedState.size(); ++i)
+    {
+      if (mMergedState[i] == MERGED_VISIBLE)
+      {
+        mMergedState[i] = MERGED_DEAD;
+        ++mNumDead;
+      }
+    }
+    mVisibleCursor = 0;
+  }
+
+  /// Applies removals of all components of an entity to additions that are
+  /// not visible yet.
+  void dropPending(const typename Base::RemovalQueue& removals)
+  {
+    std::vector<uint64_t> sequences;
+    for (const RemovalItem& rem : removals)
+    {
+      if (rem.removeType == Base::REMOVE_ALL)
+        sequences.push_back(rem.sequence);
+    }
+    if (sequences.empty())
+      return;
+    std::sort(sequences.begin(), sequences.end());
+
+    mStaged.erase(std::remove_if(mStaged.begin(), mStaged.end(),
+                                 [&sequences](const ComponentItem& item)
+                                 {return std::binary_search(sequences.begin(), sequences.end(), item.sequence);}),
+                  mStaged.end());
+
+    if (!isBatchActive())
+      return;
+
+    // Items of a batch in progress cannot be moved without restarting its
+    // sort, so they are filtered out when the batch is merged. Those that
+    // are merged already are marked dead.
+    mDropped.insert(mDropped.end(), sequences.begin(), sequences.end());
+    std::sort(mDropped.begin(), mDropped.end());
+    if (mPhase != FINAL)
+      return;
+
+    for (uint64_t sequence : sequences)
+    {
+      size_t pos = std::lower_bound(mMerged.begin(), mMerged.end(), sequence) - mMerged.begin();
+      for (; pos < mMerged.size() && mMerged[pos].sequence == sequence; ++pos)
+      {
+        if (mMergedState[pos] != MERGED_BATCH)
+          continue;
+        ComponentItem& item = mMerged[pos];
+        if (this->isReactive())
+          mRemoved.push_back(item);
+        Base::maybe_component_destruct(item.get(), item.sequence, 0);
+        mMergedState[pos] = MERGED_DEAD;
+        ++mNumDead;
+      }
+    }
+  }
+
+  bool isDropped(uint64_t sequence) const
+  {
+    return std::binary_search(mDropped.begin(), mDropped.end(), sequence);
+  }
+
+  typedef typename Base::ComponentArray ComponentArray;
+
+  std::chrono::microseconds   mBudget;
+  std::vector<ComponentItem>  mStaged;      ///< Additions not sealed into a batch yet.
+  std::vector<ComponentItem>  mBatch;       ///< Batch being sorted.
+  std::vector<ComponentItem>  mScratch;     ///< Output of a MERGE_RUNS pass.
+  ComponentArray              mMerged;      ///< Output of FINAL, swapped with the component array.
+  std::vector<unsigned char>  mMergedState; ///< MERGED_STATE of each component in mMerged.
+  std::vector<uint64_t>       mDropped;     ///< Sorted. Entities removed while mBatch was in progress.
+  std::vector<ComponentItem>  mAdded;       ///< Reactive records of the batch, see publish.
+  std::vector<ComponentItem>  mRemoved;     ///< Reactive records of the batch, see publish.
+  std::vector<std::pair<uint64_t, uint64_t>> mMergeVersions; ///< Change versions [first step, completion) of past batches.
+  MERGE_PHASE                 mPhase;
+  size_t                      mCursor;      ///< Next component of mBatch to sort or merge.
+  size_t                      mWidth;       ///< Width of sorted ranges in MERGE_RUNS.
+  size_t                      mLeft;        ///< MERGE_RUNS cursor in the left range.
+  size_t                      mRight;       ///< MERGE_RUNS cursor in the right range.
+  size_t                      mOut;         ///< MERGE_RUNS cursor in mScratch.
+  size_t                      mVisibleCursor; ///< Next visible component to merge in FINAL.
+  size_t                      mNumDead;     ///< Dead components in mMerged.
+  uint64_t                    mFirstAdded;  ///< Smallest sequence merged from the batch.
+  uint64_t                    mMergeVersion; ///< Change version at the start of FINAL.
+  size_t                      mStepsDone;
+  size_t                      mStepsTotal;
+  size_t                      mLargestStep;
+};
+
+template <typename T>
+const size_t IncrementalComponentContainer<T>::RunSize;
+
+} // namespace CPM_ES_NS
+
+#endif
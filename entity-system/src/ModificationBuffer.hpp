@@ -0,0 +1,66 @@
+#ifndef IAUNS_ENTITY_SYSTEM_MODIFICATIONBUFFER_HPP
+#define IAUNS_ENTITY_SYSTEM_MODIFICATIONBUFFER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include "ComponentPatch.hpp"
+
+namespace CPM_ES_NS {
+
+/// Modifications of components of type T queued without touching the
+/// container, so that each worker thread of a parallel system can fill its
+/// own buffer without locks. Payloads come from the calling thread's
+/// FrameArena. The buffers are handed to ComponentContainer::mergeModifications
+/// once the workers are done, from the thread that owns the container.
+///
+/// Give every buffer of a frame a distinct \p source (e.g. the worker or
+/// job index): combining modifications of the same component and priority
+/// are folded in order of source, then of queue position. The result of
+/// renormalize is then the same whichever worker finished first, even for
+/// operations that are only associative, like floating point sums.
+///
+/// Indices are container indices as seen by the system, i.e.
+/// ComponentGroup::containerIndex + componentNum.
+template <typename T>
+class ModificationBuffer
+{
+public:
+  explicit ModificationBuffer(uint32_t source) : mPatches(source) {}
+
+  /// See ComponentContainer::combineIndex.
+  template <typename Op>
+  void combine(const T& value, size_t index, Op op, int priority = 1)
+  {
+    mPatches.addCombine(index, value, op, priority);
+  }
+
+  /// See ComponentContainer::combineFieldIndex.
+  template <typename Field, typename V, typename Op>
+  void combineField(Field T::* field, const V& value, size_t index, Op op, int priority = 1)
+  {
+    mPatches.addFieldCombine(index, field, Field(value), op, priority);
+  }
+
+  /// See ComponentContainer::modifyIndexWith.
+  template <typename F>
+  void modifyWith(F&& functor, size_t index, int priority = 1)
+  {
+    mPatches.addFunctor(index, std::forward<F>(functor), priority);
+  }
+
+  bool    empty() const {return mPatches.empty();}
+  size_t  size() const  {return mPatches.size();}
+
+  /// Drops all queued modifications.
+  void clear() {mPatches.clear();}
+
+  ComponentPatchQueue<T>& patches() {return mPatches;}
+
+private:
+  ComponentPatchQueue<T> mPatches;
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,70 @@
+#include "PagedArray.hpp"
+
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+#endif
+
+namespace CPM_ES_NS {
+
+#ifdef _WIN32
+
+void* PagedMemory::reserve(uint64_t bytes)
+{
+  return VirtualAlloc(nullptr, static_cast<SIZE_T>(bytes), MEM_RESERVE, PAGE_NOACCESS);
+}
+
+bool PagedMemory::commit(void* address, size_t bytes)
+{
+  if (bytes == 0)
+    return true;
+  return VirtualAlloc(address, bytes, MEM_COMMIT, PAGE_READWRITE) != nullptr;
+}
+
+void PagedMemory::decommit(void* address, size_t bytes)
+{
+  if (bytes > 0)
+    VirtualFree(address, bytes, MEM_DECOMMIT);
+}
+
+void PagedMemory::release(void* address, uint64_t)
+{
+  VirtualFree(address, 0, MEM_RELEASE);
+}
+
+#else
+
+void* PagedMemory::reserve(uint64_t bytes)
+{
+  void* address = mmap(nullptr, static_cast<size_t>(bytes), PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  return (address == MAP_FAILED) ? nullptr : address;
+}
+
+bool PagedMemory::commit(void* address, size_t bytes)
+{
+  if (bytes == 0)
+    return true;
+  return mprotect(address, bytes, PROT_READ | PROT_WRITE) == 0;
+}
+
+void PagedMemory::decommit(void* address, size_t bytes)
+{
+  if (bytes == 0)
+    return;
+  madvise(address, bytes, MADV_DONTNEED);
+  mprotect(address, bytes, PROT_NONE);
+}
+
+void PagedMemory::release(void* address, uint64_t bytes)
+{
+  munmap(address, static_cast<size_t>(bytes));
+}
+
+#endif
+
+} // namespace CPM_ES_NS
@@ -0,0 +1,243 @@
+#ifndef IAUNS_ENTITY_SYSTEM_PAGEDARRAY_HPP
+#define IAUNS_ENTITY_SYSTEM_PAGEDARRAY_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <utility>
+#include "ComponentStorage.hpp"
+
+namespace CPM_ES_NS {
+
+/// Thin wrapper around the operating system's virtual memory functions
+/// (mmap / VirtualAlloc). Used by PagedArray.
+class PagedMemory
+{
+public:
+  /// Reserves \p bytes of address space without committing memory. Returns
+  /// nullptr on failure.
+  static void* reserve(uint64_t bytes);
+
+  /// Commits [address, address + bytes) for reading and writing.
+  static bool commit(void* address, size_t bytes);
+
+  /// Returns the memory of [address, address + bytes) to the operating
+  /// system. The range stays reserved.
+  static void decommit(void* address, size_t bytes);
+
+  /// Releases a reservation made with reserve.
+  static void release(void* address, uint64_t bytes);
+};
+
+/// Contiguous array whose storage grows in place, in fixed-size chunks.
+///
+/// On first use a large range of address space is reserved (ReserveBytes,
+/// no memory is committed). The array then occupies a prefix of that range:
+/// growing commits the next chunks after the array, so existing components
+/// are never copied or moved and there is no moment at which the old and
+/// new storage coexist, unlike std::vector's reallocation. When the array
+/// shrinks, chunks past the end (but one, to avoid thrashing at a chunk
+/// boundary) are returned to the operating system.
+///
+/// Provides the subset of std::vector's interface that component containers
+/// use. Iterators are pointers and are only invalidated by erasure, never by
+/// growth. Exceeding ReserveBytes throws.
+template <typename Item,
+          size_t ChunkBytes = (size_t(2) << 20),
+          uint64_t ReserveBytes = (uint64_t(1) << 38)>
+class PagedArray
+{
+public:
+  typedef Item          value_type;
+  typedef Item*         iterator;
+  typedef const Item*   const_iterator;
+  typedef Item&         reference;
+  typedef const Item&   const_reference;
+  typedef size_t        size_type;
+
+  static_assert(ChunkBytes % 4096 == 0, "ChunkBytes must be a multiple of the page size.");
+  static_assert(ReserveBytes % ChunkBytes == 0, "ReserveBytes must be a multiple of ChunkBytes.");
+
+  PagedArray() :
+      mData(nullptr),
+      mSize(0),
+      mCommitted(0)
+  {}
+
+  ~PagedArray()
+  {
+    clear();
+    if (mData != nullptr)
+      PagedMemory::release(mData, ReserveBytes);
+  }
+
+  PagedArray(const PagedArray&) = delete;
+  PagedArray& operator=(const PagedArray&) = delete;
+
+  iterator        begin()         {return mData;}
+  iterator        end()           {return mData + mSize;}
+  const_iterator  begin() const   {return mData;}
+  const_iterator  end() const     {return mData + mSize;}
+  const_iterator  cbegin() const  {return mData;}
+  const_iterator  cend() const    {return mData + mSize;}
+
+  size_t  size() const      {return mSize;}
+  bool    empty() const     {return mSize == 0;}
+  size_t  capacity() const  {return mCommitted / sizeof(Item);}
+
+  Item*       data()        {return mData;}
+  const Item* data() const  {return mData;}
+
+  Item&       operator[](size_t i)        {return mData[i];}
+  const Item& operator[](size_t i) const  {return mData[i];}
+  Item&       front()                     {return mData[0];}
+  const Item& front() const               {return mData[0];}
+  Item&       back()                      {return mData[mSize - 1];}
+  const Item& back() const                {return mData[mSize - 1];}
+
+  /// Number of chunks currently committed.
+  size_t getNumCommittedChunks() const {return mCommitted / ChunkBytes;}
+
+  void reserve(size_t n)
+  {
+    if (n * sizeof(Item) > mCommitted)
+      commit(n * sizeof(Item));
+  }
+
+  template <class... Args>
+  void emplace_back(Args&&... args)
+  {
+    reserve(mSize + 1);
+    new (mData + mSize) Item(std::forward<Args>(args)...);
+    ++mSize;
+  }
+
+  void push_back(const Item& item)  {emplace_back(item);}
+  void push_back(Item&& item)       {emplace_back(std::move(item));}
+
+  void pop_back()
+  {
+    --mSize;
+    mData[mSize].~Item();
+  }
+
+  iterator erase(iterator pos) {return erase(pos, pos + 1);}
+
+  iterator erase(iterator first, iterator last)
+  {
+    if (first == last)
+      return first;
+
+    iterator newEnd = std::move(last, end(), first);
+    destroy(newEnd, end());
+    mSize = static_cast<size_t>(newEnd - mData);
+    releaseUnused();
+    return first;
+  }
+
+  template <class InputIt>
+  iterator insert(iterator pos, InputIt first, InputIt last)
+  {
+    // Growth does not move the array, so pos stays valid.
+    size_t offset = static_cast<size_t>(pos - mData);
+    size_t oldSize = mSize;
+    for (; first != last; ++first)
+      emplace_back(*first);
+    std::rotate(mData + offset, mData + oldSize, mData + mSize);
+    return mData + offset;
+  }
+
+  template <class InputIt>
+  void assign(InputIt first, InputIt last)
+  {
+    clear();
+    insert(end(), first, last);
+  }
+
+  void clear()
+  {
+    destroy(begin(), end());
+    mSize = 0;
+    releaseUnused();
+  }
+
+  void swap(PagedArray& other)
+  {
+    std::swap(mData, other.mData);
+    std::swap(mSize, other.mSize);
+    std::swap(mCommitted, other.mCommitted);
+  }
+
+private:
+
+  void destroy(iterator first, iterator last)
+  {
+    for (; first != last; ++first)
+      first->~Item();
+  }
+
+  void commit(size_t bytes)
+  {
+    if (mData == nullptr)
+    {
+      mData = static_cast<Item*>(PagedMemory::reserve(ReserveBytes));
+      if (mData == nullptr)
+      {
+        std::cerr << "cpm-entity-system: PagedArray failed to reserve address space." << std::endl;
+        throw std::runtime_error("PagedArray failed to reserve address space.");
+      }
+    }
+
+    size_t target = ((bytes + ChunkBytes - 1) / ChunkBytes) * ChunkBytes;
+    if (target > ReserveBytes)
+    {
+      std::cerr << "cpm-entity-system: PagedArray exceeded its reserved address space." << std::endl;
+      throw std::runtime_error("PagedArray exceeded its reserved address space.");
+    }
+
+    char* base = reinterpret_cast<char*>(mData);
+    if (!PagedMemory::commit(base + mCommitted, target - mCommitted))
+    {
+      std::cerr << "cpm-entity-system: PagedArray failed to commit memory." << std::endl;
+      throw std::bad_alloc();
+    }
+    mCommitted = target;
+  }
+
+  void releaseUnused()
+  {
+    size_t needed = ((mSize * sizeof(Item) + ChunkBytes - 1) / ChunkBytes + 1) * ChunkBytes;
+    if (mSize == 0)
+      needed = 0;
+    if (needed >= mCommitted)
+      return;
+
+    char* base = reinterpret_cast<char*>(mData);
+    PagedMemory::decommit(base + needed, mCommitted - needed);
+    mCommitted = needed;
+  }
+
+  Item*   mData;        ///< Start of the reserved range, nullptr until first use.
+  size_t  mSize;        ///< Number of items.
+  size_t  mCommitted;   ///< Committed bytes, a multiple of ChunkBytes.
+};
+
+/// Storage policy for ComponentStorageType: stores the components of a type
+/// in a PagedArray.
+///
+///   namespace CPM_ES_NS {
+///   template <> struct ComponentStorageType<CompHuge> : PagedComponentStorage<> {};
+///   }
+template <size_t ChunkBytes = (size_t(2) << 20), uint64_t ReserveBytes = (uint64_t(1) << 38)>
+struct PagedComponentStorage : public DefaultComponentStorage
+{
+  template <typename Item>
+  struct array {typedef PagedArray<Item, ChunkBytes, ReserveBytes> type;};
+};
+
+} // namespace CPM_ES_NS
+
+#endif
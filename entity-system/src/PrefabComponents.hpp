@@ -0,0 +1,35 @@
+#ifndef IAUNS_ENTITY_SYSTEM_PREFABCOMPONENTS_HPP
+#define IAUNS_ENTITY_SYSTEM_PREFABCOMPONENTS_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace CPM_ES_NS {
+
+/// Type erased components of one type captured by a Prefab. Created by
+/// BaseComponentContainer::capturePrefabComponents.
+class BasePrefabComponents
+{
+public:
+  BasePrefabComponents()          {}
+  virtual ~BasePrefabComponents() {}
+};
+
+/// Copies of the components of type T held by the prefab's source entity.
+template <typename T>
+class PrefabComponents : public BasePrefabComponents
+{
+public:
+  /// Called on every copy before it is queued, with the ID of the new
+  /// entity and its instance number (0 for the first new entity).
+  typedef std::function<void(uint64_t entityID, size_t instance, T& component)> Override;
+
+  std::vector<T>  components;         ///< In the order the source entity held them.
+  Override        overrideComponent;  ///< Optional, see Prefab::setOverride.
+};
+
+} // namespace CPM_ES_NS
+
+#endif
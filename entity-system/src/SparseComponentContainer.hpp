@@ -0,0 +1,112 @@
+#ifndef IAUNS_ENTITY_SYSTEM_SPARSECOMPONENTCONTAINER_HPP
+#define IAUNS_ENTITY_SYSTEM_SPARSECOMPONENTCONTAINER_HPP
+
+#include "ComponentContainer.hpp"
+#include "SparseSequenceIndex.hpp"
+
+namespace CPM_ES_NS {
+
+/// Component container with O(1) random access by entity ID.
+///
+/// Components are stored exactly as in ComponentContainer: a dense array kept
+/// sorted by sequence at renormalize. So GenericSystem's merge join works
+/// unchanged. In addition, a paged sparse index maps each sequence to the
+/// first of its components in the dense array. The index is rebuilt at
+/// renormalize whenever the layout of the dense array changes, and replaces
+/// the binary search in getComponentItemIndexWithSequence,
+/// getComponentItemWithSequence and getComponent (and therefore in
+/// GenericSystem::walkEntity).
+///
+/// Use this container for component types that are mostly read through
+/// scattered lookups by entity ID. Select it with the CompCont template
+/// parameter of ESCoreBase::coreAddComponent.
+template <typename T>
+class SparseComponentContainer : public ComponentContainer<T>
+{
+public:
+  typedef ComponentContainer<T>                 Base;
+  typedef typename Base::ComponentItem          ComponentItem;
+
+  SparseComponentContainer() {}
+  virtual ~SparseComponentContainer() {}
+
+  void renormalize(bool stableSort) override
+  {
+    // Modifications alone do not move components around.
+    bool layoutChanged =    this->mComponents.size() != static_cast<size_t>(this->mLastSortedSize)
+                         || this->mRemovals.size() > 0
+                         || this->isClearPending();
+
+    Base::renormalize(stableSort);
+
+    if (layoutChanged)
+      rebuildIndex();
+  }
+
+  void removeAllImmediately() override
+  {
+    Base::removeAllImmediately();
+    mIndex.clear();
+  }
+
+  int getComponentItemIndexWithSequence(uint64_t sequence) const override
+  {
+    if (this->isStatic())
+      return Base::getComponentItemIndexWithSequence(sequence);
+
+    int slot = mIndex.find(sequence);
+    if (slot == SparseSequenceIndex::NotIndexed)
+      return Base::getComponentItemIndexWithSequence(sequence);
+
+    return slot;
+  }
+
+  ComponentItem* getComponentItemWithSequence(uint64_t sequence) override
+  {
+    if (this->isStatic())
+      return Base::getComponentItemWithSequence(sequence);
+
+    int slot = mIndex.find(sequence);
+    if (slot == SparseSequenceIndex::NotIndexed)
+      return Base::getComponentItemWithSequence(sequence);
+    else if (slot == SparseSequenceIndex::NotFound)
+      return nullptr;
+
+    return &this->mComponents[slot];
+  }
+
+  std::pair<const T*, size_t> getComponent(uint64_t sequence) const override
+  {
+    if (this->isStatic())
+      return Base::getComponent(sequence);
+
+    int slot = mIndex.find(sequence);
+    if (slot == SparseSequenceIndex::NotIndexed)
+      return Base::getComponent(sequence);
+    else if (slot == SparseSequenceIndex::NotFound)
+      return std::make_pair(nullptr, 0);
+
+    return std::make_pair(&this->mComponents[slot].get(), static_cast<size_t>(slot));
+  }
+
+  /// Access to the sparse index. Used for debugging and statistics.
+  const SparseSequenceIndex& getSparseIndex() const {return mIndex;}
+
+protected:
+
+  void rebuildIndex()
+  {
+    if (this->isStatic() || this->mLastSortedSize == 0)
+    {
+      mIndex.clear();
+      return;
+    }
+    mIndex.rebuild(&this->mComponents[0], static_cast<size_t>(this->mLastSortedSize));
+  }
+
+  SparseSequenceIndex mIndex;  ///< Sequence -> first slot in mComponents.
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,71 @@
+#include "SparseSequenceIndex.hpp"
+#include <cstring>
+
+namespace CPM_ES_NS {
+
+const int       SparseSequenceIndex::PageBits;
+const size_t    SparseSequenceIndex::PageSize;
+const uint64_t  SparseSequenceIndex::MaxIndexedSequence;
+const int       SparseSequenceIndex::NotFound;
+const int       SparseSequenceIndex::NotIndexed;
+
+SparseSequenceIndex::SparseSequenceIndex()
+{
+}
+
+void SparseSequenceIndex::insert(uint64_t sequence, int slot)
+{
+  if (sequence >= MaxIndexedSequence)
+    return;
+
+  size_t page = static_cast<size_t>(sequence >> PageBits);
+  if (page >= mPages.size())
+  {
+    mPages.resize(page + 1);
+    mPageUsed.resize(page + 1, false);
+  }
+
+  if (!mPages[page])
+  {
+    mPages[page].reset(new uint32_t[PageSize]);
+    std::memset(mPages[page].get(), 0, PageSize * sizeof(uint32_t));
+  }
+
+  // Remember which pages were written to so clear only touches those.
+  if (!mPageUsed[page])
+  {
+    mPageUsed[page] = true;
+    mUsedPages.push_back(page);
+  }
+
+  uint32_t* entries = mPages[page].get();
+  entries[sequence & (PageSize - 1)] = static_cast<uint32_t>(slot + 1);
+}
+
+void SparseSequenceIndex::clear()
+{
+  for (size_t page : mUsedPages)
+  {
+    std::memset(mPages[page].get(), 0, PageSize * sizeof(uint32_t));
+    mPageUsed[page] = false;
+  }
+  mUsedPages.clear();
+}
+
+void SparseSequenceIndex::release()
+{
+  mPages.clear();
+  mPageUsed.clear();
+  mUsedPages.clear();
+}
+
+size_t SparseSequenceIndex::getNumAllocatedPages() const
+{
+  size_t numPages = 0;
+  for (const std::unique_ptr<uint32_t[]>& page : mPages)
+    if (page)
+      ++numPages;
+  return numPages;
+}
+
+} // namespace CPM_ES_NS
@@ -0,0 +1,82 @@
+#ifndef IAUNS_ENTITY_SYSTEM_SPARSESEQUENCEINDEX_HPP
+#define IAUNS_ENTITY_SYSTEM_SPARSESEQUENCEINDEX_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <memory>
+
+namespace CPM_ES_NS {
+
+/// Paged sparse map from sequence (entity ID) to the index of the first
+/// component with that sequence in a sorted component array. Pages are
+/// allocated on demand, so memory is proportional to the range of sequences
+/// actually in use rather than to the largest sequence.
+///
+/// Sequences at or above MaxIndexedSequence are not indexed. Lookups for them
+/// return NotIndexed and callers are expected to fall back to a binary search.
+class SparseSequenceIndex
+{
+public:
+  static const int      PageBits          = 12;
+  static const size_t   PageSize          = size_t(1) << PageBits;
+  static const uint64_t MaxIndexedSequence = uint64_t(1) << 32;
+
+  /// Returned from find when the sequence is not present.
+  static const int NotFound   = -1;
+  /// Returned from find when the sequence is outside the indexed range.
+  static const int NotIndexed = -2;
+
+  SparseSequenceIndex();
+
+  /// Returns the slot associated with \p sequence, NotFound, or NotIndexed.
+  int find(uint64_t sequence) const
+  {
+    if (sequence >= MaxIndexedSequence)
+      return NotIndexed;
+
+    size_t page = static_cast<size_t>(sequence >> PageBits);
+    if (page >= mPages.size() || !mPages[page])
+      return NotFound;
+
+    // Slots are stored off by one so that zero-filled pages mean 'empty'.
+    return static_cast<int>(mPages[page][sequence & (PageSize - 1)]) - 1;
+  }
+
+  /// Associates \p slot with \p sequence. Sequences outside the indexed range
+  /// are ignored.
+  void insert(uint64_t sequence, int slot);
+
+  /// Removes all entries. Allocated pages are kept for reuse.
+  void clear();
+
+  /// Releases all pages.
+  void release();
+
+  /// Rebuilds the index from a sorted array of component items. Only the
+  /// first item of each run of equal sequences is indexed.
+  template <typename Item>
+  void rebuild(const Item* items, size_t numItems)
+  {
+    clear();
+    uint64_t lastSequence = 0;
+    for (size_t i = 0; i < numItems; ++i)
+    {
+      if (i == 0 || items[i].sequence != lastSequence)
+        insert(items[i].sequence, static_cast<int>(i));
+      lastSequence = items[i].sequence;
+    }
+  }
+
+  /// Number of pages currently allocated.
+  size_t getNumAllocatedPages() const;
+
+private:
+  std::vector<std::unique_ptr<uint32_t[]>>  mPages;       ///< Page directory.
+  std::vector<bool>                         mPageUsed;    ///< True if page is in mUsedPages.
+  std::vector<size_t>                       mUsedPages;   ///< Pages written since last clear.
+};
+
+} // namespace CPM_ES_NS
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef IAUNS_ENTITY_SYSTEM_UNIQUECOMPONENTCONTAINER_HPP
+#define IAUNS_ENTITY_SYSTEM_UNIQUECOMPONENTCONTAINER_HPP
+
+#include <limits>
+#include <type_traits>
+#include "ComponentContainer.hpp"
+
+namespace CPM_ES_NS {
+
+/// Component container that holds at most one component per entity.
+///
+/// Adding a component to an entity that already has one replaces it at the
+/// next renormalize: the most recently added component wins. Replaced
+/// components go through componentDestruct as if they had been removed.
+/// Removals are applied after replacement, so removing the component of an
+/// entity in the same frame a replacement is added removes the entity's
+/// component altogether.
+///
+/// To use this container, specialize ComponentContainerType for the component
+/// type. GenericSystem detects this at compile time (see IsUniqueComponent)
+/// and joins the component one-to-one, without looping over runs of equal
+/// sequences. Static components are unaffected. Walking a system over a
+/// core that holds such a component in any other container throws.
+template <typename T>
+class UniqueComponentContainer : public ComponentContainer<T>
+{
+public:
+  typedef ComponentContainer<T>                 Base;
+  typedef typename Base::ComponentItem          ComponentItem;
+  typedef typename Base::RemovalItem            RemovalItem;
+
+  UniqueComponentContainer() {}
+  virtual ~UniqueComponentContainer() {}
+
+  void renormalize(bool stableSort) override
+  {
+    bool added = this->mComponents.size() != static_cast<size_t>(this->mLastSortedSize);
+    if (this->isStatic() || !added)
+    {
+      Base::renormalize(stableSort);
+      return;
+    }
+
+    // Hold removals back until duplicates are collapsed. A stable sort keeps
+    // existing components ahead of new ones, and new ones in the order they
+    // were added, so the last item of each run is the newest.
+    typename Base::RemovalQueue removals;
+    removals.swap(this->mRemovals);
+    Base::renormalize(true);
+    collapseDuplicates();
+
+    if (removals.size() > 0)
+    {
+      this->mRemovals.swap(removals);
+      this->applyRemovals();
+    }
+  }
+
+  int getNumComponentsWithSequence(uint64_t sequence) const override
+  {
+    return (Base::getNumComponentsWithSequence(sequence) > 0) ? 1 : 0;
+  }
+
+protected:
+
+  void collapseDuplicates()
+  {
+    int size = this->mLastSortedSize;
+    int write = 0;
+    uint64_t changedFrom = std::numeric_limits<uint64_t>::max();
+    for (int read = 0; read < size; ++read)
+    {
+      ComponentItem& item = this->mComponents[read];
+      if (read + 1 < size && this->mComponents[read + 1].sequence == item.sequence)
+      {
+        changedFrom = std::min(changedFrom, item.sequence);
+        this->recordRemoved(item);
+        Base::maybe_component_destruct(item.get(), item.sequence, 0);
+        continue;
+      }
+
+      if (write != read)
+        this->mComponents[write] = std::move(item);
+      ++write;
+    }
+
+    if (write != size)
+    {
+      this->mComponents.erase(this->mComponents.begin() + write, this->mComponents.end());
+      this->mLastSortedSize = write;
+      this->changeLayout(changedFrom);
+    }
+  }
+};
+
+/// True if components of type T are stored in a UniqueComponentContainer.
+template <typename T>
+struct IsUniqueComponent :
+    std::is_base_of<UniqueComponentContainer<T>, typename ComponentContainerType<T>::type>
+{};
+
+} // namespace CPM_ES_NS
+
+#endif
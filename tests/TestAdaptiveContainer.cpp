@@ -0,0 +1,257 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/AdaptiveComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+class AdaptiveCore : public es::ESCore
+{
+public:
+  void addPosition(uint64_t entityID, const CompPosition& pos)
+  {
+    coreAddComponent<CompPosition, es::AdaptiveComponentContainer<CompPosition>>(entityID, pos);
+  }
+
+  es::AdaptiveComponentContainer<CompPosition>* getPositions()
+  {
+    return dynamic_cast<es::AdaptiveComponentContainer<CompPosition>*>(
+        getComponentContainer(es::getESTypeID<CompPosition>()));
+  }
+};
+
+// (entity, position.x, health)
+typedef std::tuple<uint64_t, float, int> Entry;
+
+class RecordSystem : public es::GenericSystem<false, CompPosition, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompPosition* pos, const CompGameplay* gp) override
+  {
+    log.push_back(std::make_tuple(entityID, pos->position.x, gp->health));
+  }
+};
+
+void expectSameWalk(es::ESCore& a, es::ESCore& b)
+{
+  RecordSystem sysA, sysB;
+  sysA.walkComponents(a);
+  sysB.walkComponents(b);
+  EXPECT_FALSE(sysA.log.empty());
+  EXPECT_TRUE(sysA.log == sysB.log);
+}
+
+TEST(EntitySystem, TestAdaptiveContainer)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  AdaptiveCore adaptive;
+  es::ESCore reference;
+  const uint64_t numEntities = 4000;
+  for (uint64_t id = 1; id <= numEntities; ++id)
+  {
+    adaptive.addPosition(id, CompPosition(glm::vec3(static_cast<float>(id))));
+    reference.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id))));
+  }
+  for (uint64_t id = 1; id <= numEntities + 100000; id += 3)
+  {
+    adaptive.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+    reference.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+  }
+
+  es::AdaptiveComponentContainer<CompPosition>* positions = adaptive.getPositions();
+  ASSERT_NE(nullptr, positions);
+
+  std::vector<es::ADAPTIVE_STORAGE> storages;
+  auto renormalize = [&]()
+  {
+    adaptive.renormalize(true);
+    reference.renormalize(true);
+    if (storages.empty() || storages.back() != positions->getStorage())
+      storages.push_back(positions->getStorage());
+  };
+
+  // Walks, no churn: sorted vector.
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    renormalize();
+    expectSameWalk(adaptive, reference);
+  }
+  EXPECT_EQ(es::STORAGE_SORTED_VECTOR, positions->getStorage());
+  EXPECT_GT(positions->getStats().walksPerFrame, 0.5);
+  EXPECT_EQ(numEntities, positions->getStats().size);
+
+  // Many short-lived entities: churn alone does not switch storage.
+  const uint64_t churn = 800;
+  uint64_t nextID = numEntities + 1;
+  for (int frame = 0; frame < 20; ++frame)
+  {
+    for (uint64_t i = 0; i < churn; ++i)
+    {
+      CompPosition pos(glm::vec3(static_cast<float>(nextID + i)));
+      adaptive.addPosition(nextID + i, pos);
+      reference.addComponent(nextID + i, pos);
+    }
+    if (frame >= 2)
+    {
+      for (uint64_t i = 0; i < churn; ++i)
+      {
+        adaptive.removeEntity(nextID - 2 * churn + i);
+        reference.removeEntity(nextID - 2 * churn + i);
+      }
+    }
+    nextID += churn;
+
+    renormalize();
+    expectSameWalk(adaptive, reference);
+  }
+  EXPECT_EQ(es::STORAGE_SORTED_VECTOR, positions->getStorage());
+  EXPECT_GT(positions->getStats().addsPerFrame, 0.0);
+  EXPECT_GT(positions->getStats().removesPerFrame, 0.0);
+
+  // Churn stops, entities are looked up one by one: sparse set.
+  for (uint64_t i = 0; i < 2 * churn; ++i)
+  {
+    adaptive.removeEntity(nextID - 2 * churn + i);
+    reference.removeEntity(nextID - 2 * churn + i);
+  }
+  std::uniform_int_distribution<uint64_t> entity(1, numEntities);
+  for (int frame = 0; frame < 40; ++frame)
+  {
+    renormalize();
+
+    RecordSystem a, b;
+    for (int i = 0; i < 500; ++i)
+    {
+      uint64_t id = entity(rng);
+      EXPECT_EQ(b.walkEntity(reference, id), a.walkEntity(adaptive, id));
+    }
+    EXPECT_TRUE(a.log == b.log);
+  }
+  EXPECT_EQ(es::STORAGE_SPARSE_SET, positions->getStorage());
+
+  // Walks again: back to the sorted vector.
+  for (int frame = 0; frame < 30; ++frame)
+  {
+    renormalize();
+    expectSameWalk(adaptive, reference);
+  }
+  EXPECT_EQ(es::STORAGE_SORTED_VECTOR, positions->getStorage());
+
+  std::vector<es::ADAPTIVE_STORAGE> expected = {es::STORAGE_SORTED_VECTOR, es::STORAGE_SPARSE_SET,
+                                                es::STORAGE_SORTED_VECTOR};
+  EXPECT_TRUE(storages == expected);
+  EXPECT_EQ(2, positions->getStats().numSwitches);
+}
+
+// Looks up every entity of \p positions in a shuffled order, returning the
+// fastest of \p repeats rounds in milliseconds.
+double timeLookups(es::AdaptiveComponentContainer<CompPosition>& positions,
+                   const std::vector<uint64_t>& order, int repeats, size_t& found)
+{
+  double best = std::numeric_limits<double>::max();
+  for (int r = 0; r < repeats; ++r)
+  {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (uint64_t id : order)
+      found += (positions.getComponent(id).first != nullptr) ? 1 : 0;
+    auto end = std::chrono::high_resolution_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+  }
+  return best;
+}
+
+TEST(EntitySystem, TestAdaptiveSparseLookups)
+{
+  // The switch to the sparse set must pay off: the same lookups are faster
+  // after it than before.
+  AdaptiveCore core;
+  const uint64_t numEntities = 200000;
+  std::vector<uint64_t> order;
+  for (uint64_t id = 1; id <= numEntities; ++id)
+  {
+    core.addPosition(id * 3, CompPosition(glm::vec3(1.0f)));
+    order.push_back(id * 3);
+  }
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::shuffle(order.begin(), order.end(), rng);
+
+  es::AdaptiveComponentContainer<CompPosition>* positions = core.getPositions();
+  es::AdaptivePolicy policy;
+  es::AdaptivePolicy vectorOnly;
+  vectorOnly.sparseEnterLookups = std::numeric_limits<double>::max();
+  positions->setPolicy(vectorOnly);
+  core.renormalize(true);
+
+  size_t vectorFound = 0;
+  double vectorMs = timeLookups(*positions, order, 3, vectorFound);
+  core.renormalize(true);
+  EXPECT_EQ(es::STORAGE_SORTED_VECTOR, positions->getStorage());
+
+  positions->setPolicy(policy);
+  core.renormalize(true);
+  ASSERT_EQ(es::STORAGE_SPARSE_SET, positions->getStorage());
+
+  size_t sparseFound = 0;
+  double sparseMs = timeLookups(*positions, order, 3, sparseFound);
+  EXPECT_EQ(3 * order.size(), vectorFound);
+  EXPECT_EQ(3 * order.size(), sparseFound);
+  EXPECT_LT(sparseMs, vectorMs);
+  std::cout << "Lookups, sorted vector: " << vectorMs << " ms" << std::endl;
+  std::cout << "Lookups, sparse set:    " << sparseMs << " ms" << std::endl;
+}
+
+
+TEST(EntitySystem, TestAdaptiveCoreAdd)
+{
+  // Plain ESCore adds are counted like those through addPosition.
+  AdaptiveCore core;
+  core.addPosition(1, CompPosition(glm::vec3(1.0f)));
+  for (uint64_t id = 2; id <= 50; ++id)
+    core.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id))));
+  core.renormalize(true);
+
+  es::AdaptiveComponentContainer<CompPosition>* positions = core.getPositions();
+  EXPECT_EQ(50, positions->getNumComponents());
+  EXPECT_GT(positions->getStats().addsPerFrame, 10.0);
+}
+
+}
+
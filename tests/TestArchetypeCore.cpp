@@ -0,0 +1,445 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/ArchetypeESCore.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <chrono>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompHomPos
+{
+  CompHomPos() {}
+  CompHomPos(const glm::vec4& pos) {position = pos;}
+
+  glm::vec4 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+struct CompTest1
+{
+  CompTest1() : t1(0) {}
+  CompTest1(int t) : t1(t) {}
+
+  int t1;
+};
+
+struct CompTest2
+{
+  CompTest2() : t2(0.0f) {}
+  CompTest2(float t) : t2(t) {}
+
+  float t2;
+};
+
+struct CompStatic
+{
+  CompStatic() : value(0) {}
+  CompStatic(int v) : value(v) {}
+
+  int value;
+};
+
+// (entity, position.x, homPos.x, health or -1, static)
+typedef std::tuple<uint64_t, float, float, int, int> ExecEntry;
+
+class RecordSystem : public es::GenericSystem<false, CompPosition, CompHomPos, CompGameplay, CompStatic>
+{
+public:
+  std::vector<ExecEntry> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompPosition* pos, const CompHomPos* homPos,
+               const CompGameplay* gp, const CompStatic* st) override
+  {
+    log.push_back(std::make_tuple(entityID, pos->position.x, homPos->position.x,
+                                  gp ? gp->health : -1, st->value));
+  }
+
+  bool isComponentOptional(uint64_t templateID) override
+  {
+    return es::OptionalComponents<CompGameplay>(templateID);
+  }
+};
+
+// (entity, #pos, #homPos, #gameplay)
+typedef std::tuple<uint64_t, size_t, size_t, size_t> GroupEntry;
+
+class RecordGroupSystem : public es::GenericSystem<true, CompPosition, CompHomPos, CompGameplay>
+{
+public:
+  std::vector<GroupEntry> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<CompPosition>& pos,
+                    const es::ComponentGroup<CompHomPos>& homPos,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    log.push_back(std::make_tuple(entityID, pos.size(), homPos.size(), gp.size()));
+  }
+
+  bool isComponentOptional(uint64_t templateID) override
+  {
+    return es::OptionalComponents<CompGameplay>(templateID);
+  }
+};
+
+template <typename Core>
+void addRandomEntity(Core& core, uint64_t id, std::mt19937& rng)
+{
+  std::uniform_int_distribution<int> count(0, 2);
+  int numPos = count(rng);
+  for (int i = 0; i < numPos; ++i)
+    core.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id * 10 + i), 0.0f, 0.0f)));
+  int numHom = count(rng);
+  for (int i = 0; i < numHom; ++i)
+    core.addComponent(id, CompHomPos(glm::vec4(static_cast<float>(id * 100 + i), 0.0f, 0.0f, 0.0f)));
+  if (count(rng) != 0)
+    core.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+  if (count(rng) == 0)
+    core.addComponent(id, CompTest1(static_cast<int>(id)));
+}
+
+TEST(EntitySystem, TestArchetypeCore)
+{
+  std::mt19937 rngA(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::mt19937 rngB(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  std::shared_ptr<es::ESCore> joined(new es::ESCore());
+  std::shared_ptr<es::ArchetypeESCore> tables(new es::ArchetypeESCore());
+
+  joined->addStaticComponent(CompStatic(1));
+  joined->addStaticComponent(CompStatic(2));
+  tables->addStaticComponent(CompStatic(1));
+  tables->addStaticComponent(CompStatic(2));
+
+  uint64_t nextID = 2;
+  for (int frame = 0; frame < 4; ++frame)
+  {
+    for (int i = 0; i < 200; ++i, ++nextID)
+    {
+      addRandomEntity(*joined, nextID, rngA);
+      addRandomEntity(*tables, nextID, rngB);
+    }
+
+    joined->renormalize(true);
+    tables->renormalize(true);
+
+    ASSERT_NE(nullptr, tables->getArchetypeIndex());
+    EXPECT_GT(tables->getArchetypeIndex()->getTables().size(), 1);
+
+    // Archetype walks visit entities table by table, so compare sorted logs.
+    RecordSystem a, b;
+    a.walkComponents(*joined);
+    b.walkComponents(*tables);
+    std::sort(a.log.begin(), a.log.end());
+    std::sort(b.log.begin(), b.log.end());
+    EXPECT_FALSE(a.log.empty());
+    EXPECT_TRUE(a.log == b.log);
+
+    RecordGroupSystem ga, gb;
+    ga.walkComponents(*joined);
+    gb.walkComponents(*tables);
+    std::sort(ga.log.begin(), ga.log.end());
+    std::sort(gb.log.begin(), gb.log.end());
+    EXPECT_TRUE(ga.log == gb.log);
+
+    // Move entities between tables for the next frame.
+    for (uint64_t id = 2 + frame; id < nextID; id += 7)
+    {
+      joined->removeEntity(id);
+      tables->removeEntity(id);
+    }
+    for (uint64_t id = 3 + frame; id < nextID; id += 5)
+    {
+      joined->removeFirstComponentT<CompHomPos>(id);
+      tables->removeFirstComponentT<CompHomPos>(id);
+      joined->addComponent(id, CompGameplay(static_cast<int>(id) * 2, 1));
+      tables->addComponent(id, CompGameplay(static_cast<int>(id) * 2, 1));
+    }
+  }
+
+  // Containers changed without a renormalize: systems must fall back to the
+  // merge join instead of using stale tables.
+  tables->clearAllComponentContainersImmediately();
+  RecordSystem empty;
+  empty.walkComponents(*tables);
+  EXPECT_TRUE(empty.log.empty());
+}
+
+TEST(EntitySystem, TestArchetypeIncremental)
+{
+  std::mt19937 rngA(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::mt19937 rngB(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore joined;
+  es::ArchetypeESCore tables;
+  joined.addStaticComponent(CompStatic(1));
+  tables.addStaticComponent(CompStatic(1));
+
+  uint64_t nextID = 2;
+  for (int i = 0; i < 500; ++i, ++nextID)
+  {
+    addRandomEntity(joined, nextID, rngA);
+    addRandomEntity(tables, nextID, rngB);
+  }
+  joined.renormalize(true);
+  tables.renormalize(true);
+
+  // Spawning entities with larger IDs keeps the rows of all earlier ones.
+  const es::ArchetypeIndex* index = tables.getArchetypeIndex();
+  std::vector<es::ArchetypeIndex::Table> before = index->getTables();
+  for (int frame = 0; frame < 3; ++frame)
+  {
+    for (int i = 0; i < 50; ++i, ++nextID)
+    {
+      addRandomEntity(joined, nextID, rngA);
+      addRandomEntity(tables, nextID, rngB);
+    }
+    joined.renormalize(true);
+    tables.renormalize(true);
+  }
+
+  ASSERT_LE(before.size(), index->getTables().size());
+  for (size_t t = 0; t < before.size(); ++t)
+  {
+    const es::ArchetypeIndex::Table& table = index->getTables()[t];
+    EXPECT_TRUE(before[t].signature == table.signature);
+    ASSERT_LE(before[t].entities.size(), table.entities.size());
+    EXPECT_TRUE(std::equal(before[t].entities.begin(), before[t].entities.end(), table.entities.begin()));
+  }
+
+  // Removing one early entity drops its row and keeps all others.
+  before = index->getTables();
+  joined.removeEntity(10);
+  tables.removeEntity(10);
+  joined.renormalize(true);
+  tables.renormalize(true);
+
+  ASSERT_EQ(before.size(), index->getTables().size());
+  for (size_t t = 0; t < before.size(); ++t)
+  {
+    std::vector<uint64_t> expected = before[t].entities;
+    expected.erase(std::remove(expected.begin(), expected.end(), 10), expected.end());
+    EXPECT_TRUE(expected == index->getTables()[t].entities);
+  }
+
+  RecordSystem a, b;
+  a.walkComponents(joined);
+  b.walkComponents(tables);
+  std::sort(a.log.begin(), a.log.end());
+  std::sort(b.log.begin(), b.log.end());
+  EXPECT_FALSE(a.log.empty());
+  EXPECT_TRUE(a.log == b.log);
+
+  // Random changes anywhere: entities gain and lose components, some of
+  // them all of a type, and early entities are despawned.
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    std::uniform_int_distribution<uint64_t> pick(2, nextID - 1);
+    for (int i = 0; i < 20; ++i)
+    {
+      uint64_t id = pick(rng);
+      switch (rng() % 5)
+      {
+        case 0:
+          joined.removeEntity(id);
+          tables.removeEntity(id);
+          break;
+        case 1:
+          joined.removeFirstComponentT<CompPosition>(id);
+          tables.removeFirstComponentT<CompPosition>(id);
+          break;
+        case 2:
+          joined.removeFirstComponentT<CompHomPos>(id);
+          tables.removeFirstComponentT<CompHomPos>(id);
+          break;
+        case 3:
+          joined.addComponent(id, CompHomPos(glm::vec4(static_cast<float>(id), 0.0f, 0.0f, 0.0f)));
+          tables.addComponent(id, CompHomPos(glm::vec4(static_cast<float>(id), 0.0f, 0.0f, 0.0f)));
+          break;
+        default:
+          joined.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id), 0.0f, 0.0f)));
+          tables.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id), 0.0f, 0.0f)));
+          break;
+      }
+    }
+    for (int i = 0; i < 10; ++i, ++nextID)
+    {
+      addRandomEntity(joined, nextID, rngA);
+      addRandomEntity(tables, nextID, rngB);
+    }
+    joined.renormalize(true);
+    tables.renormalize(true);
+
+    RecordSystem fa, fb;
+    fa.walkComponents(joined);
+    fb.walkComponents(tables);
+    std::sort(fa.log.begin(), fa.log.end());
+    std::sort(fb.log.begin(), fb.log.end());
+    EXPECT_TRUE(fa.log == fb.log);
+
+    RecordGroupSystem ga, gb;
+    ga.walkComponents(joined);
+    gb.walkComponents(tables);
+    std::sort(ga.log.begin(), ga.log.end());
+    std::sort(gb.log.begin(), gb.log.end());
+    EXPECT_TRUE(ga.log == gb.log);
+  }
+}
+
+// Benchmark in the spirit of TestGSMultiRandDyn: many entities, a 5 component
+// system, random component presence. Prints the time taken by both cores to
+// walk, and to renormalize and walk while entities are spawned and despawned
+// every frame.
+class BenchSystem : public es::GenericSystem<false, CompPosition, CompHomPos, CompGameplay, CompTest1, CompTest2>
+{
+public:
+  BenchSystem() : sum(0) {}
+
+  void execute(es::ESCoreBase&, uint64_t,
+               const CompPosition* pos, const CompHomPos*, const CompGameplay* gp,
+               const CompTest1* t1, const CompTest2*) override
+  {
+    sum += static_cast<int64_t>(pos->position.x) + gp->health + t1->t1;
+  }
+
+  int64_t sum;
+};
+
+template <typename Core>
+double benchWalk(Core& core, int iterations, int64_t& sum)
+{
+  BenchSystem sys;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterations; ++i)
+    sys.walkComponents(core);
+  auto end = std::chrono::high_resolution_clock::now();
+  sum = sys.sum;
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+template <typename Core>
+void addBenchEntity(Core& core, uint64_t id, std::mt19937& rng)
+{
+  std::uniform_int_distribution<int> percent(0, 99);
+  if (percent(rng) < 90) core.addComponent(id, CompPosition(glm::vec3(1.0f)));
+  if (percent(rng) < 90) core.addComponent(id, CompHomPos(glm::vec4(1.0f)));
+  if (percent(rng) < 90) core.addComponent(id, CompGameplay(1, 1));
+  if (percent(rng) < 90) core.addComponent(id, CompTest1(1));
+  if (percent(rng) < 90) core.addComponent(id, CompTest2(1.0f));
+}
+
+template <typename Core>
+void fillBenchCore(Core& core, int numEntities)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  for (int i = 0; i < numEntities; ++i)
+    addBenchEntity(core, static_cast<uint64_t>(i) + 2, rng);
+  core.renormalize();
+}
+
+// Each frame spawns \p churn entities with new IDs and despawns as many,
+// then renormalizes and walks. Transient entities live a few frames, so
+// only the end of each container changes. Otherwise the oldest entities are
+// despawned, which changes every container from the front.
+template <typename Core>
+double benchChurn(Core& core, uint64_t& nextID, uint64_t& oldest, int churn, int frames,
+                  bool transient, int64_t& sum)
+{
+  const int lifetime = 4;
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  BenchSystem sys;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int frame = 0; frame < frames; ++frame)
+  {
+    for (int i = 0; i < churn; ++i)
+      addBenchEntity(core, nextID + static_cast<uint64_t>(i), rng);
+    if (!transient)
+    {
+      for (int i = 0; i < churn; ++i)
+        core.removeEntity(oldest++);
+    }
+    else if (frame >= lifetime)
+    {
+      uint64_t expired = nextID - static_cast<uint64_t>(lifetime * churn);
+      for (int i = 0; i < churn; ++i)
+        core.removeEntity(expired + static_cast<uint64_t>(i));
+    }
+    nextID += static_cast<uint64_t>(churn);
+
+    core.renormalize();
+    sys.walkComponents(core);
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  sum = sys.sum;
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+TEST(EntitySystem, BenchArchetypeCore)
+{
+  const int numEntities = 20000;
+  const int iterations = 20;
+
+  es::ESCore joined;
+  es::ArchetypeESCore tables;
+  fillBenchCore(joined, numEntities);
+  fillBenchCore(tables, numEntities);
+
+  int64_t joinedSum = 0;
+  int64_t tableSum = 0;
+  double joinedMs = benchWalk(joined, iterations, joinedSum);
+  double tableMs = benchWalk(tables, iterations, tableSum);
+
+  EXPECT_EQ(joinedSum, tableSum);
+  std::cout << "Walk, merge join:       " << joinedMs << " ms" << std::endl;
+  std::cout << "Walk, archetype tables: " << tableMs << " ms" << std::endl;
+
+  uint64_t joinedNext = static_cast<uint64_t>(numEntities) + 2;
+  uint64_t tableNext = joinedNext;
+  uint64_t joinedOldest = 2;
+  uint64_t tableOldest = 2;
+  for (bool transient : {true, false})
+  {
+    const char* pattern = transient ? "transient" : "oldest   ";
+    joinedMs = benchChurn(joined, joinedNext, joinedOldest, 200, iterations, transient, joinedSum);
+    tableMs = benchChurn(tables, tableNext, tableOldest, 200, iterations, transient, tableSum);
+
+    EXPECT_EQ(joinedSum, tableSum);
+    std::cout << "Churn " << pattern << ", merge join:       " << joinedMs << " ms" << std::endl;
+    std::cout << "Churn " << pattern << ", archetype tables: " << tableMs << " ms" << std::endl;
+  }
+}
+
+}
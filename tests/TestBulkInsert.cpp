@@ -0,0 +1,176 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/IncrementalComponentContainer.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <entity-system/src/AdaptiveComponentContainer.hpp>
+#include <entity-system/src/DuplicateAwareComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  bool operator==(const CompPosition& other) const {return position == other.position;}
+
+  glm::vec3 position;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentHash<CompPosition>
+{
+  size_t operator()(const CompPosition& c) const {return std::hash<float>()(c.position.x);}
+};
+}
+
+namespace {
+
+// Counts assignments, which sorting performs.
+struct CompName
+{
+  static int numAssigned;
+
+  CompName() : name(0) {}
+  CompName(int nameIn) : name(nameIn) {}
+  CompName(const CompName& other) : name(other.name) {}
+  CompName& operator=(const CompName& other) {name = other.name; ++numAssigned; return *this;}
+
+  int name;
+};
+
+int CompName::numAssigned = 0;
+
+typedef std::vector<std::pair<uint64_t, CompPosition>> Positions;
+
+Positions makeLevel(uint64_t first, uint64_t count)
+{
+  Positions level;
+  for (uint64_t id = first; id < first + count; ++id)
+    level.push_back(std::make_pair(id, CompPosition(glm::vec3(static_cast<float>(id)))));
+  return level;
+}
+
+// Bulk and one by one additions give the same container.
+template <typename Container>
+void checkBulkInsert()
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  Container bulk;
+  Container single;
+  Positions sorted = makeLevel(1, 5000);
+  Positions above = makeLevel(10000, 100);
+  Positions shuffled = makeLevel(5001, 2000);
+  std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+  bulk.addComponents(&sorted[0], sorted.size(), true);
+  bulk.addComponents(&above[0], above.size(), true);
+  for (const std::pair<uint64_t, CompPosition>& item : sorted)
+    single.addComponent(item.first, item.second);
+  for (const std::pair<uint64_t, CompPosition>& item : above)
+    single.addComponent(item.first, item.second);
+  for (int frame = 0; frame < 3; ++frame)
+  {
+    bulk.renormalize(true);
+    single.renormalize(true);
+  }
+
+  bulk.addComponents(&shuffled[0], shuffled.size());
+  bulk.addComponents(&sorted[0], 10, true);
+  for (const std::pair<uint64_t, CompPosition>& item : shuffled)
+    single.addComponent(item.first, item.second);
+  for (size_t i = 0; i < 10; ++i)
+    single.addComponent(sorted[i].first, sorted[i].second);
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    bulk.renormalize(true);
+    single.renormalize(true);
+  }
+
+  ASSERT_EQ(single.getNumComponents(), bulk.getNumComponents());
+  EXPECT_EQ(7110, bulk.getNumComponents());
+  for (uint64_t i = 0; i < bulk.getNumComponents(); ++i)
+  {
+    ASSERT_EQ(single.getComponentArray()[i].sequence, bulk.getComponentArray()[i].sequence);
+    ASSERT_TRUE(single.getComponentArray()[i].get().position == bulk.getComponentArray()[i].get().position);
+  }
+}
+
+TEST(EntitySystem, TestBulkInsert)
+{
+  checkBulkInsert<es::ComponentContainer<CompPosition>>();
+  checkBulkInsert<es::IncrementalComponentContainer<CompPosition>>();
+  checkBulkInsert<es::DoubleBufferedComponentContainer<CompPosition>>();
+  checkBulkInsert<es::AdaptiveComponentContainer<CompPosition>>();
+  checkBulkInsert<es::DuplicateAwareComponentContainer<CompPosition>>();
+}
+
+TEST(EntitySystem, TestBulkInsertSkipsSort)
+{
+  es::ComponentContainer<CompName> c;
+  std::vector<std::pair<uint64_t, CompName>> names;
+  for (uint64_t id = 1; id <= 1000; ++id)
+    names.push_back(std::make_pair(id, CompName(static_cast<int>(id))));
+
+  // In order, after the components already held: nothing to sort.
+  c.addComponents(&names[0], 500, true);
+  CompName::numAssigned = 0;
+  c.renormalize(false);
+  c.addComponents(&names[500], 500, true);
+  c.renormalize(false);
+  EXPECT_EQ(0, CompName::numAssigned);
+  ASSERT_EQ(1000, c.getNumComponents());
+  EXPECT_EQ(1000, c.getComponentArray()[999].get().name);
+
+  // Out of order is sorted in as usual.
+  c.addComponents(&names[0], 1, true);
+  c.renormalize(false);
+  EXPECT_LT(0, CompName::numAssigned);
+  EXPECT_EQ(1, c.getComponentArray()[1].sequence);
+  EXPECT_EQ(2, c.getComponentArray()[2].sequence);
+}
+
+TEST(EntitySystem, TestBulkInsertCore)
+{
+  es::ESCore core;
+  Positions level = makeLevel(1, 1000);
+  core.addComponents(level, true);
+  core.renormalize(true);
+  es::ComponentContainer<CompPosition>* positions = dynamic_cast<es::ComponentContainer<CompPosition>*>(
+      core.getComponentContainer(es::getESTypeID<CompPosition>()));
+  ASSERT_NE(nullptr, positions);
+  ASSERT_EQ(1000, positions->getNumComponents());
+  EXPECT_EQ(1000, positions->getUpperSequence());
+
+  // Invalid input is rejected as a whole.
+  Positions unsorted = makeLevel(2000, 10);
+  std::swap(unsorted[3], unsorted[7]);
+  EXPECT_THROW(core.addComponents(unsorted, true), std::runtime_error);
+  unsorted = makeLevel(2000, 10);
+  unsorted[5].first = 0;
+  EXPECT_THROW(core.addComponents(unsorted), std::runtime_error);
+  core.renormalize(true);
+  EXPECT_EQ(1000, positions->getNumComponents());
+
+  core.addComponents(Positions());
+  core.addComponents(makeLevel(1001, 10));
+  core.renormalize(true);
+  EXPECT_EQ(1010, positions->getNumComponents());
+}
+
+}
+
@@ -0,0 +1,306 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/DuplicateAwareComponentContainer.hpp>
+#include <entity-system/src/IncrementalComponentContainer.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <set>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+// One transform type per container type under test.
+template <int N>
+struct CompTransform
+{
+  CompTransform() {}
+  CompTransform(const glm::vec3& pos) {position = pos;}
+
+  bool operator==(const CompTransform& other) const {return position == other.position;}
+
+  glm::vec3 position;
+};
+
+struct CompMesh
+{
+  CompMesh() : mesh(0) {}
+  CompMesh(int meshIn) : mesh(meshIn) {}
+
+  int mesh;
+};
+
+typedef CompTransform<0> CompPlain;
+typedef CompTransform<1> CompIndexed;
+typedef CompTransform<2> CompIncremental;
+typedef CompTransform<3> CompBuffered;
+
+}
+
+namespace CPM_ES_NS {
+template <int N> struct TrackComponentChanges<CompTransform<N>> : std::true_type {};
+template <> struct ComponentHash<CompIndexed>
+{
+  size_t operator()(const CompIndexed& c) const {return std::hash<float>()(c.position.x);}
+};
+template <> struct ComponentContainerType<CompIndexed>
+{typedef DuplicateAwareComponentContainer<CompIndexed> type;};
+template <> struct ComponentContainerType<CompIncremental>
+{typedef IncrementalComponentContainer<CompIncremental> type;};
+template <> struct ComponentContainerType<CompBuffered>
+{typedef DoubleBufferedComponentContainer<CompBuffered> type;};
+}
+
+namespace {
+
+static_assert(sizeof(es::ComponentContainer<CompMesh>::ComponentItem) == 16, "Untracked items carry no version.");
+static_assert(es::ComponentContainer<CompPlain>::TrivialItems, "Tracked items stay trivial.");
+
+// Uploads transforms that changed.
+template <typename T>
+class UploadSystem : public es::GenericSystem<false, T>
+{
+public:
+  std::set<uint64_t> visited;
+  int numExecuted = 0;
+
+  bool isChangeFiltered(uint64_t templateID) override
+  {
+    return es::Changed<T>(templateID);
+  }
+
+  void execute(es::ESCoreBase&, uint64_t entityID, const T*) override
+  {
+    visited.insert(entityID);
+    ++numExecuted;
+  }
+};
+
+// Moves the transforms of entities with a mesh, in place.
+template <typename T>
+class MoveSystem : public es::GenericSystem<false, T, CompMesh>
+{
+public:
+  bool isComponentWritten(uint64_t templateID) override
+  {
+    return es::WrittenComponents<T>(templateID);
+  }
+
+  void execute(es::ESCoreBase&, uint64_t, const T* transform, const CompMesh*) override
+  {
+    T* t = this->write(transform);
+    t->position = t->position + glm::vec3(1.0f);
+  }
+};
+
+template <typename T>
+es::ComponentContainer<T>* transforms(es::ESCore& core)
+{
+  return dynamic_cast<es::ComponentContainer<T>*>(core.getComponentContainer(es::getESTypeID<T>()));
+}
+
+// Random changes, checked against the set of entities we changed.
+template <typename T>
+void checkChangeTracking()
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore core;
+  const uint64_t maxID = 3000;
+  for (uint64_t id = 1; id <= maxID; ++id)
+  {
+    core.addComponent(id, T(glm::vec3(static_cast<float>(id))));
+    if (id % 500 == 0)
+      core.addComponent(id, CompMesh(static_cast<int>(id)));
+  }
+  core.renormalize(true);
+
+  UploadSystem<T> upload;
+  upload.walkComponents(core);
+  EXPECT_EQ(maxID, upload.visited.size());
+
+  // Nothing changed.
+  upload.visited.clear();
+  upload.walkComponents(core);
+  EXPECT_TRUE(upload.visited.empty());
+
+  std::uniform_int_distribution<uint64_t> entity(1, maxID);
+  std::set<uint64_t> alive;
+  for (uint64_t id = 1; id <= maxID; ++id)
+    alive.insert(id);
+  uint64_t nextID = maxID + 1;
+
+  MoveSystem<T> move;
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    std::set<uint64_t> expected;
+    es::ComponentContainer<T>* container = transforms<T>(core);
+
+    // Queued modifications, field patches and functors.
+    for (int i = 0; i < 20; ++i)
+    {
+      uint64_t id = entity(rng);
+      std::pair<const T*, size_t> c = container->getComponent(id);
+      if (c.first == nullptr)
+        continue;
+      expected.insert(id);
+      if (i % 3 == 0)
+        container->modifyIndex(T(glm::vec3(0.0f)), c.second, 1);
+      else if (i % 3 == 1)
+        container->modifyFieldIndex(&T::position, glm::vec3(1.0f), c.second, 1);
+      else
+        container->modifyIndexWith([](T& t) {t.position.x = 2.0f;}, c.second, 1);
+    }
+
+    // Additions: new entities and second transforms of existing ones.
+    for (int i = 0; i < 5; ++i)
+    {
+      core.addComponent(nextID, T(glm::vec3(0.0f)));
+      alive.insert(nextID);
+      expected.insert(nextID++);
+      uint64_t id = entity(rng);
+      if (alive.count(id))
+      {
+        core.addComponent(id, T(glm::vec3(0.0f)));
+        expected.insert(id);
+      }
+    }
+
+    // Removals are not changes.
+    for (int i = 0; i < 5; ++i)
+    {
+      uint64_t id = entity(rng);
+      core.removeEntity(id);
+      alive.erase(id);
+      expected.erase(id);
+    }
+
+    core.renormalize(true);
+
+    // In place writes count too, before the next renormalize.
+    if (transforms<T>(core)->canWriteInPlace())
+    {
+      move.walkComponents(core);
+      for (uint64_t id = 500; id <= maxID; id += 500)
+      {
+        if (alive.count(id))
+          expected.insert(id);
+      }
+    }
+
+    upload.visited.clear();
+    upload.walkComponents(core);
+    ASSERT_TRUE(expected == upload.visited) << "frame " << frame;
+    core.renormalize(true);
+  }
+}
+
+TEST(EntitySystem, TestChangeTracking)
+{
+  checkChangeTracking<CompPlain>();
+  checkChangeTracking<CompIndexed>();
+  checkChangeTracking<CompIncremental>();
+  checkChangeTracking<CompBuffered>();
+}
+
+TEST(EntitySystem, TestChangeTrackingFilters)
+{
+  // Visits entities for which any filtered component changed.
+  class TwoFilterSystem : public es::GenericSystem<false, CompPlain, CompIndexed>
+  {
+  public:
+    std::set<uint64_t> visited;
+
+    bool isChangeFiltered(uint64_t templateID) override
+    {
+      return es::Changed<CompPlain, CompIndexed>(templateID);
+    }
+
+    void execute(es::ESCoreBase&, uint64_t entityID, const CompPlain*, const CompIndexed*) override
+    {
+      visited.insert(entityID);
+    }
+  };
+
+  // Writes what it filters on: its own writes do not trigger it again.
+  class SelfSystem : public es::GenericSystem<true, CompPlain>
+  {
+  public:
+    int numExecuted = 0;
+
+    bool isComponentWritten(uint64_t templateID) override {return es::WrittenComponents<CompPlain>(templateID);}
+    bool isChangeFiltered(uint64_t templateID) override   {return es::Changed<CompPlain>(templateID);}
+
+    void groupExecute(es::ESCoreBase&, uint64_t, const es::ComponentGroup<CompPlain>& plain) override
+    {
+      ++numExecuted;
+      write(plain).position.y = 5.0f;
+    }
+  };
+
+  // Changes of untracked components cannot be filtered.
+  class MeshSystem : public es::GenericSystem<false, CompMesh>
+  {
+  public:
+    bool isChangeFiltered(uint64_t templateID) override {return es::Changed<CompMesh>(templateID);}
+    void execute(es::ESCoreBase&, uint64_t, const CompMesh*) override {}
+  };
+
+  es::ESCore core;
+  for (uint64_t id = 1; id <= 200; ++id)
+  {
+    core.addComponent(id, CompPlain(glm::vec3(0.0f)));
+    core.addComponent(id, CompIndexed(glm::vec3(0.0f)));
+    core.addComponent(id, CompMesh(0));
+  }
+  core.renormalize(true);
+
+  TwoFilterSystem two;
+  two.walkComponents(core);
+  EXPECT_EQ(200, two.visited.size());
+
+  es::ComponentContainer<CompPlain>* plain = transforms<CompPlain>(core);
+  es::ComponentContainer<CompIndexed>* indexed = transforms<CompIndexed>(core);
+  plain->modifyIndex(CompPlain(glm::vec3(1.0f)), plain->getComponent(10).second, 1);
+  indexed->modifyIndex(CompIndexed(glm::vec3(1.0f)), indexed->getComponent(150).second, 1);
+  indexed->modifyIndex(CompIndexed(glm::vec3(1.0f)), indexed->getComponent(10).second, 1);
+  core.renormalize(true);
+  EXPECT_LT(0, plain->getComponentVersion(plain->getComponent(10).second));
+  two.visited.clear();
+  two.walkComponents(core);
+  EXPECT_TRUE((std::set<uint64_t>{10, 150}) == two.visited);
+
+  SelfSystem self;
+  self.walkComponents(core);
+  EXPECT_EQ(200, self.numExecuted);
+  self.walkComponents(core);
+  EXPECT_EQ(200, self.numExecuted);
+  core.renormalize(true);
+
+  // But they trigger other systems.
+  two.visited.clear();
+  two.walkComponents(core);
+  EXPECT_EQ(200, two.visited.size());
+
+  // Walking another core starts over.
+  es::ESCore other;
+  other.addComponent(7, CompPlain(glm::vec3(0.0f)));
+  other.addComponent(7, CompIndexed(glm::vec3(0.0f)));
+  other.renormalize(true);
+  two.visited.clear();
+  two.walkComponents(other);
+  EXPECT_TRUE((std::set<uint64_t>{7}) == two.visited);
+
+  MeshSystem mesh;
+  EXPECT_THROW(mesh.walkComponents(core), std::runtime_error);
+}
+
+}
+
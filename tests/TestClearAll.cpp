@@ -0,0 +1,200 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/ReactiveSystem.hpp>
+#include <entity-system/src/IncrementalComponentContainer.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <entity-system/src/SparseComponentContainer.hpp>
+#include <entity-system/src/UniqueComponentContainer.hpp>
+#include <entity-system/src/DuplicateAwareComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <map>
+#include <set>
+#include <glm/glm.hpp>
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompMesh
+{
+  static std::vector<uint64_t> constructed;
+  static std::vector<uint64_t> destructed;
+
+  CompMesh() : mesh(0) {}
+  CompMesh(int meshIn) : mesh(meshIn) {}
+
+  void componentConstruct(uint64_t id) {constructed.push_back(id);}
+  void componentDestruct(uint64_t id)  {destructed.push_back(id);}
+
+  bool operator==(const CompMesh& other) const {return mesh == other.mesh;}
+
+  int mesh;
+};
+
+std::vector<uint64_t> CompMesh::constructed;
+std::vector<uint64_t> CompMesh::destructed;
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentHash<CompMesh>
+{
+  size_t operator()(const CompMesh& c) const {return std::hash<int>()(c.mesh);}
+};
+}
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+// Renormalizes until incremental merges are done.
+template <typename Container>
+void renormalizeAll(Container& c)
+{
+  do
+  {
+    c.renormalize(true);
+  } while (c.isDirty());
+}
+
+template <typename Container>
+std::map<uint64_t, int> contents(Container& c)
+{
+  std::map<uint64_t, int> result;
+  for (uint64_t i = 0; i < c.getNumComponents(); ++i)
+    result[c.getComponentArray()[i].sequence] = c.getComponentArray()[i].get().mesh;
+  return result;
+}
+
+template <typename Container>
+void checkClear()
+{
+  const uint64_t numEntities = 1000;
+  Container c;
+  for (uint64_t id = 1; id <= numEntities; ++id)
+    c.addComponent(id, CompMesh(static_cast<int>(id)));
+  renormalizeAll(c);
+  CompMesh::constructed.clear();
+  CompMesh::destructed.clear();
+
+  // Additions and removals queued before the clear are kept,
+  // modifications of the cleared components are dropped.
+  c.addComponent(5000, CompMesh(5000));
+  c.addComponent(3, CompMesh(-3));
+  c.modifyIndex(CompMesh(-1), 0, 1);
+  c.removeSequence(4);
+  c.removeAll();
+  EXPECT_TRUE(c.isClearPending());
+
+  // So are additions and removals queued after it. Removals apply to the
+  // additions.
+  c.addComponent(4, CompMesh(-4));
+  c.addComponent(7, CompMesh(-7));
+  c.addComponent(2, CompMesh(-2));
+  c.removeSequence(7);
+  renormalizeAll(c);
+  EXPECT_FALSE(c.isClearPending());
+
+  // Every old component was destructed, in order, then the removed
+  // additions. Only the additions were constructed.
+  ASSERT_EQ(numEntities + 2, CompMesh::destructed.size());
+  for (uint64_t i = 0; i < numEntities; ++i)
+    ASSERT_EQ(i + 1, CompMesh::destructed[i]);
+  std::set<uint64_t> removedAdditions(CompMesh::destructed.begin() + numEntities, CompMesh::destructed.end());
+  EXPECT_TRUE((std::set<uint64_t>{4, 7}) == removedAdditions);
+  EXPECT_EQ(5, CompMesh::constructed.size());
+
+  std::map<uint64_t, int> expected = {{2, -2}, {3, -3}, {5000, 5000}};
+  EXPECT_TRUE(expected == contents(c));
+
+  // Clearing an empty container, or one with only pending additions.
+  Container empty;
+  empty.removeAll();
+  empty.addComponent(1, CompMesh(1));
+  empty.removeAll();
+  EXPECT_FALSE(empty.isClearPending());
+  renormalizeAll(empty);
+  EXPECT_EQ(1, empty.getNumComponents());
+}
+
+TEST(EntitySystem, TestClearAll)
+{
+  checkClear<es::ComponentContainer<CompMesh>>();
+  checkClear<es::IncrementalComponentContainer<CompMesh>>();
+  checkClear<es::DoubleBufferedComponentContainer<CompMesh>>();
+  checkClear<es::SparseComponentContainer<CompMesh>>();
+  checkClear<es::UniqueComponentContainer<CompMesh>>();
+  checkClear<es::DuplicateAwareComponentContainer<CompMesh>>();
+}
+
+TEST(EntitySystem, TestClearAllOverlapped)
+{
+  // Additions handed to a back buffer that is being built survive a clear.
+  es::DoubleBufferedComponentContainer<CompMesh> c;
+  for (uint64_t id = 1; id <= 10; ++id)
+    c.addComponent(id, CompMesh(static_cast<int>(id)));
+  c.renormalize(true);
+
+  c.addComponent(20, CompMesh(20));
+  c.prepareRenormalize(true);
+  c.removeAll();
+  c.addComponent(30, CompMesh(30));
+  c.buildBackBuffer();
+  c.swapBuffers();
+  EXPECT_EQ(11, c.getNumComponents());
+  c.renormalize(true);
+
+  std::map<uint64_t, int> expected = {{20, 20}, {30, 30}};
+  EXPECT_TRUE(expected == contents(c));
+}
+
+TEST(EntitySystem, TestClearAllCore)
+{
+  // Counts removed components.
+  class RemovedSystem : public es::ReactiveSystem<CompMesh>
+  {
+  public:
+    size_t numRemoved = 0;
+
+    void onRemoved(es::ESCoreBase&, const ComponentItem*, size_t count) override
+    {
+      numRemoved += count;
+    }
+  };
+
+  // Level transition: the old level is cleared, the next one is loaded in
+  // the same frame, reusing entity IDs.
+  es::ESCore core;
+  RemovedSystem removed;
+  core.addReactiveSystem(&removed);
+  for (uint64_t id = 1; id <= 100; ++id)
+  {
+    core.addComponent(id, CompMesh(1));
+    core.addComponent(id, CompPosition(glm::vec3(1.0f)));
+  }
+  core.renormalize(true);
+
+  core.clearAllComponentContainers();
+  for (uint64_t id = 51; id <= 150; ++id)
+    core.addComponent(id, CompMesh(2));
+  core.renormalize(true);
+  EXPECT_EQ(100, removed.numRemoved);
+
+  es::ComponentContainer<CompMesh>* meshes = dynamic_cast<es::ComponentContainer<CompMesh>*>(
+      core.getComponentContainer(es::getESTypeID<CompMesh>()));
+  ASSERT_EQ(100, meshes->getNumComponents());
+  EXPECT_EQ(51, meshes->getComponentArray()[0].sequence);
+  EXPECT_EQ(2, meshes->getComponentArray()[0].get().mesh);
+  EXPECT_EQ(0, core.getComponentContainer(es::getESTypeID<CompPosition>())->getNumComponents());
+}
+
+}
+
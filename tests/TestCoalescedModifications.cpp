@@ -0,0 +1,145 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompHealth
+{
+  CompHealth() : health(0), source(0) {}
+  CompHealth(int healthIn, int sourceIn) : health(healthIn), source(sourceIn) {}
+
+  int health;
+  int source;   ///< Which modification produced this value.
+};
+
+// Many writers modify the same components with distinct priorities, in
+// random order. Coalesced and sorted queues must pick the same winners.
+template <typename Container>
+void checkCoalescedMatchesSorted()
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  Container coalesced;
+  Container sorted;
+  coalesced.setCoalesceModifications(true);
+  EXPECT_TRUE(coalesced.getCoalesceModifications());
+  EXPECT_FALSE(sorted.getCoalesceModifications());
+
+  const uint64_t maxID = 2000;
+  for (uint64_t id = 1; id <= maxID; ++id)
+  {
+    coalesced.addComponent(id, CompHealth(static_cast<int>(id), 0));
+    sorted.addComponent(id, CompHealth(static_cast<int>(id), 0));
+  }
+  coalesced.renormalize(true);
+  sorted.renormalize(true);
+
+  std::uniform_int_distribution<size_t> component(0, 499);
+  std::vector<int> priorities(20 * 200);
+  for (size_t i = 0; i < priorities.size(); ++i)
+    priorities[i] = static_cast<int>(i);
+  int source = 0;
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    std::shuffle(priorities.begin(), priorities.end(), rng);
+    std::set<size_t> touched;
+    for (int writer = 0; writer < 20; ++writer)
+    {
+      for (int i = 0; i < 200; ++i)
+      {
+        size_t index = component(rng);
+        int p = priorities[writer * 200 + i];
+        ++source;
+        coalesced.modifyIndex(CompHealth(frame, source), index, p);
+        sorted.modifyIndex(CompHealth(frame, source), index, p);
+        touched.insert(index);
+      }
+    }
+
+    // One queued modification per distinct component.
+    EXPECT_EQ(touched.size(), coalesced.getNumPendingModifications());
+    EXPECT_EQ(20 * 200, sorted.getNumPendingModifications());
+
+    for (int i = 0; i < 10; ++i)
+    {
+      uint64_t id = 1 + component(rng);
+      coalesced.removeSequence(id);
+      sorted.removeSequence(id);
+      coalesced.addComponent(id + maxID, CompHealth(frame, 0));
+      sorted.addComponent(id + maxID, CompHealth(frame, 0));
+    }
+
+    coalesced.renormalize(true);
+    sorted.renormalize(true);
+    EXPECT_EQ(0, coalesced.getNumPendingModifications());
+
+    ASSERT_EQ(sorted.getNumComponents(), coalesced.getNumComponents());
+    for (uint64_t i = 0; i < sorted.getNumComponents(); ++i)
+    {
+      ASSERT_EQ(sorted.getComponentArray()[i].sequence, coalesced.getComponentArray()[i].sequence);
+      ASSERT_EQ(sorted.getComponentArray()[i].get().source, coalesced.getComponentArray()[i].get().source);
+      ASSERT_EQ(sorted.getComponentArray()[i].get().health, coalesced.getComponentArray()[i].get().health);
+    }
+  }
+}
+
+TEST(EntitySystem, TestCoalescedModifications)
+{
+  // Equal priorities: the earliest modification wins.
+  es::ComponentContainer<CompHealth> c;
+  c.setCoalesceModifications(true);
+  c.addComponent(1, CompHealth(1, 0));
+  c.renormalize(true);
+  c.modifyIndex(CompHealth(2, 1), 0, 1);
+  c.modifyIndex(CompHealth(3, 2), 0, 1);
+  c.modifyIndex(CompHealth(4, 3), 0, 0);
+  EXPECT_EQ(1, c.getNumPendingModifications());
+  c.renormalize(true);
+  EXPECT_EQ(2, c.getComponentArray()[0].get().health);
+
+  // A higher priority replaces the winner.
+  c.modifyIndex(CompHealth(5, 4), 0, 1);
+  c.modifyIndex(CompHealth(6, 5), 0, 2);
+  c.modifyIndex(CompHealth(7, 6), 0, 2);
+  c.renormalize(true);
+  EXPECT_EQ(6, c.getComponentArray()[0].get().health);
+
+  // Field patches are still overridden by a winner of higher priority.
+  c.modifyIndex(CompHealth(8, 7), 0, 3);
+  c.modifyFieldIndex(&CompHealth::health, 9, 0, 2);
+  c.modifyFieldIndex(&CompHealth::source, 10, 0, 3);
+  c.renormalize(true);
+  EXPECT_EQ(8, c.getComponentArray()[0].get().health);
+  EXPECT_EQ(10, c.getComponentArray()[0].get().source);
+
+  // Enabling coalescing merges what is already queued.
+  es::ComponentContainer<CompHealth> late;
+  late.addComponent(1, CompHealth(1, 0));
+  late.renormalize(true);
+  late.modifyIndex(CompHealth(2, 1), 0, 1);
+  late.modifyIndex(CompHealth(3, 2), 0, 1);
+  late.setCoalesceModifications(true);
+  EXPECT_EQ(1, late.getNumPendingModifications());
+  late.modifyIndex(CompHealth(4, 3), 0, 1);
+  late.renormalize(true);
+  EXPECT_EQ(2, late.getComponentArray()[0].get().health);
+
+  checkCoalescedMatchesSorted<es::ComponentContainer<CompHealth>>();
+  checkCoalescedMatchesSorted<es::DoubleBufferedComponentContainer<CompHealth>>();
+}
+
+}
+
@@ -0,0 +1,235 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <thread>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompHealth
+{
+  CompHealth() : health(0), damage(0) {}
+  CompHealth(int healthIn, int damageIn) : health(healthIn), damage(damageIn) {}
+
+  int health;
+  int damage;
+};
+
+struct CompForce
+{
+  CompForce() {}
+  CompForce(const glm::vec3& forceIn) : force(forceIn) {}
+
+  CompForce operator+(const CompForce& other) const {return CompForce(force + other.force);}
+
+  glm::vec3 force;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+TEST(EntitySystem, TestCombineModifications)
+{
+  es::ComponentContainer<CompHealth> c;
+  for (uint64_t id = 1; id <= 3; ++id)
+    c.addComponent(id, CompHealth(100, 0));
+  c.renormalize(true);
+
+  // All contributions are folded, none replaces another.
+  c.combineFieldIndex(&CompHealth::damage, 10, 0, es::CombineSum(), 1);
+  c.combineFieldIndex(&CompHealth::damage, 15, 0, es::CombineSum(), 1);
+  c.combineFieldIndex(&CompHealth::damage, 5, 0, es::CombineSum(), 1);
+  c.combineFieldIndex(&CompHealth::health, 40, 1, es::CombineMin(), 1);
+  c.combineFieldIndex(&CompHealth::health, 20, 1, es::CombineMin(), 1);
+  c.combineFieldIndex(&CompHealth::health, 30, 1, es::CombineMin(), 1);
+  c.combineFieldIndex(&CompHealth::damage, 3, 2, es::CombineMax(), 1);
+  c.combineFieldIndex(&CompHealth::damage, 7, 2, es::CombineMax(), 1);
+  c.renormalize(true);
+  EXPECT_EQ(30, c.getComponentArray()[0].get().damage);
+  EXPECT_EQ(100, c.getComponentArray()[0].get().health);
+  EXPECT_EQ(20, c.getComponentArray()[1].get().health);
+  EXPECT_EQ(7, c.getComponentArray()[2].get().damage);
+
+  // User-defined associative operation on the whole component.
+  auto addBoth = [](const CompHealth& a, const CompHealth& b)
+  {
+    return CompHealth(a.health + b.health, a.damage + b.damage);
+  };
+  c.combineIndex(CompHealth(-5, 1), 0, addBoth, 1);
+  c.combineIndex(CompHealth(-5, 1), 0, addBoth, 1);
+  c.renormalize(true);
+  EXPECT_EQ(90, c.getComponentArray()[0].get().health);
+  EXPECT_EQ(32, c.getComponentArray()[0].get().damage);
+
+  // A whole-component modification of higher priority overrides combining
+  // modifications of lower priority; those of the same priority fold onto it.
+  c.modifyIndex(CompHealth(50, 0), 1, 2);
+  c.combineFieldIndex(&CompHealth::damage, 10, 1, es::CombineSum(), 1);
+  c.combineFieldIndex(&CompHealth::damage, 4, 1, es::CombineSum(), 2);
+  c.renormalize(true);
+  EXPECT_EQ(50, c.getComponentArray()[1].get().health);
+  EXPECT_EQ(4, c.getComponentArray()[1].get().damage);
+
+  // Folded in order of increasing priority.
+  c.combineFieldIndex(&CompHealth::health, 2, 2, [](int a, int b) {return a * b;}, 2);
+  c.combineFieldIndex(&CompHealth::health, 1, 2, es::CombineSum(), 1);
+  c.renormalize(true);
+  EXPECT_EQ(202, c.getComponentArray()[2].get().health);
+
+  EXPECT_EQ(0, es::FrameArena::local().getNumLiveAllocations());
+}
+
+// Float sums from several worker threads must not depend on the order in
+// which the workers' buffers are merged.
+template <typename Container>
+void checkBuffersAreDeterministic()
+{
+  const int numWorkers = 4;
+  const size_t numComponents = 200;
+  const int numContributions = 5000;
+
+  std::vector<std::unique_ptr<es::ModificationBuffer<CompForce>>> buffers;
+  for (int w = 0; w < numWorkers; ++w)
+    buffers.emplace_back(new es::ModificationBuffer<CompForce>(static_cast<uint32_t>(w + 1)));
+
+  // Contributions of every worker, generated up front so that the expected
+  // result can be computed sequentially.
+  std::vector<std::vector<std::pair<size_t, float>>> work(numWorkers);
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::uniform_int_distribution<size_t> component(0, numComponents - 1);
+  std::uniform_real_distribution<float> magnitude(-1000.0f, 1000.0f);
+  for (int w = 0; w < numWorkers; ++w)
+    for (int i = 0; i < numContributions; ++i)
+      work[w].push_back(std::make_pair(component(rng), magnitude(rng) * static_cast<float>(i % 7 + 1) * 1e-3f));
+
+  std::vector<std::thread> threads;
+  for (int w = 0; w < numWorkers; ++w)
+  {
+    threads.emplace_back([w, &work, &buffers]()
+    {
+      for (const std::pair<size_t, float>& contribution : work[w])
+        buffers[w]->combine(CompForce(glm::vec3(contribution.second)), contribution.first, es::CombineSum());
+    });
+  }
+  for (std::thread& thread : threads)
+    thread.join();
+
+  std::vector<std::unique_ptr<es::ModificationBuffer<CompForce>>> copies;
+  for (int w = 0; w < numWorkers; ++w)
+  {
+    copies.emplace_back(new es::ModificationBuffer<CompForce>(static_cast<uint32_t>(w + 1)));
+    for (const std::pair<size_t, float>& contribution : work[w])
+      copies[w]->combine(CompForce(glm::vec3(contribution.second)), contribution.first, es::CombineSum());
+  }
+
+  Container forward;
+  Container backward;
+  for (uint64_t id = 1; id <= numComponents; ++id)
+  {
+    forward.addComponent(id, CompForce(glm::vec3(0.1f)));
+    backward.addComponent(id, CompForce(glm::vec3(0.1f)));
+  }
+  forward.renormalize(true);
+  backward.renormalize(true);
+
+  for (int w = 0; w < numWorkers; ++w)
+    forward.mergeModifications(*buffers[w]);
+  for (int w = numWorkers - 1; w >= 0; --w)
+    backward.mergeModifications(*copies[w]);
+  EXPECT_TRUE(buffers[0]->empty());
+  EXPECT_TRUE(copies[0]->empty());
+  forward.renormalize(true);
+  backward.renormalize(true);
+
+  std::vector<float> expected(numComponents, 0.1f);
+  for (int w = 0; w < numWorkers; ++w)
+    for (const std::pair<size_t, float>& contribution : work[w])
+      expected[contribution.first] += contribution.second;
+
+  ASSERT_EQ(numComponents, forward.getNumComponents());
+  ASSERT_EQ(numComponents, backward.getNumComponents());
+  for (size_t i = 0; i < numComponents; ++i)
+  {
+    ASSERT_EQ(expected[i], forward.getComponentArray()[i].get().force.x);
+    ASSERT_EQ(expected[i], backward.getComponentArray()[i].get().force.x);
+  }
+}
+
+TEST(EntitySystem, TestCombineModificationsBuffers)
+{
+  checkBuffersAreDeterministic<es::ComponentContainer<CompForce>>();
+  checkBuffersAreDeterministic<es::DoubleBufferedComponentContainer<CompForce>>();
+
+  // Everything was released, including the allocations of the workers.
+  EXPECT_EQ(0, es::FrameArena::local().getNumLiveAllocations());
+}
+
+TEST(EntitySystem, TestCombineModificationsGroup)
+{
+  // Every attacker adds its damage to the same target.
+  class DamageSystem : public es::GenericSystem<false, CompGameplay>
+  {
+  public:
+    DamageSystem(const es::ComponentGroup<CompHealth>* targetIn) : target(targetIn) {}
+
+    void execute(es::ESCoreBase&, uint64_t, const CompGameplay* gp) override
+    {
+      target->combineField(&CompHealth::damage, gp->armor, es::CombineSum());
+      target->combineField(&CompHealth::health, gp->health, es::CombineMin());
+    }
+
+    const es::ComponentGroup<CompHealth>* target;
+  };
+
+  class TargetSystem : public es::GenericSystem<true, CompHealth>
+  {
+  public:
+    void groupExecute(es::ESCoreBase& core, uint64_t,
+                      const es::ComponentGroup<CompHealth>& health) override
+    {
+      DamageSystem damage(&health);
+      damage.walkComponents(core);
+    }
+  };
+
+  es::ESCore core;
+  core.addComponent(1, CompHealth(1000, 0));
+  for (uint64_t id = 2; id <= 50; ++id)
+    core.addComponent(id, CompGameplay(static_cast<int>(id) * 10, static_cast<int>(id)));
+  core.renormalize(true);
+
+  TargetSystem system;
+  system.walkComponents(core);
+  core.renormalize(true);
+
+  es::ComponentContainer<CompHealth>* container = dynamic_cast<es::ComponentContainer<CompHealth>*>(
+      core.getComponentContainer(es::getESTypeID<CompHealth>()));
+  ASSERT_NE(nullptr, container);
+  const CompHealth* h = container->getComponent(1).first;
+  ASSERT_NE(nullptr, h);
+  EXPECT_EQ(50 * 51 / 2 - 1, h->damage);
+  EXPECT_EQ(20, h->health);
+}
+
+}
+
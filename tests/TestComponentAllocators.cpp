@@ -0,0 +1,198 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/ComponentAllocators.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+// Components in huge pages, queues in the frame arena.
+struct CompHugePosition
+{
+  CompHugePosition() {}
+  CompHugePosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+// Components and queues in the block pool.
+struct CompPoolPosition
+{
+  CompPoolPosition() {}
+  CompPoolPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+// Same data in the default storage, as reference.
+struct CompRefPosition
+{
+  CompRefPosition() {}
+  CompRefPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentStorageType<CompHugePosition>
+    : AllocatorComponentStorage<HugePageAllocator, FrameArenaAllocator, true> {};
+template <> struct ComponentStorageType<CompPoolPosition>
+    : AllocatorComponentStorage<PoolAllocator, PoolAllocator> {};
+}
+
+namespace {
+
+// (entity, position.x, health)
+typedef std::tuple<uint64_t, float, int> Entry;
+
+template <typename Pos>
+class RecordSystem : public es::GenericSystem<true, Pos, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<Pos>& pos,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    for (const Pos& p : pos)
+      log.push_back(std::make_tuple(entityID, p.position.x, gp.front().health));
+
+    Pos moved = pos.front();
+    moved.position.x += 1.0f;
+    pos.modify(moved, 0);
+  }
+};
+
+TEST(EntitySystem, TestAllocators)
+{
+  // Huge page blocks are 2 MB aligned, small ones come from the heap.
+  es::HugePageAllocator<uint64_t> huge;
+  const size_t n = (size_t(4) << 20) / sizeof(uint64_t);
+  uint64_t* block = huge.allocate(n);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(block) % es::HugePageMemory::HugePageSize);
+  for (size_t i = 0; i < n; ++i)
+    block[i] = i;
+  EXPECT_EQ(n - 1, block[n - 1]);
+  huge.deallocate(block, n);
+  huge.deallocate(huge.allocate(10), 10);
+
+  // Freed pool blocks are reused for the same size class.
+  es::PoolAllocator<int> pool;
+  int* a = pool.allocate(100);
+  pool.deallocate(a, 100);
+  int* b = pool.allocate(120);
+  EXPECT_EQ(a, b);
+  pool.deallocate(b, 120);
+
+  // The frame arena starts over once everything was freed.
+  es::FrameArena& arena = es::FrameArena::local();
+  es::FrameArenaAllocator<char> frame;
+  char* first = frame.allocate(100);
+  char* second = frame.allocate(100);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(second) % 16);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2, arena.getNumLiveAllocations());
+  frame.deallocate(first, 100);
+  frame.deallocate(second, 100);
+  EXPECT_EQ(0, arena.getNumLiveAllocations());
+  char* third = frame.allocate(100);
+  EXPECT_EQ(first, third);
+  frame.deallocate(third, 100);
+
+  // Overflowing chunks are merged into one at the next reset.
+  std::vector<char*> blocks;
+  for (int i = 0; i < 100; ++i)
+    blocks.push_back(frame.allocate(4096));
+  for (char* p : blocks)
+    frame.deallocate(p, 4096);
+  size_t reserved = arena.getReservedBytes();
+  frame.deallocate(frame.allocate(1), 1);
+  EXPECT_GE(reserved, arena.getReservedBytes());
+  EXPECT_GE(arena.getReservedBytes(), size_t(100 * 4096));
+}
+
+TEST(EntitySystem, TestAllocatorStorage)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore core;
+  const uint64_t maxID = 20000;
+  for (uint64_t id = 1; id <= maxID; id += 2)
+    core.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+
+  auto addPosition = [&core](uint64_t id, float x)
+  {
+    core.addComponent(id, CompHugePosition(glm::vec3(x)));
+    core.addComponent(id, CompPoolPosition(glm::vec3(x)));
+    core.addComponent(id, CompRefPosition(glm::vec3(x)));
+  };
+
+  for (uint64_t id = 1; id <= maxID; ++id)
+    addPosition(id, static_cast<float>(id));
+  core.renormalize(true);
+
+  es::FrameArena& arena = es::FrameArena::local();
+  std::uniform_int_distribution<uint64_t> entity(1, maxID);
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    for (int i = 0; i < 5000; ++i)
+      addPosition(entity(rng), static_cast<float>(frame * 10000 + i));
+    for (int i = 0; i < 500; ++i)
+    {
+      uint64_t id = entity(rng);
+      core.removeFirstComponentT<CompHugePosition>(id);
+      core.removeFirstComponentT<CompPoolPosition>(id);
+      core.removeFirstComponentT<CompRefPosition>(id);
+      id = entity(rng);
+      core.removeComponentAtIndexT<CompHugePosition>(id, 1);
+      core.removeComponentAtIndexT<CompPoolPosition>(id, 1);
+      core.removeComponentAtIndexT<CompRefPosition>(id, 1);
+    }
+    core.removeEntity(entity(rng));
+
+    // Queued removals live in the arena until renormalize releases them.
+    EXPECT_LT(0, arena.getNumLiveAllocations());
+    core.renormalize(true);
+    EXPECT_EQ(0, arena.getNumLiveAllocations());
+
+    RecordSystem<CompHugePosition> huge;
+    RecordSystem<CompPoolPosition> pool;
+    RecordSystem<CompRefPosition> reference;
+    huge.walkComponents(core);
+    pool.walkComponents(core);
+    reference.walkComponents(core);
+    EXPECT_FALSE(huge.log.empty());
+    ASSERT_TRUE(huge.log == reference.log);
+    ASSERT_TRUE(pool.log == reference.log);
+    core.renormalize(true);
+    EXPECT_EQ(0, arena.getNumLiveAllocations());
+  }
+}
+
+}
+
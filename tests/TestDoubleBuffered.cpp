@@ -0,0 +1,260 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <thread>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+struct CompTag
+{
+  CompTag() : tag(0) {}
+  CompTag(int tagIn) : tag(tagIn) {}
+
+  int tag;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentContainerType<CompPosition>
+{typedef DoubleBufferedComponentContainer<CompPosition> type;};
+}
+
+namespace {
+
+// (entity, position.x, health)
+typedef std::tuple<uint64_t, float, int> Entry;
+
+class RecordSystem : public es::GenericSystem<false, CompPosition, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompPosition* pos, const CompGameplay* gp) override
+  {
+    log.push_back(std::make_tuple(entityID, pos->position.x, gp->health));
+  }
+};
+
+// Modifies every position it walks. Used to queue modifications against the
+// front buffer while the back buffer is being built.
+class MoveSystem : public es::GenericSystem<true, CompPosition>
+{
+public:
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<CompPosition>& pos) override
+  {
+    for (size_t i = 0; i < pos.numComponents; ++i)
+    {
+      CompPosition moved = pos.components[i].component;
+      moved.position.x += 1000.0f;
+      pos.modify(moved, i);
+    }
+  }
+};
+
+void applyChurn(es::ESCore& core, std::mt19937& rng, uint64_t maxID)
+{
+  std::uniform_int_distribution<uint64_t> entity(1, maxID);
+  for (int i = 0; i < 40; ++i)
+  {
+    uint64_t id = entity(rng);
+    core.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id * 10 + i), 0.0f, 0.0f)));
+  }
+  for (int i = 0; i < 10; ++i)
+    core.removeFirstComponentT<CompPosition>(entity(rng));
+  for (int i = 0; i < 5; ++i)
+    core.removeEntity(entity(rng));
+}
+
+TEST(EntitySystem, TestDoubleBuffered)
+{
+  std::mt19937 rngA(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::mt19937 rngB(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore buffered;
+  es::ESCore reference;
+  const uint64_t maxID = 100;
+  for (uint64_t id = 1; id <= maxID; ++id)
+  {
+    buffered.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+    reference.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+  }
+
+  // Synchronous renormalize matches ComponentContainer.
+  for (int frame = 0; frame < 4; ++frame)
+  {
+    applyChurn(buffered, rngA, maxID);
+    applyChurn(reference, rngB, maxID);
+    buffered.renormalize(true);
+    reference.renormalize(true);
+
+    ASSERT_NE(nullptr, dynamic_cast<es::DoubleBufferedComponentContainer<CompPosition>*>(
+        buffered.getComponentContainer(es::getESTypeID<CompPosition>())));
+
+    RecordSystem a, b;
+    a.walkComponents(buffered);
+    b.walkComponents(reference);
+    EXPECT_FALSE(a.log.empty());
+    EXPECT_TRUE(a.log == b.log);
+  }
+
+  // Overlapped renormalize: systems keep seeing the front buffer while the
+  // back buffer is built on another thread. Gameplay components are not
+  // double-buffered and are renormalized by prepareRenormalize.
+  for (int frame = 0; frame < 4; ++frame)
+  {
+    applyChurn(buffered, rngA, maxID);
+    applyChurn(reference, rngB, maxID);
+
+    buffered.prepareRenormalize(true);
+
+    RecordSystem before;
+    before.walkComponents(buffered);
+
+    std::thread builder([&buffered]() {buffered.buildBackBuffers();});
+
+    RecordSystem during;
+    during.walkComponents(buffered);
+
+    builder.join();
+    EXPECT_TRUE(before.log == during.log);
+
+    buffered.swapBuffers();
+    reference.renormalize(true);
+
+    RecordSystem a, b;
+    a.walkComponents(buffered);
+    b.walkComponents(reference);
+    EXPECT_TRUE(a.log == b.log);
+  }
+
+  // Modifications queued while the back buffer is built follow their
+  // components into the new front buffer. The reference queues the same
+  // modifications before its renormalize.
+  for (uint64_t id = 1; id <= maxID; id += 3)
+  {
+    buffered.addComponent(id, CompPosition(glm::vec3(-1.0f, 0.0f, 0.0f)));
+    reference.addComponent(id, CompPosition(glm::vec3(-1.0f, 0.0f, 0.0f)));
+  }
+  buffered.removeEntity(4);
+  reference.removeEntity(4);
+
+  buffered.prepareRenormalize(true);
+  buffered.buildBackBuffers();
+  MoveSystem move;
+  move.walkComponents(buffered);
+  buffered.swapBuffers();
+
+  move.walkComponents(reference);
+  reference.renormalize(true);
+
+  buffered.renormalize(true);
+  reference.renormalize(true);
+
+  RecordSystem a, b;
+  a.walkComponents(buffered);
+  b.walkComponents(reference);
+  EXPECT_TRUE(a.log == b.log);
+}
+
+
+// Core creating the gameplay container explicitly, without the trait.
+class BufferedCore : public es::ESCore
+{
+public:
+  void addBufferedGameplay(uint64_t entityID, const CompGameplay& gp)
+  {
+    coreAddComponent<CompGameplay, es::DoubleBufferedComponentContainer<CompGameplay>>(entityID, gp);
+  }
+};
+
+TEST(EntitySystem, TestDoubleBufferedCoreAdd)
+{
+  // Plain ESCore adds are queued for the back buffer, not lost at the swap.
+  BufferedCore core;
+  core.addBufferedGameplay(1, CompGameplay(1, 1));
+  core.addComponent(2, CompGameplay(2, 2));
+  core.prepareRenormalize(true);
+  core.buildBackBuffers();
+  core.swapBuffers();
+
+  core.addComponent(3, CompGameplay(3, 3));
+  core.prepareRenormalize(true);
+  core.buildBackBuffers();
+  core.swapBuffers();
+
+  es::ComponentContainer<CompGameplay>* gameplay = dynamic_cast<es::ComponentContainer<CompGameplay>*>(
+      core.getComponentContainer(es::getESTypeID<CompGameplay>()));
+  ASSERT_EQ(3, gameplay->getNumComponents());
+  EXPECT_EQ(3, gameplay->getComponentArray()[2].get().health);
+}
+
+TEST(EntitySystem, TestDoubleBufferedNewContainer)
+{
+  es::ESCore core;
+  for (uint64_t id = 1; id <= 100; ++id)
+    core.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id), 0.0f, 0.0f)));
+  core.renormalize(true);
+
+  es::BaseComponentContainer* positions = core.getComponentContainer(es::getESTypeID<CompPosition>());
+
+  // Nothing queued, nothing to build.
+  core.prepareRenormalize(true);
+  EXPECT_FALSE(positions->isBuildPending());
+  core.buildBackBuffers();
+  core.swapBuffers();
+
+  // Containers created while the back buffers are built are picked up by
+  // the next prepareRenormalize.
+  for (uint64_t id = 101; id <= 200; ++id)
+    core.addComponent(id, CompPosition(glm::vec3(static_cast<float>(id), 0.0f, 0.0f)));
+  core.prepareRenormalize(true);
+  EXPECT_TRUE(positions->isBuildPending());
+
+  std::thread builder([&core]() {core.buildBackBuffers();});
+  for (uint64_t id = 1; id <= 100; ++id)
+    core.addComponent(id, CompTag(static_cast<int>(id)));
+  builder.join();
+  core.swapBuffers();
+  EXPECT_EQ(200, positions->getNumComponents());
+
+  core.prepareRenormalize(true);
+  core.buildBackBuffers();
+  core.swapBuffers();
+  EXPECT_EQ(100, core.getComponentContainer(es::getESTypeID<CompTag>())->getNumComponents());
+}
+
+}
@@ -0,0 +1,207 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/DuplicateComponent.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  bool operator==(const CompGameplay& other) const
+  {
+    return health == other.health && armor == other.armor;
+  }
+
+  int health;
+  int armor;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentHash<CompGameplay>
+{
+  // Deliberately weak, so hash collisions are exercised.
+  size_t operator()(const CompGameplay& gp) const {return static_cast<size_t>(gp.health % 4);}
+};
+}
+
+namespace {
+
+// Core storing gameplay components in a duplicate aware container.
+class IndexedCore : public es::ESCore
+{
+public:
+  void addIndexedGameplay(uint64_t entityID, const CompGameplay& gp)
+  {
+    coreAddComponent<CompGameplay, es::DuplicateAwareComponentContainer<CompGameplay>>(entityID, gp);
+  }
+
+  es::DuplicateAwareComponentContainer<CompGameplay>* getGameplayContainer()
+  {
+    return dynamic_cast<es::DuplicateAwareComponentContainer<CompGameplay>*>(
+        getComponentContainer(es::getESTypeID<CompGameplay>()));
+  }
+};
+
+class CountSystem : public es::GenericSystem<true, CompGameplay>
+{
+public:
+  std::map<uint64_t, size_t> counts;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    counts[entityID] = gp.size();
+  }
+};
+
+TEST(EntitySystem, TestDuplicateIndex)
+{
+  std::shared_ptr<IndexedCore> core(new IndexedCore());
+
+  core->addIndexedGameplay(1, CompGameplay(10, 1));
+  core->addIndexedGameplay(1, CompGameplay(14, 1));
+  core->addIndexedGameplay(2, CompGameplay(10, 1));
+
+  // Pending additions are found before renormalize.
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 1, CompGameplay(14, 1)));
+  EXPECT_FALSE(es::hasDuplicateComponent(*core, 1, CompGameplay(18, 1)));
+  EXPECT_FALSE(es::hasDuplicateComponent(*core, 3, CompGameplay(10, 1)));
+
+  core->renormalize();
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 1, CompGameplay(10, 1)));
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 1, CompGameplay(14, 1)));
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 2, CompGameplay(10, 1)));
+  EXPECT_FALSE(es::hasDuplicateComponent(*core, 2, CompGameplay(14, 1)));
+  EXPECT_FALSE(es::hasDuplicateComponent(*core, 1, CompGameplay(10, 2)));
+
+  // Modifications and removals are reflected after renormalize.
+  es::DuplicateAwareComponentContainer<CompGameplay>* cont = core->getGameplayContainer();
+  ASSERT_NE(nullptr, cont);
+  int index = cont->getComponentItemIndexWithSequence(2);
+  cont->modifyIndex(CompGameplay(30, 3), static_cast<size_t>(index), 0);
+  core->removeFirstComponentT<CompGameplay>(1);
+  core->renormalize(true);
+
+  EXPECT_FALSE(es::hasDuplicateComponent(*core, 1, CompGameplay(10, 1)));
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 1, CompGameplay(14, 1)));
+  EXPECT_FALSE(es::hasDuplicateComponent(*core, 2, CompGameplay(10, 1)));
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 2, CompGameplay(30, 3)));
+
+  // Duplicates are dropped at renormalize when requested.
+  cont->setDropDuplicates(true);
+  core->addIndexedGameplay(1, CompGameplay(14, 1));
+  core->addIndexedGameplay(1, CompGameplay(15, 1));
+  core->addIndexedGameplay(1, CompGameplay(15, 1));
+  core->addIndexedGameplay(4, CompGameplay(15, 1));
+  core->renormalize();
+
+  CountSystem sys;
+  sys.walkComponents(*core);
+  EXPECT_EQ(2, sys.counts[1]);
+  EXPECT_EQ(1, sys.counts[2]);
+  EXPECT_EQ(1, sys.counts[4]);
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 1, CompGameplay(15, 1)));
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 4, CompGameplay(15, 1)));
+}
+
+TEST(EntitySystem, TestDuplicateIndexCoreAdd)
+{
+  // Once the container exists, plain ESCore adds go through its index too.
+  std::shared_ptr<IndexedCore> core(new IndexedCore());
+  core->addIndexedGameplay(1, CompGameplay(10, 1));
+  core->addComponent(1, CompGameplay(5, 1));
+  core->addComponent(2, CompGameplay(5, 1));
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 1, CompGameplay(5, 1)));
+
+  core->renormalize(true);
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 1, CompGameplay(5, 1)));
+  EXPECT_TRUE(es::hasDuplicateComponent(*core, 2, CompGameplay(5, 1)));
+  EXPECT_FALSE(es::hasDuplicateComponent(*core, 2, CompGameplay(10, 1)));
+
+  core->getGameplayContainer()->setDropDuplicates(true);
+  core->addComponent(2, CompGameplay(5, 1));
+  core->renormalize(true);
+  CountSystem sys;
+  sys.walkComponents(*core);
+  EXPECT_EQ(1, sys.counts[2]);
+}
+
+TEST(EntitySystem, TestDuplicateIndexRandom)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::uniform_int_distribution<int> entity(1, 50);
+  std::uniform_int_distribution<int> value(0, 9);
+
+  std::shared_ptr<IndexedCore> indexed(new IndexedCore());
+  std::shared_ptr<es::ESCore> plain(new es::ESCore());
+
+  for (int frame = 0; frame < 5; ++frame)
+  {
+    for (int i = 0; i < 100; ++i)
+    {
+      uint64_t id = static_cast<uint64_t>(entity(rng));
+      CompGameplay gp(value(rng), value(rng) % 2);
+      indexed->addIndexedGameplay(id, gp);
+      plain->addComponent(id, gp);
+    }
+    for (int i = 0; i < 10; ++i)
+    {
+      uint64_t id = static_cast<uint64_t>(entity(rng));
+      indexed->removeFirstComponentT<CompGameplay>(id);
+      plain->removeFirstComponentT<CompGameplay>(id);
+    }
+
+    // Bulk additions go through the same index.
+    std::vector<std::pair<uint64_t, CompGameplay>> bulk;
+    for (int i = 0; i < 20; ++i)
+      bulk.push_back(std::make_pair(static_cast<uint64_t>(entity(rng)), CompGameplay(value(rng), value(rng) % 2)));
+    indexed->getGameplayContainer()->addComponents(bulk.data(), bulk.size());
+    es::ComponentContainer<CompGameplay>* plainCont = dynamic_cast<es::ComponentContainer<CompGameplay>*>(
+        plain->getComponentContainer(es::getESTypeID<CompGameplay>()));
+    plainCont->addComponents(bulk.data(), bulk.size());
+
+    // Both containers hold the same components in the same order.
+    size_t numSorted = static_cast<size_t>(plainCont->getNumComponents());
+    for (int i = 0; i < 5 && numSorted > 0; ++i)
+    {
+      size_t index = static_cast<size_t>(rng() % numSorted);
+      CompGameplay gp(value(rng), value(rng) % 2);
+      indexed->getGameplayContainer()->modifyIndex(gp, index, 0);
+      plainCont->modifyIndex(gp, index, 0);
+    }
+    indexed->renormalize(true);
+    plain->renormalize(true);
+
+    for (uint64_t id = 1; id <= 50; ++id)
+    {
+      for (int h = 0; h < 10; ++h)
+      {
+        for (int a = 0; a < 2; ++a)
+        {
+          EXPECT_EQ(es::hasDuplicateComponent(*plain, id, CompGameplay(h, a)),
+                    es::hasDuplicateComponent(*indexed, id, CompGameplay(h, a)));
+        }
+      }
+    }
+  }
+}
+
+}
+
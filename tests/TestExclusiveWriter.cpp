@@ -0,0 +1,237 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompVelocity
+{
+  CompVelocity() {}
+  CompVelocity(const glm::vec3& vel) {velocity = vel;}
+
+  glm::vec3 velocity;
+};
+
+struct CompBufferedPosition
+{
+  CompBufferedPosition() {}
+  CompBufferedPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentContainerType<CompBufferedPosition>
+{typedef DoubleBufferedComponentContainer<CompBufferedPosition> type;};
+}
+
+namespace {
+
+// Sole writer of CompPosition: integrates in place.
+class IntegrateSystem : public es::GenericSystem<false, CompVelocity, CompPosition>
+{
+public:
+  bool isComponentWritten(uint64_t templateID) override
+  {
+    return es::WrittenComponents<CompPosition>(templateID);
+  }
+
+  void execute(es::ESCoreBase&, uint64_t,
+               const CompVelocity* vel, const CompPosition* pos) override
+  {
+    CompPosition* p = write(pos);
+    p->position = p->position + vel->velocity;
+  }
+};
+
+// Same integration through the modification queue, as reference.
+class ModifySystem : public es::GenericSystem<true, CompVelocity, CompPosition>
+{
+public:
+  void groupExecute(es::ESCoreBase&, uint64_t,
+                    const es::ComponentGroup<CompVelocity>& vel,
+                    const es::ComponentGroup<CompPosition>& pos) override
+  {
+    for (size_t i = 0; i < pos.size(); ++i)
+      pos.modify(CompPosition(pos[i].position + vel.front().velocity), i);
+  }
+};
+
+// Group version, also claims CompPosition.
+class ScaleSystem : public es::GenericSystem<true, CompPosition>
+{
+public:
+  bool isComponentWritten(uint64_t templateID) override
+  {
+    return es::WrittenComponents<CompPosition>(templateID);
+  }
+
+  void groupExecute(es::ESCoreBase&, uint64_t,
+                    const es::ComponentGroup<CompPosition>& pos) override
+  {
+    for (size_t i = 0; i < pos.size(); ++i)
+      write(pos, i).position = pos[i].position * 2.0f;
+  }
+};
+
+// Writes without declaring it.
+class UndeclaredSystem : public es::GenericSystem<false, CompPosition>
+{
+public:
+  void execute(es::ESCoreBase&, uint64_t, const CompPosition* pos) override
+  {
+    write(pos)->position.x = 0.0f;
+  }
+};
+
+class BufferedSystem : public es::GenericSystem<false, CompBufferedPosition>
+{
+public:
+  bool isComponentWritten(uint64_t templateID) override
+  {
+    return es::WrittenComponents<CompBufferedPosition>(templateID);
+  }
+
+  void execute(es::ESCoreBase&, uint64_t, const CompBufferedPosition* pos) override
+  {
+    write(pos)->position.y += 1.0f;
+  }
+};
+
+es::ComponentContainer<CompPosition>* positions(es::ESCore& core)
+{
+  return dynamic_cast<es::ComponentContainer<CompPosition>*>(
+      core.getComponentContainer(es::getESTypeID<CompPosition>()));
+}
+
+TEST(EntitySystem, TestExclusiveWriter)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+  es::ESCore inPlace;
+  es::ESCore queued;
+  const uint64_t maxID = 1000;
+  for (uint64_t id = 1; id <= maxID; ++id)
+  {
+    glm::vec3 pos(dist(rng), dist(rng), dist(rng));
+    inPlace.addComponent(id, CompPosition(pos));
+    queued.addComponent(id, CompPosition(pos));
+    // Some entities have several positions.
+    if (id % 5 == 0)
+    {
+      inPlace.addComponent(id, CompPosition(pos * -1.0f));
+      queued.addComponent(id, CompPosition(pos * -1.0f));
+    }
+    if (id % 3 != 0)
+    {
+      glm::vec3 vel(dist(rng), dist(rng), dist(rng));
+      inPlace.addComponent(id, CompVelocity(vel));
+      queued.addComponent(id, CompVelocity(vel));
+    }
+  }
+  inPlace.renormalize(true);
+  queued.renormalize(true);
+
+  IntegrateSystem integrate;
+  ModifySystem modify;
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    integrate.walkComponents(inPlace);
+    modify.walkComponents(queued);
+
+    // Nothing was queued, and the writes are visible before renormalize.
+    EXPECT_EQ(0, positions(inPlace)->getNumPendingModifications());
+    EXPECT_EQ(&integrate, inPlace.getWriter(es::getESTypeID<CompPosition>()));
+    queued.renormalize(true);
+    ASSERT_EQ(positions(queued)->getNumComponents(), positions(inPlace)->getNumComponents());
+    for (uint64_t i = 0; i < positions(queued)->getNumComponents(); ++i)
+    {
+      ASSERT_EQ(positions(queued)->getComponentArray()[i].sequence, positions(inPlace)->getComponentArray()[i].sequence);
+      ASSERT_TRUE(positions(queued)->getComponentArray()[i].get().position
+                  == positions(inPlace)->getComponentArray()[i].get().position);
+    }
+
+    // Walking the same writer again in a frame is fine.
+    integrate.walkEntity(inPlace, 1);
+    integrate.walkEntity(queued, 1);
+    EXPECT_EQ(&integrate, queued.getWriter(es::getESTypeID<CompPosition>()));
+    queued.renormalize(true);
+
+    // A second writer in the same frame is not.
+    ScaleSystem scale;
+    EXPECT_THROW(scale.walkComponents(inPlace), std::runtime_error);
+    inPlace.renormalize(true);
+    EXPECT_EQ(nullptr, inPlace.getWriter(es::getESTypeID<CompPosition>()));
+  }
+
+  // The next frame, it may claim the components.
+  ScaleSystem scale;
+  scale.walkComponents(inPlace);
+  EXPECT_EQ(&scale, inPlace.getWriter(es::getESTypeID<CompPosition>()));
+  EXPECT_THROW(integrate.walkComponents(inPlace), std::runtime_error);
+  inPlace.renormalize(true);
+
+  // Modifications queued by readers still apply over in place writes.
+  const CompPosition* first = &positions(inPlace)->getComponentArray()[0].get();
+  positions(inPlace)->modifyIndex(CompPosition(glm::vec3(42.0f)), 0, 1);
+  scale.walkComponents(inPlace);
+  inPlace.renormalize(true);
+  EXPECT_EQ(42.0f, first->position.x);
+
+  UndeclaredSystem undeclared;
+  EXPECT_THROW(undeclared.walkComponents(inPlace), std::runtime_error);
+}
+
+TEST(EntitySystem, TestExclusiveWriterDoubleBuffered)
+{
+  es::ESCore core;
+  for (uint64_t id = 1; id <= 100; ++id)
+    core.addComponent(id, CompBufferedPosition(glm::vec3(static_cast<float>(id))));
+  core.renormalize(true);
+
+  BufferedSystem system;
+  system.walkComponents(core);
+  core.renormalize(true);
+
+  // While the back buffer is built from the front buffer, writes would be
+  // lost at swapBuffers.
+  core.addComponent(101, CompBufferedPosition(glm::vec3(101.0f)));
+  core.prepareRenormalize(true);
+  EXPECT_THROW(system.walkComponents(core), std::runtime_error);
+  core.buildBackBuffers();
+  core.swapBuffers();
+
+  system.walkComponents(core);
+  core.renormalize(true);
+
+  es::ComponentContainer<CompBufferedPosition>* container = dynamic_cast<es::ComponentContainer<CompBufferedPosition>*>(
+      core.getComponentContainer(es::getESTypeID<CompBufferedPosition>()));
+  ASSERT_NE(nullptr, container);
+  ASSERT_EQ(101, container->getNumComponents());
+  EXPECT_EQ(3.0f, container->getComponent(1).first->position.y);
+  EXPECT_EQ(102.0f, container->getComponent(101).first->position.y);
+}
+
+}
+
@@ -0,0 +1,249 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/IncrementalComponentContainer.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <set>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+// 256 bytes, most of which a system does not touch.
+struct CompAIState
+{
+  CompAIState() : alertness(0.0f), target(0)
+  {
+    for (int i = 0; i < 62; ++i)
+      memory[i] = 0.0f;
+  }
+  CompAIState(int seed) : alertness(static_cast<float>(seed)), target(seed)
+  {
+    for (int i = 0; i < 62; ++i)
+      memory[i] = static_cast<float>(seed + i);
+  }
+
+  bool operator==(const CompAIState& other) const
+  {
+    if (alertness != other.alertness || target != other.target)
+      return false;
+    for (int i = 0; i < 62; ++i)
+      if (memory[i] != other.memory[i])
+        return false;
+    return true;
+  }
+
+  float alertness;
+  int   target;
+  float memory[62];
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+template <typename Container>
+const CompAIState& at(Container& c, uint64_t sequence)
+{
+  return *c.getComponent(sequence).first;
+}
+
+template <typename Container>
+size_t indexOf(Container& c, uint64_t sequence)
+{
+  return c.getComponent(sequence).second;
+}
+
+TEST(EntitySystem, TestFieldPatches)
+{
+  es::ComponentContainer<CompAIState> c;
+  for (uint64_t id = 1; id <= 4; ++id)
+    c.addComponent(id, CompAIState(static_cast<int>(id)));
+  c.renormalize(true);
+
+  // A field patch only changes its field.
+  c.modifyFieldIndex(&CompAIState::alertness, 10, indexOf(c, 1), 1);
+  c.modifyFieldIndex(&CompAIState::target, 20, indexOf(c, 1), 1);
+  c.renormalize(true);
+  CompAIState expected(1);
+  expected.alertness = 10.0f;
+  expected.target = 20;
+  EXPECT_TRUE(at(c, 1) == expected);
+
+  // Same field: highest priority wins, the earliest on ties.
+  c.modifyFieldIndex(&CompAIState::target, 1, indexOf(c, 2), 1);
+  c.modifyFieldIndex(&CompAIState::target, 2, indexOf(c, 2), 3);
+  c.modifyFieldIndex(&CompAIState::target, 3, indexOf(c, 2), 3);
+  c.modifyFieldIndex(&CompAIState::target, 4, indexOf(c, 2), 2);
+  c.renormalize(true);
+  EXPECT_EQ(2, at(c, 2).target);
+
+  // A whole-component modification of higher priority overrides patches,
+  // patches of the same or higher priority apply on top.
+  c.modifyIndex(CompAIState(100), indexOf(c, 3), 2);
+  c.modifyFieldIndex(&CompAIState::alertness, -1.0f, indexOf(c, 3), 1);
+  c.modifyFieldIndex(&CompAIState::target, -2, indexOf(c, 3), 2);
+  c.renormalize(true);
+  EXPECT_EQ(100.0f, at(c, 3).alertness);
+  EXPECT_EQ(-2, at(c, 3).target);
+  EXPECT_EQ(101.0f, at(c, 3).memory[1]);
+
+  // Functors run after field patches, in order of increasing priority.
+  c.modifyIndexWith([](CompAIState& s) {s.target = s.target * 10;}, indexOf(c, 4), 5);
+  c.modifyIndexWith([](CompAIState& s) {s.target = s.target + 3;}, indexOf(c, 4), 1);
+  c.modifyFieldIndex(&CompAIState::target, 7, indexOf(c, 4), 1);
+  std::shared_ptr<int> captured = std::make_shared<int>(42);
+  c.modifyIndexWith([captured](CompAIState& s) {s.memory[0] = static_cast<float>(*captured);}, indexOf(c, 4), 1);
+  EXPECT_EQ(2, captured.use_count());
+  c.renormalize(true);
+  EXPECT_EQ(100, at(c, 4).target);
+  EXPECT_EQ(42.0f, at(c, 4).memory[0]);
+  EXPECT_EQ(1, captured.use_count());
+
+  // Everything was released back to the arena.
+  EXPECT_EQ(0, es::FrameArena::local().getNumLiveAllocations());
+}
+
+// Applies the same random changes through patches and through whole
+// component modifications, and compares.
+template <typename Container>
+void checkPatchesMatchModifications()
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  Container patched;
+  Container reference;
+  const uint64_t maxID = 500;
+  for (uint64_t id = 1; id <= maxID; ++id)
+  {
+    patched.addComponent(id, CompAIState(static_cast<int>(id)));
+    reference.addComponent(id, CompAIState(static_cast<int>(id)));
+  }
+  patched.renormalize(true);
+  reference.renormalize(true);
+
+  std::uniform_int_distribution<uint64_t> entity(1, maxID);
+  for (int frame = 0; frame < 20; ++frame)
+  {
+    std::set<uint64_t> changedIDs;
+    for (int i = 0; i < 100; ++i)
+    {
+      // Each component is changed at most once per frame.
+      uint64_t id = entity(rng);
+      if (!changedIDs.insert(id).second)
+        continue;
+
+      std::pair<const CompAIState*, size_t> p = patched.getComponent(id);
+      std::pair<const CompAIState*, size_t> r = reference.getComponent(id);
+      if (p.first == nullptr)
+      {
+        ASSERT_EQ(nullptr, r.first);
+        continue;
+      }
+
+      CompAIState changed = *r.first;
+      changed.alertness += 1.0f;
+      changed.memory[i % 62] = static_cast<float>(frame);
+      patched.modifyFieldIndex(&CompAIState::alertness, changed.alertness, p.second, 1);
+      int slot = i % 62;
+      float value = static_cast<float>(frame);
+      patched.modifyIndexWith([slot, value](CompAIState& s) {s.memory[slot] = value;}, p.second, 1);
+      reference.modifyIndex(changed, r.second, 1);
+    }
+
+    for (int i = 0; i < 20; ++i)
+    {
+      uint64_t id = entity(rng);
+      patched.removeSequence(id);
+      reference.removeSequence(id);
+      id = entity(rng);
+      patched.addComponent(id, CompAIState(frame));
+      reference.addComponent(id, CompAIState(frame));
+    }
+
+    patched.renormalize(true);
+    reference.renormalize(true);
+
+    ASSERT_EQ(reference.getNumComponents(), patched.getNumComponents());
+    for (uint64_t i = 0; i < reference.getNumComponents(); ++i)
+    {
+      ASSERT_EQ(reference.getComponentArray()[i].sequence, patched.getComponentArray()[i].sequence);
+      ASSERT_TRUE(reference.getComponentArray()[i].get() == patched.getComponentArray()[i].get());
+    }
+  }
+}
+
+TEST(EntitySystem, TestFieldPatchesDerived)
+{
+  checkPatchesMatchModifications<es::ComponentContainer<CompAIState>>();
+  checkPatchesMatchModifications<es::IncrementalComponentContainer<CompAIState>>();
+  checkPatchesMatchModifications<es::DoubleBufferedComponentContainer<CompAIState>>();
+}
+
+TEST(EntitySystem, TestFieldPatchesGroup)
+{
+  class PatchSystem : public es::GenericSystem<true, CompAIState, CompGameplay>
+  {
+  public:
+    void groupExecute(es::ESCoreBase&, uint64_t,
+                      const es::ComponentGroup<CompAIState>& ai,
+                      const es::ComponentGroup<CompGameplay>& gp) override
+    {
+      ai.modifyField(&CompAIState::target, gp.front().health);
+      ai.modifyWith([](CompAIState& s) {s.alertness *= 2.0f;});
+    }
+  };
+
+  es::ESCore core;
+  for (uint64_t id = 1; id <= 100; ++id)
+  {
+    core.addComponent(id, CompAIState(static_cast<int>(id)));
+    if (id % 2 == 0)
+      core.addComponent(id, CompGameplay(static_cast<int>(id) * 3, 0));
+  }
+  core.renormalize(true);
+
+  PatchSystem system;
+  system.walkComponents(core);
+  core.renormalize(true);
+
+  es::ComponentContainer<CompAIState>* container = dynamic_cast<es::ComponentContainer<CompAIState>*>(
+      core.getComponentContainer(es::getESTypeID<CompAIState>()));
+  ASSERT_NE(nullptr, container);
+  for (uint64_t id = 1; id <= 100; ++id)
+  {
+    const CompAIState* s = container->getComponent(id).first;
+    ASSERT_NE(nullptr, s);
+    if (id % 2 == 0)
+    {
+      EXPECT_EQ(static_cast<int>(id) * 3, s->target);
+      EXPECT_EQ(static_cast<float>(id) * 2.0f, s->alertness);
+    }
+    else
+    {
+      EXPECT_EQ(static_cast<int>(id), s->target);
+      EXPECT_EQ(static_cast<float>(id), s->alertness);
+    }
+    EXPECT_EQ(static_cast<float>(id + 61), s->memory[61]);
+  }
+}
+
+}
+
@@ -0,0 +1,351 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/IncrementalComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+struct CompTracked
+{
+  CompTracked() : value(0) {}
+  CompTracked(int valueIn) : value(valueIn) {}
+
+  int value;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentContainerType<CompPosition>
+{typedef IncrementalComponentContainer<CompPosition> type;};
+template <> struct ComponentContainerType<CompTracked>
+{typedef IncrementalComponentContainer<CompTracked> type;};
+template <> struct TrackComponentChanges<CompTracked> : std::true_type {};
+}
+
+namespace {
+
+// (entity, position.x, health)
+typedef std::tuple<uint64_t, float, int> Entry;
+
+class RecordSystem : public es::GenericSystem<false, CompPosition, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompPosition* pos, const CompGameplay* gp) override
+  {
+    log.push_back(std::make_tuple(entityID, pos->position.x, gp->health));
+  }
+};
+
+void applyChurn(es::ESCore& core, std::mt19937& rng, uint64_t maxID, int numAdditions)
+{
+  std::uniform_int_distribution<uint64_t> entity(1, maxID);
+  for (int i = 0; i < numAdditions; ++i)
+  {
+    uint64_t id = entity(rng);
+    core.addComponent(id, CompPosition(glm::vec3(static_cast<float>(i), 0.0f, 0.0f)));
+  }
+}
+
+es::IncrementalComponentContainer<CompPosition>* getPositions(es::ESCore& core)
+{
+  return dynamic_cast<es::IncrementalComponentContainer<CompPosition>*>(
+      core.getComponentContainer(es::getESTypeID<CompPosition>()));
+}
+
+void expectSameWalk(es::ESCore& a, es::ESCore& b)
+{
+  RecordSystem sysA, sysB;
+  sysA.walkComponents(a);
+  sysB.walkComponents(b);
+  EXPECT_FALSE(sysA.log.empty());
+  EXPECT_TRUE(sysA.log == sysB.log);
+}
+
+TEST(EntitySystem, TestIncrementalRenormalize)
+{
+  std::mt19937 rngA(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::mt19937 rngB(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore incremental;
+  es::ESCore reference;
+  const uint64_t maxID = 200;
+  for (uint64_t id = 1; id <= maxID; ++id)
+  {
+    incremental.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+    reference.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+  }
+
+  // Synchronous by default.
+  for (int frame = 0; frame < 3; ++frame)
+  {
+    applyChurn(incremental, rngA, maxID, 100);
+    applyChurn(reference, rngB, maxID, 100);
+    incremental.removeEntity(frame + 1);
+    reference.removeEntity(frame + 1);
+    incremental.renormalize(true);
+    reference.renormalize(true);
+
+    ASSERT_NE(nullptr, getPositions(incremental));
+    EXPECT_FALSE(getPositions(incremental)->isMergeInProgress());
+    expectSameWalk(incremental, reference);
+  }
+
+  es::IncrementalComponentContainer<CompPosition>* positions = getPositions(incremental);
+  positions->setTimeBudget(std::chrono::microseconds(1));
+
+  // A large batch of additions is merged over several renormalizes, and
+  // stays invisible until the merge completes.
+  RecordSystem before;
+  before.walkComponents(incremental);
+
+  applyChurn(incremental, rngA, maxID, 30000);
+  applyChurn(reference, rngB, maxID, 30000);
+  incremental.renormalize(true);
+  reference.renormalize(true);
+
+  EXPECT_TRUE(positions->isMergeInProgress());
+  EXPECT_EQ(30000, positions->getNumPendingComponents());
+  EXPECT_LT(positions->getMergeProgress(), 1.0);
+  EXPECT_GT(positions->getRemainingMergeSteps(), 0);
+  EXPECT_TRUE(positions->isDirty());
+  {
+    RecordSystem during;
+    during.walkComponents(incremental);
+    EXPECT_TRUE(during.log == before.log);
+  }
+
+  // Removing an entity also drops its pending additions.
+  incremental.removeEntity(10);
+  reference.removeEntity(10);
+
+  int renormalizes = 0;
+  double progress = positions->getMergeProgress();
+  do
+  {
+    incremental.renormalize(true);
+    EXPECT_GE(positions->getMergeProgress(), progress);
+    progress = positions->getMergeProgress();
+    ++renormalizes;
+  } while (positions->isMergeInProgress() && renormalizes < 100000);
+
+  EXPECT_FALSE(positions->isMergeInProgress());
+  EXPECT_EQ(0, positions->getNumPendingComponents());
+  EXPECT_GT(renormalizes, 1);
+  reference.renormalize(true);
+  expectSameWalk(incremental, reference);
+
+  // Other removals apply to the visible components without completing the
+  // merge. Additions are sorted in after existing components, so removing
+  // the first component of an entity that has one matches synchronous
+  // renormalization.
+  applyChurn(incremental, rngA, maxID, 20000);
+  applyChurn(reference, rngB, maxID, 20000);
+  incremental.renormalize(true);
+  reference.renormalize(true);
+  EXPECT_TRUE(positions->isMergeInProgress());
+
+  for (uint64_t id = 20; id < 30; ++id)
+  {
+    ASSERT_GT(positions->es::ComponentContainer<CompPosition>::getNumComponentsWithSequence(id), 0);
+    incremental.removeFirstComponentT<CompPosition>(id);
+    reference.removeFirstComponentT<CompPosition>(id);
+  }
+  size_t pending = positions->getNumPendingComponents();
+  uint64_t visible = positions->getNumComponents();
+  incremental.renormalize(true);
+  reference.renormalize(true);
+  EXPECT_TRUE(positions->isMergeInProgress());
+  EXPECT_EQ(pending, positions->getNumPendingComponents());
+  EXPECT_EQ(visible - 10, positions->getNumComponents());
+  positions->finishMerge();
+  expectSameWalk(incremental, reference);
+
+  // finishMerge completes pending work immediately.
+  applyChurn(incremental, rngA, maxID, 20000);
+  applyChurn(reference, rngB, maxID, 20000);
+  incremental.renormalize(true);
+  positions->finishMerge();
+  reference.renormalize(true);
+  EXPECT_FALSE(positions->isMergeInProgress());
+  expectSameWalk(incremental, reference);
+}
+
+
+TEST(EntitySystem, TestIncrementalBoundedSteps)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore incremental;
+  es::ESCore reference;
+  const uint64_t maxID = 60000;
+  for (uint64_t id = 1; id <= maxID; ++id)
+  {
+    CompPosition pos(glm::vec3(static_cast<float>(id), 0.0f, 0.0f));
+    incremental.addComponent(id, pos);
+    reference.addComponent(id, pos);
+    incremental.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+    reference.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+  }
+  incremental.renormalize(true);
+  reference.renormalize(true);
+
+  es::IncrementalComponentContainer<CompPosition>* positions = getPositions(incremental);
+  es::IncrementalComponentContainer<CompPosition>* refPositions = getPositions(reference);
+  positions->setTimeBudget(std::chrono::microseconds(1));
+
+  // A stream-in larger than the visible components, with removals and
+  // modifications of visible components in every frame while it merges.
+  std::uniform_int_distribution<uint64_t> entity(1, maxID);
+  for (int i = 0; i < 150000; ++i)
+  {
+    uint64_t id = entity(rng);
+    CompPosition pos(glm::vec3(static_cast<float>(i), 1.0f, 0.0f));
+    incremental.addComponent(id, pos);
+    reference.addComponent(id, pos);
+  }
+
+  int renormalizes = 0;
+  do
+  {
+    for (int i = 0; i < 20; ++i)
+    {
+      uint64_t id = entity(rng);
+      if (i % 4 == 0)
+      {
+        incremental.removeEntity(id);
+        reference.removeEntity(id);
+      }
+      else if (i % 4 == 1)
+      {
+        if (positions->es::ComponentContainer<CompPosition>::getNumComponentsWithSequence(id) == 0)
+          continue;
+        incremental.removeFirstComponentT<CompPosition>(id);
+        reference.removeFirstComponentT<CompPosition>(id);
+      }
+      else
+      {
+        // Added components are sorted in after existing ones, so the first
+        // visible component is the first one in the reference as well.
+        int index = positions->getComponentItemIndexWithSequence(id);
+        if (index < 0)
+          continue;
+        CompPosition pos(glm::vec3(static_cast<float>(i), 2.0f, 0.0f));
+        positions->modifyIndex(pos, static_cast<size_t>(index), 0);
+        refPositions->modifyIndex(pos, static_cast<size_t>(refPositions->getComponentItemIndexWithSequence(id)), 0);
+      }
+    }
+    incremental.renormalize(true);
+    reference.renormalize(true);
+    ++renormalizes;
+  } while (positions->isMergeInProgress() && renormalizes < 100000);
+
+  EXPECT_FALSE(positions->isMergeInProgress());
+  EXPECT_GT(renormalizes, 10);
+  EXPECT_GT(positions->getLargestStepSize(), 0);
+  EXPECT_LE(positions->getLargestStepSize(), es::IncrementalComponentContainer<CompPosition>::RunSize);
+  EXPECT_EQ(refPositions->getNumComponents(), positions->getNumComponents());
+  expectSameWalk(incremental, reference);
+}
+
+TEST(EntitySystem, TestIncrementalChangeVersions)
+{
+  // A system that last looked while the batch was merging still sees every
+  // added component as changed once the batch is visible.
+  es::ESCore core;
+  for (uint64_t id = 1; id <= 100; ++id)
+    core.addComponent(id, CompTracked(static_cast<int>(id)));
+  core.renormalize(true);
+
+  es::IncrementalComponentContainer<CompTracked>* tracked =
+      dynamic_cast<es::IncrementalComponentContainer<CompTracked>*>(
+          core.getComponentContainer(es::getESTypeID<CompTracked>()));
+  ASSERT_NE(nullptr, tracked);
+  tracked->setTimeBudget(std::chrono::microseconds(1));
+
+  const uint64_t numAdded = 40000;
+  for (uint64_t id = 1000; id < 1000 + numAdded; ++id)
+    core.addComponent(id, CompTracked(static_cast<int>(id)));
+
+  uint64_t seen = 0;
+  int renormalizes = 0;
+  while (tracked->isMergeInProgress() && renormalizes < 100000)
+  {
+    core.renormalize(true);
+    if (tracked->isMergeInProgress())
+      seen = tracked->getChangeVersion();
+    ++renormalizes;
+  }
+  ASSERT_GT(seen, 0);
+
+  std::vector<uint64_t> changed;
+  tracked->collectChangedSequences(seen, changed);
+  EXPECT_EQ(numAdded, changed.size());
+  EXPECT_EQ(1000, changed.front());
+
+  changed.clear();
+  tracked->collectChangedSequences(tracked->getChangeVersion(), changed);
+  EXPECT_TRUE(changed.empty());
+}
+
+// Core creating the gameplay container explicitly, without the trait.
+class IncrementalCore : public es::ESCore
+{
+public:
+  void addIncrementalGameplay(uint64_t entityID, const CompGameplay& gp)
+  {
+    coreAddComponent<CompGameplay, es::IncrementalComponentContainer<CompGameplay>>(entityID, gp);
+  }
+};
+
+TEST(EntitySystem, TestIncrementalCoreAdd)
+{
+  // Plain ESCore adds are staged like those through the container type.
+  IncrementalCore core;
+  core.addIncrementalGameplay(5, CompGameplay(5, 0));
+  for (uint64_t id = 100; id > 5; id -= 5)
+    core.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+  core.renormalize(true);
+
+  es::ComponentContainer<CompGameplay>* gameplay = dynamic_cast<es::ComponentContainer<CompGameplay>*>(
+      core.getComponentContainer(es::getESTypeID<CompGameplay>()));
+  ASSERT_EQ(20, gameplay->getNumComponents());
+  for (uint64_t i = 0; i < 20; ++i)
+    ASSERT_EQ(5 * (i + 1), gameplay->getComponentArray()[i].sequence);
+}
+
+}
+
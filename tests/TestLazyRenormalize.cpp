@@ -0,0 +1,215 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+struct CompCamera
+{
+  CompCamera() : zoom(0.0f) {}
+  CompCamera(float z) : zoom(z) {}
+
+  float zoom;
+};
+
+// (entity, position.x, health)
+typedef std::tuple<uint64_t, float, int> Entry;
+
+class RecordSystem : public es::GenericSystem<true, CompPosition, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<CompPosition>& pos,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    for (const CompPosition& p : pos)
+      for (const CompGameplay& g : gp)
+        log.push_back(std::make_tuple(entityID, p.position.x, g.health));
+
+    // Queue a modification, as systems usually do.
+    CompGameplay damaged = gp.front();
+    damaged.health -= 1;
+    gp.modify(damaged, 0);
+  }
+};
+
+void applyChurn(es::ESCore& core, std::mt19937& rng, int frame)
+{
+  std::uniform_int_distribution<uint64_t> entity(1, 60);
+  for (int i = 0; i < 20; ++i)
+  {
+    uint64_t id = entity(rng);
+    core.addComponent(id, CompPosition(glm::vec3(static_cast<float>(frame * 100 + i), 0.0f, 0.0f)));
+    core.addComponent(entity(rng), CompGameplay(100, i));
+  }
+  for (int i = 0; i < 5; ++i)
+    core.removeFirstComponentT<CompPosition>(entity(rng));
+  core.removeEntity(entity(rng));
+}
+
+TEST(EntitySystem, TestLazyRenormalize)
+{
+  std::mt19937 rngA(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::mt19937 rngB(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore lazy;
+  es::ESCore eager;
+  lazy.setLazyRenormalize(true);
+  EXPECT_TRUE(lazy.isLazyRenormalize());
+  EXPECT_FALSE(eager.isLazyRenormalize());
+
+  lazy.addStaticComponent(CompCamera(1.0f));
+  eager.addStaticComponent(CompCamera(1.0f));
+
+  for (int frame = 0; frame < 8; ++frame)
+  {
+    applyChurn(lazy, rngA, frame);
+    applyChurn(eager, rngB, frame);
+    lazy.renormalize(true);
+    eager.renormalize(true);
+
+    // Only walk every other frame, so changes of several frames pile up
+    // behind deferred renormalizes in the lazy core.
+    if (frame % 2 == 1)
+    {
+      RecordSystem a, b;
+      a.walkComponents(lazy);
+      b.walkComponents(eager);
+      EXPECT_FALSE(a.log.empty());
+      EXPECT_TRUE(a.log == b.log);
+    }
+  }
+
+  lazy.flushPendingRenormalize();
+  RecordSystem a, b;
+  a.walkComponents(lazy);
+  b.walkComponents(eager);
+  EXPECT_TRUE(a.log == b.log);
+}
+
+TEST(EntitySystem, TestLazyRenormalizeDirty)
+{
+  es::ESCore core;
+  core.addComponent(1, CompPosition(glm::vec3(1.0f, 0.0f, 0.0f)));
+  core.addComponent(1, CompGameplay(10, 0));
+  core.addStaticComponent(CompCamera(2.0f));
+
+  es::BaseComponentContainer* pos = core.getComponentContainer(es::getESTypeID<CompPosition>());
+  es::BaseComponentContainer* gp = core.getComponentContainer(es::getESTypeID<CompGameplay>());
+  es::BaseComponentContainer* cam = core.getComponentContainer(es::getESTypeID<CompCamera>());
+  EXPECT_TRUE(pos->isDirty());
+  EXPECT_TRUE(gp->isDirty());
+  EXPECT_TRUE(cam->isDirty());
+
+  core.renormalize();
+  EXPECT_FALSE(pos->isDirty());
+  EXPECT_FALSE(gp->isDirty());
+  EXPECT_FALSE(cam->isDirty());
+
+  // Lazy renormalize defers until the container is accessed.
+  core.setLazyRenormalize(true);
+  core.addComponent(2, CompPosition(glm::vec3(2.0f, 0.0f, 0.0f)));
+  core.addComponent(2, CompGameplay(20, 0));
+  EXPECT_TRUE(pos->isDirty());
+  EXPECT_TRUE(gp->isDirty());
+  EXPECT_FALSE(cam->isDirty());
+
+  core.renormalize();
+  EXPECT_TRUE(pos->isRenormalizePending());
+  EXPECT_TRUE(gp->isRenormalizePending());
+  EXPECT_EQ(1, pos->getNumComponents());
+
+  core.flushPendingRenormalizeT<CompPosition>();
+  EXPECT_FALSE(pos->isRenormalizePending());
+  EXPECT_FALSE(pos->isDirty());
+  EXPECT_EQ(2, pos->getNumComponents());
+
+  // Queuing another change performs the deferred renormalize first, so the
+  // new change waits for the next renormalize.
+  core.addComponent(3, CompGameplay(30, 0));
+  EXPECT_FALSE(gp->isRenormalizePending());
+  EXPECT_TRUE(gp->isDirty());
+  EXPECT_EQ(2, gp->getNumComponents());
+
+  core.renormalize();
+  EXPECT_EQ(2, gp->getNumComponents());
+  EXPECT_EQ(3, core.getComponentContainer(es::getESTypeID<CompGameplay>())->getNumComponents());
+
+  // Static components are renormalized when retrieved.
+  core.addStaticComponent(CompCamera(3.0f));
+  core.renormalize();
+  EXPECT_TRUE(cam->isRenormalizePending());
+  ASSERT_NE(nullptr, core.getStaticComponent<CompCamera>(1));
+  EXPECT_FLOAT_EQ(3.0f, core.getStaticComponent<CompCamera>(1)->zoom);
+
+  // renormalizeNow is eager regardless of mode.
+  core.addComponent(4, CompPosition(glm::vec3(4.0f, 0.0f, 0.0f)));
+  core.renormalize();
+  core.renormalizeNow();
+  EXPECT_FALSE(pos->isDirty());
+  EXPECT_EQ(3, pos->getNumComponents());
+}
+
+// Custom container that queues changes without calling markDirty.
+class CountingContainer : public es::EmptyComponentContainer
+{
+public:
+  int renormalizes = 0;
+
+  void renormalize(bool) override {++renormalizes;}
+};
+
+TEST(EntitySystem, TestRenormalizeUntracked)
+{
+  es::ESCore core;
+  CountingContainer* counting = new CountingContainer();
+  core.addComponentContainer(counting, 1000000);
+  EXPECT_FALSE(counting->tracksDirty());
+
+  core.renormalize();
+  EXPECT_EQ(1, counting->renormalizes);
+
+  core.setLazyRenormalize(true);
+  core.renormalize();
+  EXPECT_EQ(2, counting->renormalizes);
+
+  core.renormalizeNow();
+  core.prepareRenormalize();
+  core.buildBackBuffers();
+  core.swapBuffers();
+  EXPECT_EQ(4, counting->renormalizes);
+}
+
+}
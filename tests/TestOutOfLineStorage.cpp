@@ -0,0 +1,183 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+// Large enough to be worth storing out of line, see its storage below.
+struct CompAnimState
+{
+  CompAnimState() : frame(0) {}
+  CompAnimState(int frameIn) : frame(frameIn)
+  {
+    for (int i = 0; i < 510; ++i)
+      weights[i] = static_cast<float>(frameIn + i);
+  }
+
+  int   frame;
+  float weights[510];
+};
+
+// Same data, kept in the array, as reference.
+struct CompRefAnimState : public CompAnimState
+{
+  CompRefAnimState() {}
+  CompRefAnimState(int frameIn) : CompAnimState(frameIn) {}
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+// Large, with the default storage.
+struct CompLargeDefault
+{
+  float data[1024];
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentStorageType<CompAnimState> : LargeOutOfLineComponentStorage<1024> {};
+template <> struct ComponentStorageType<CompRefAnimState> : InlineComponentStorage {};
+}
+
+namespace {
+
+static_assert(es::IsOutOfLineComponent<CompAnimState>::value, "CompAnimState should be out of line.");
+static_assert(!es::IsOutOfLineComponent<CompRefAnimState>::value, "CompRefAnimState should be inline.");
+static_assert(!es::IsOutOfLineComponent<CompGameplay>::value, "CompGameplay should be inline.");
+static_assert(!es::IsOutOfLineComponent<CompLargeDefault>::value, "Large components are inline by default.");
+static_assert(sizeof(es::ComponentContainer<CompAnimState>::ComponentItem) == 16,
+              "Out-of-line items hold a sequence and a handle.");
+
+// (entity, frame, weights[509], health)
+typedef std::tuple<uint64_t, int, float, int> Entry;
+
+template <typename Anim>
+class GroupSystem : public es::GenericSystem<true, Anim, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<Anim>& anims,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    for (const Anim& a : anims)
+      log.push_back(std::make_tuple(entityID, a.frame, a.weights[509], gp.front().health));
+
+    Anim next = anims.front();
+    ++next.frame;
+    next.weights[509] += 1.0f;
+    anims.modify(next, 0);
+  }
+};
+
+template <typename Anim>
+class PointerSystem : public es::GenericSystem<false, Anim, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID, const Anim* anim, const CompGameplay* gp) override
+  {
+    log.push_back(std::make_tuple(entityID, anim->frame, anim->weights[509], gp->health));
+  }
+};
+
+TEST(EntitySystem, TestOutOfLineStorage)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  es::ComponentSlab<CompAnimState>& slab = es::ComponentSlab<CompAnimState>::instance();
+
+  {
+    es::ESCore core;
+    const uint64_t maxID = 2000;
+    for (uint64_t id = 1; id <= maxID; id += 2)
+      core.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+
+    auto addAnim = [&core](uint64_t id, int frame)
+    {
+      core.addComponent(id, CompAnimState(frame));
+      core.addComponent(id, CompRefAnimState(frame));
+    };
+
+    // Added in reverse, so the sort has to move every item.
+    for (uint64_t id = maxID; id >= 1; --id)
+      addAnim(id, static_cast<int>(id));
+    core.renormalize(true);
+
+    es::ComponentContainer<CompAnimState>* anims = dynamic_cast<es::ComponentContainer<CompAnimState>*>(
+        core.getComponentContainer(es::getESTypeID<CompAnimState>()));
+    ASSERT_NE(nullptr, anims);
+    EXPECT_EQ(maxID, slab.getNumComponents());
+
+    // Components do not move when the array is sorted and compacted.
+    const CompAnimState* stable = anims->getComponent(maxID).first;
+    ASSERT_NE(nullptr, stable);
+    EXPECT_EQ(static_cast<int>(maxID), stable->frame);
+
+    std::uniform_int_distribution<uint64_t> entity(1, maxID - 1);
+    for (int frame = 0; frame < 10; ++frame)
+    {
+      for (int i = 0; i < 300; ++i)
+        addAnim(entity(rng), frame * 1000 + i);
+      for (int i = 0; i < 100; ++i)
+      {
+        uint64_t id = entity(rng);
+        core.removeFirstComponentT<CompAnimState>(id);
+        core.removeFirstComponentT<CompRefAnimState>(id);
+        id = entity(rng);
+        core.removeComponentAtIndexT<CompAnimState>(id, 1);
+        core.removeComponentAtIndexT<CompRefAnimState>(id, 1);
+      }
+      core.removeEntity(entity(rng));
+      core.renormalize(true);
+
+      GroupSystem<CompAnimState> group;
+      GroupSystem<CompRefAnimState> groupRef;
+      group.walkComponents(core);
+      groupRef.walkComponents(core);
+      EXPECT_FALSE(group.log.empty());
+      ASSERT_TRUE(group.log == groupRef.log);
+
+      PointerSystem<CompAnimState> pointer;
+      PointerSystem<CompRefAnimState> pointerRef;
+      pointer.walkComponents(core);
+      pointerRef.walkComponents(core);
+      ASSERT_TRUE(pointer.log == pointerRef.log);
+
+      core.renormalize(true);
+      EXPECT_EQ(anims->getNumComponents(), slab.getNumComponents());
+    }
+
+    // Nor when the array grows or other components are removed.
+    EXPECT_EQ(stable, anims->getComponent(maxID).first);
+  }
+
+  // Destroying the core returns every slot.
+  EXPECT_EQ(0, slab.getNumComponents());
+}
+
+}
+
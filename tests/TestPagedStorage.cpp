@@ -0,0 +1,174 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/PagedArray.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+// Stored in paged storage.
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+// Same data as CompPosition, in the default storage, as reference.
+struct CompRefPosition
+{
+  CompRefPosition() {}
+  CompRefPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentStorageType<CompPosition>
+    : PagedComponentStorage<(size_t(64) << 10), (uint64_t(1) << 30)> {};
+}
+
+namespace {
+
+// (entity, position.x, health)
+typedef std::tuple<uint64_t, float, int> Entry;
+
+template <typename Pos>
+class RecordSystem : public es::GenericSystem<true, Pos, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<Pos>& pos,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    for (const Pos& p : pos)
+      log.push_back(std::make_tuple(entityID, p.position.x, gp.front().health));
+
+    Pos moved = pos.front();
+    moved.position.x += 1.0f;
+    pos.modify(moved, 0);
+  }
+};
+
+TEST(EntitySystem, TestPagedArray)
+{
+  typedef es::PagedArray<uint64_t, 4096, (uint64_t(1) << 24)> Array;
+  Array array;
+  EXPECT_EQ(0, array.getNumCommittedChunks());
+
+  // Growth commits chunks in place, the array never moves.
+  array.push_back(0);
+  const uint64_t* data = array.data();
+  for (uint64_t i = 1; i < 100000; ++i)
+    array.push_back(i);
+  EXPECT_EQ(data, array.data());
+  EXPECT_EQ((100000 * sizeof(uint64_t) + 4095) / 4096, array.getNumCommittedChunks());
+  for (uint64_t i = 0; i < 100000; ++i)
+    ASSERT_EQ(i, array[i]);
+
+  // Emptied chunks are released, but one.
+  array.erase(array.begin() + 1000, array.end());
+  EXPECT_EQ((1000 * sizeof(uint64_t) + 4095) / 4096 + 1, array.getNumCommittedChunks());
+  EXPECT_EQ(999, array.back());
+
+  array.insert(array.begin() + 10, array.begin(), array.begin() + 5);
+  EXPECT_EQ(1005, array.size());
+  EXPECT_EQ(9, array[9]);
+  EXPECT_EQ(0, array[10]);
+  EXPECT_EQ(4, array[14]);
+  EXPECT_EQ(10, array[15]);
+
+  array.clear();
+  EXPECT_EQ(0, array.getNumCommittedChunks());
+
+  // Exceeding the reservation throws.
+  EXPECT_THROW(array.reserve((size_t(1) << 24) / sizeof(uint64_t) + 1), std::runtime_error);
+}
+
+TEST(EntitySystem, TestPagedStorage)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  es::ESCore core;
+  const uint64_t maxID = 20000;
+  for (uint64_t id = 1; id <= maxID; id += 2)
+    core.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+
+  auto addPosition = [&core](uint64_t id, float x)
+  {
+    core.addComponent(id, CompPosition(glm::vec3(x)));
+    core.addComponent(id, CompRefPosition(glm::vec3(x)));
+  };
+
+  for (uint64_t id = 1; id <= maxID; ++id)
+    addPosition(id, static_cast<float>(id));
+  core.renormalize(true);
+
+  es::ComponentContainer<CompPosition>* positions = dynamic_cast<es::ComponentContainer<CompPosition>*>(
+      core.getComponentContainer(es::getESTypeID<CompPosition>()));
+  ASSERT_NE(nullptr, positions);
+  const void* array = positions->getComponentArray();
+
+  std::uniform_int_distribution<uint64_t> entity(1, maxID);
+  for (int frame = 0; frame < 10; ++frame)
+  {
+    // Grow the container, components spanning many chunks.
+    for (int i = 0; i < 5000; ++i)
+      addPosition(entity(rng), static_cast<float>(frame * 10000 + i));
+    for (int i = 0; i < 500; ++i)
+    {
+      uint64_t id = entity(rng);
+      core.removeFirstComponentT<CompPosition>(id);
+      core.removeFirstComponentT<CompRefPosition>(id);
+      id = entity(rng);
+      core.removeLastComponentT<CompPosition>(id);
+      core.removeLastComponentT<CompRefPosition>(id);
+      id = entity(rng);
+      core.removeComponentAtIndexT<CompPosition>(id, 1);
+      core.removeComponentAtIndexT<CompRefPosition>(id, 1);
+    }
+    core.removeEntity(entity(rng));
+    core.renormalize(true);
+
+    RecordSystem<CompPosition> paged;
+    RecordSystem<CompRefPosition> reference;
+    paged.walkComponents(core);
+    reference.walkComponents(core);
+    EXPECT_FALSE(paged.log.empty());
+    ASSERT_TRUE(paged.log == reference.log);
+    core.renormalize(true);
+  }
+
+  // Growth never moved the components.
+  EXPECT_EQ(array, positions->getComponentArray());
+}
+
+}
+
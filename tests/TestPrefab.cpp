@@ -0,0 +1,183 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/Prefab.hpp>
+#include <entity-system/src/IncrementalComponentContainer.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <glm/glm.hpp>
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompHomPos
+{
+  CompHomPos() {}
+  CompHomPos(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompMesh
+{
+  static int constructor;
+
+  CompMesh() : mesh(0) {}
+  CompMesh(int meshIn) : mesh(meshIn) {}
+
+  void componentConstruct(uint64_t) {++constructor;}
+
+  int mesh;
+};
+
+int CompMesh::constructor = 0;
+
+struct CompTag
+{
+  CompTag() : tag(0) {}
+  CompTag(int tagIn) : tag(tagIn) {}
+
+  int tag;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentContainerType<CompHomPos>
+{typedef IncrementalComponentContainer<CompHomPos> type;};
+template <> struct ComponentContainerType<CompMesh>
+{typedef DoubleBufferedComponentContainer<CompMesh> type;};
+}
+
+namespace {
+
+// Counts entities with a position and two meshes.
+class SpawnedSystem : public es::GenericSystem<true, CompPosition, CompHomPos, CompMesh>
+{
+public:
+  uint64_t numEntities = 0;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<CompPosition>& pos,
+                    const es::ComponentGroup<CompHomPos>& hom,
+                    const es::ComponentGroup<CompMesh>& meshes) override
+  {
+    ASSERT_EQ(1, pos.numComponents);
+    ASSERT_EQ(1, hom.numComponents);
+    ASSERT_EQ(2, meshes.numComponents);
+    EXPECT_EQ(1, meshes.components[0].get().mesh);
+    EXPECT_EQ(2, meshes.components[1].get().mesh);
+    ++numEntities;
+  }
+};
+
+template <typename T>
+es::ComponentContainer<T>* container(es::ESCore& core)
+{
+  return dynamic_cast<es::ComponentContainer<T>*>(core.getComponentContainer(es::getESTypeID<T>()));
+}
+
+TEST(EntitySystem, TestPrefab)
+{
+  es::ESCore core;
+  uint64_t templateID = core.getNewEntityID();
+  core.addComponent(templateID, CompPosition(glm::vec3(1.0f)));
+  core.addComponent(templateID, CompHomPos(glm::vec3(2.0f)));
+  core.addComponent(templateID, CompMesh(1));
+  core.addComponent(templateID, CompMesh(2));
+  core.addComponent(templateID + 1000, CompTag(1));
+  core.renormalize(true);
+
+  es::Prefab prefab = core.createPrefab(templateID);
+  EXPECT_EQ(templateID, prefab.getSourceEntityID());
+  EXPECT_EQ(3, prefab.getNumComponentTypes());
+  ASSERT_NE(nullptr, prefab.getComponents<CompMesh>());
+  EXPECT_EQ(2, prefab.getComponents<CompMesh>()->size());
+  EXPECT_EQ(nullptr, prefab.getComponents<CompTag>());
+
+  // Later changes to the template entity are not captured.
+  container<CompPosition>(core)->modifyIndex(CompPosition(glm::vec3(-1.0f)), 0, 1);
+  core.renormalize(true);
+
+  prefab.setOverride<CompPosition>([](uint64_t entityID, size_t instance, CompPosition& p)
+  {
+    p.position = p.position + glm::vec3(static_cast<float>(instance));
+  });
+  EXPECT_THROW(prefab.setOverride<CompTag>([](uint64_t, size_t, CompTag&) {}), std::runtime_error);
+
+  const size_t numSpawned = 10000;
+  CompMesh::constructor = 0;
+  uint64_t first = core.instantiatePrefab(prefab, numSpawned);
+  EXPECT_EQ(templateID + 1, first);
+  EXPECT_EQ(first + numSpawned, core.getNewEntityID());
+  core.renormalize(true);
+  EXPECT_EQ(2 * numSpawned, CompMesh::constructor);
+
+  SpawnedSystem spawned;
+  spawned.walkComponents(core);
+  EXPECT_EQ(numSpawned + 1, spawned.numEntities);
+
+  es::ComponentContainer<CompPosition>* positions = container<CompPosition>(core);
+  ASSERT_EQ(numSpawned + 1, positions->getNumComponents());
+  for (size_t i = 0; i < numSpawned; ++i)
+  {
+    const es::ComponentContainer<CompPosition>::ComponentItem& item = positions->getComponentArray()[i + 1];
+    ASSERT_EQ(first + i, item.sequence);
+    ASSERT_TRUE(glm::vec3(1.0f + static_cast<float>(i)) == item.get().position);
+  }
+  EXPECT_TRUE(glm::vec3(2.0f) == container<CompHomPos>(core)->getComponentArray()[numSpawned].get().position);
+
+  // Explicit IDs, and edited components.
+  (*prefab.getComponents<CompHomPos>())[0].position = glm::vec3(3.0f);
+  core.instantiatePrefab(prefab, 50000, 3);
+  core.renormalize(true);
+  spawned.numEntities = 0;
+  spawned.walkComponents(core);
+  EXPECT_EQ(numSpawned + 4, spawned.numEntities);
+  EXPECT_EQ(50002, positions->getUpperSequence());
+  es::ComponentContainer<CompHomPos>* hom = container<CompHomPos>(core);
+  EXPECT_TRUE(glm::vec3(3.0f) == hom->getComponentArray()[hom->getNumComponents() - 1].get().position);
+}
+
+TEST(EntitySystem, TestPrefabErrors)
+{
+  es::ESCore core;
+  core.addComponent(1, CompPosition(glm::vec3(1.0f)));
+  core.addComponent(1, CompTag(7));
+  core.renormalize(true);
+
+  es::Prefab prefab = core.createPrefab(1);
+  es::Prefab empty = core.createPrefab(2);
+  EXPECT_EQ(0, empty.getNumComponentTypes());
+
+  // Every container is checked before anything is queued.
+  es::ESCore other;
+  other.addComponent(1, CompPosition(glm::vec3(1.0f)));
+  other.renormalize(true);
+  EXPECT_THROW(other.instantiatePrefab(prefab, 10, 5), std::runtime_error);
+  EXPECT_THROW(core.instantiatePrefab(prefab, 0, 5), std::runtime_error);
+  other.renormalize(true);
+  EXPECT_EQ(1, container<CompPosition>(other)->getNumComponents());
+
+  // Instantiating into another core that holds all types.
+  other.addComponent(1, CompTag(0));
+  other.renormalize(true);
+  other.instantiatePrefab(prefab, 10, 5);
+  core.instantiatePrefab(empty, 5);
+  other.renormalize(true);
+  EXPECT_EQ(6, container<CompTag>(other)->getNumComponents());
+  EXPECT_EQ(7, container<CompTag>(other)->getComponentArray()[5].get().tag);
+}
+
+}
+
@@ -0,0 +1,110 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/Query.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <glm/glm.hpp>
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+class CountSystem : public es::GenericSystem<false, CompPosition, CompGameplay>
+{
+public:
+  CountSystem() : numCalls(0) {}
+
+  void execute(es::ESCoreBase&, uint64_t,
+               const CompPosition*, const CompGameplay*) override
+  {
+    ++numCalls;
+  }
+
+  int numCalls;
+};
+
+TEST(EntitySystem, TestQuery)
+{
+  std::shared_ptr<es::ESCore> core(new es::ESCore());
+
+  uint64_t id = core->getNewEntityID();
+  core->addComponent(id, CompPosition(glm::vec3(1.0f, 2.0f, 3.0f)));
+  core->renormalize();
+
+  es::Query<CompPosition, CompGameplay> query(*core);
+  EXPECT_TRUE(query.isValid());
+  EXPECT_EQ(core->getComponentContainer(es::getESTypeID<CompPosition>()),
+            query.getContainer<CompPosition>());
+  EXPECT_EQ(nullptr, query.getContainer<CompGameplay>());
+
+  // Binding again to an unchanged core keeps the cached containers.
+  uint64_t version = core->getContainerVersion();
+  query.bind(*core);
+  EXPECT_EQ(version, core->getContainerVersion());
+  EXPECT_TRUE(query.isValid());
+
+  // Adding components to existing containers does not invalidate the query.
+  core->addComponent(id, CompPosition(glm::vec3(4.0f, 5.0f, 6.0f)));
+  core->renormalize();
+  EXPECT_TRUE(query.isValid());
+
+  // Adding a new container does.
+  core->addComponent(id, CompGameplay(10, 20));
+  EXPECT_FALSE(query.isValid());
+  query.bind(*core);
+  EXPECT_TRUE(query.isValid());
+  EXPECT_EQ(core->getComponentContainer(es::getESTypeID<CompGameplay>()),
+            query.getContainer<CompGameplay>());
+  core->renormalize();
+
+  // Systems cache their query internally. Walk before and after a container
+  // they depend on is created, and across two different cores.
+  std::shared_ptr<es::ESCore> core2(new es::ESCore());
+  uint64_t id2 = core2->getNewEntityID();
+  core2->addComponent(id2, CompPosition(glm::vec3(0.0f)));
+  core2->renormalize();
+
+  // Versions are unique across cores.
+  EXPECT_NE(core->getContainerVersion(), core2->getContainerVersion());
+
+  CountSystem sys;
+  sys.walkComponents(*core2);
+  EXPECT_EQ(0, sys.numCalls);
+
+  core2->addComponent(id2, CompGameplay(1, 2));
+  core2->renormalize();
+  sys.walkComponents(*core2);
+  EXPECT_EQ(1, sys.numCalls);
+
+  // Two position components on the first core's entity.
+  sys.walkComponents(*core);
+  EXPECT_EQ(3, sys.numCalls);
+
+  sys.walkComponents(*core2);
+  EXPECT_EQ(4, sys.numCalls);
+}
+
+}
+
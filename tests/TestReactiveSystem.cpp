@@ -0,0 +1,224 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/ReactiveSystem.hpp>
+#include <entity-system/src/IncrementalComponentContainer.hpp>
+#include <entity-system/src/DoubleBufferedComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <map>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+// One mesh type per container type under test.
+template <int N>
+struct CompMesh
+{
+  static int constructor;
+  static int destructor;
+
+  CompMesh() : mesh(0) {}
+  CompMesh(int meshIn) : mesh(meshIn) {}
+
+  void componentConstruct(uint64_t) {++constructor;}
+  void componentDestruct(uint64_t)  {++destructor;}
+
+  int mesh;
+};
+
+template <int N> int CompMesh<N>::constructor = 0;
+template <int N> int CompMesh<N>::destructor = 0;
+
+typedef CompMesh<0> CompPlain;
+typedef CompMesh<1> CompIncremental;
+typedef CompMesh<2> CompBuffered;
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentContainerType<CompIncremental>
+{typedef IncrementalComponentContainer<CompIncremental> type;};
+template <> struct ComponentContainerType<CompBuffered>
+{typedef DoubleBufferedComponentContainer<CompBuffered> type;};
+}
+
+namespace {
+
+// Mirrors the meshes of the core, one batch at a time.
+template <typename T>
+class MirrorSystem : public es::ReactiveSystem<T>
+{
+public:
+  typedef typename es::ReactiveSystem<T>::ComponentItem ComponentItem;
+
+  std::multimap<uint64_t, int> meshes;
+  int numAddedBatches = 0;
+  int numRemovedBatches = 0;
+  int numAddedItems = 0;
+  int numRemovedItems = 0;
+
+  void onAdded(es::ESCoreBase&, const ComponentItem* items, size_t count) override
+  {
+    ++numAddedBatches;
+    numAddedItems += static_cast<int>(count);
+    for (size_t i = 0; i < count; ++i)
+      meshes.insert(std::make_pair(items[i].sequence, items[i].get().mesh));
+  }
+
+  void onRemoved(es::ESCoreBase&, const ComponentItem* items, size_t count) override
+  {
+    ++numRemovedBatches;
+    numRemovedItems += static_cast<int>(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+      auto range = meshes.equal_range(items[i].sequence);
+      auto it = range.first;
+      while (it != range.second && it->second != items[i].get().mesh)
+        ++it;
+      ASSERT_TRUE(it != range.second);
+      meshes.erase(it);
+    }
+  }
+};
+
+template <typename T>
+std::multimap<uint64_t, int> contents(es::ESCore& core)
+{
+  std::multimap<uint64_t, int> result;
+  es::ComponentContainer<T>* container = dynamic_cast<es::ComponentContainer<T>*>(
+      core.getComponentContainer(es::getESTypeID<T>()));
+  for (uint64_t i = 0; i < container->getNumComponents(); ++i)
+    result.insert(std::make_pair(container->getComponentArray()[i].sequence,
+                                 container->getComponentArray()[i].get().mesh));
+  return result;
+}
+
+// Random additions and removals, mirrored through the batches only.
+template <typename T>
+void checkReactiveSystem(bool overlapped)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::uniform_int_distribution<uint64_t> entity(1, 500);
+  std::uniform_int_distribution<int> mesh(1, 1000);
+
+  es::ESCore core;
+  MirrorSystem<T> mirror;
+  core.addReactiveSystem(&mirror);
+  T::constructor = 0;
+  T::destructor = 0;
+
+  int numAdded = 0;
+  for (int frame = 0; frame < 20; ++frame)
+  {
+    int before = mirror.numAddedBatches;
+    for (int i = 0; i < 50; ++i)
+      core.addComponent(entity(rng), T(mesh(rng)));
+    numAdded += 50;
+
+    for (int i = 0; i < 10; ++i)
+      core.removeEntity(entity(rng));
+
+    if (overlapped)
+    {
+      core.prepareRenormalize(true);
+      core.buildBackBuffers();
+      EXPECT_EQ(before, mirror.numAddedBatches);
+      core.swapBuffers();
+    }
+    else
+    {
+      core.renormalize(true);
+    }
+
+    // One batch per renormalize.
+    EXPECT_EQ(before + 1, mirror.numAddedBatches);
+    ASSERT_TRUE(contents<T>(core) == mirror.meshes) << "frame " << frame;
+  }
+
+  // The per component hooks are still called.
+  EXPECT_EQ(numAdded, T::constructor);
+  EXPECT_EQ(numAdded, mirror.numAddedItems);
+  EXPECT_EQ(mirror.numRemovedItems, T::destructor);
+  EXPECT_LT(0, T::destructor);
+
+  // Nothing is handed over when nothing was added or removed.
+  int added = mirror.numAddedBatches;
+  int removed = mirror.numRemovedBatches;
+  es::ComponentContainer<T>* container = dynamic_cast<es::ComponentContainer<T>*>(
+      core.getComponentContainer(es::getESTypeID<T>()));
+  container->modifyIndex(T(-1), 0, 1);
+  core.renormalize(true);
+  EXPECT_EQ(added, mirror.numAddedBatches);
+  EXPECT_EQ(removed, mirror.numRemovedBatches);
+
+  core.removeReactiveSystem(&mirror);
+  EXPECT_FALSE(container->isReactive());
+  core.addComponent(1, T(1));
+  core.renormalize(true);
+  EXPECT_EQ(added, mirror.numAddedBatches);
+}
+
+TEST(EntitySystem, TestReactiveSystem)
+{
+  checkReactiveSystem<CompPlain>(false);
+  checkReactiveSystem<CompIncremental>(false);
+  checkReactiveSystem<CompBuffered>(false);
+  checkReactiveSystem<CompBuffered>(true);
+}
+
+TEST(EntitySystem, TestReactiveSystemRegistration)
+{
+  es::ESCore core;
+  core.addComponent(1, CompPlain(1));
+  core.renormalize(true);
+
+  // Components added before registration are not reported.
+  MirrorSystem<CompPlain> first;
+  MirrorSystem<CompPlain> second;
+  core.addReactiveSystem(&first);
+  core.addReactiveSystem(&second);
+  core.addReactiveSystem(&first);
+  core.addComponent(2, CompPlain(2));
+  core.renormalize(true);
+  EXPECT_EQ(1, first.numAddedBatches);
+  EXPECT_EQ(1, second.numAddedBatches);
+  EXPECT_EQ(1, first.meshes.size());
+  EXPECT_EQ(1, second.meshes.size());
+
+  // Registered before the container exists.
+  MirrorSystem<CompIncremental> incremental;
+  core.addReactiveSystem(&incremental);
+  core.addComponent(3, CompIncremental(3));
+  core.renormalize(true);
+  EXPECT_EQ(1, incremental.meshes.size());
+  EXPECT_EQ(1, first.numAddedBatches);
+
+  // Lazy renormalize still hands batches over at renormalize.
+  core.setLazyRenormalize(true);
+  core.addComponent(4, CompIncremental(4));
+  core.removeEntity(2);
+  core.renormalize(true);
+  EXPECT_EQ(2, incremental.meshes.size());
+  EXPECT_TRUE(first.meshes.empty());
+  EXPECT_TRUE(second.meshes.empty());
+  EXPECT_EQ(1, second.numRemovedBatches);
+
+  // Added and removed in the same frame: in both batches.
+  core.setLazyRenormalize(false);
+  core.addComponent(5, CompIncremental(5));
+  core.removeEntity(5);
+  core.renormalize(true);
+  EXPECT_EQ(3, incremental.numAddedBatches);
+  EXPECT_EQ(1, incremental.numRemovedBatches);
+  EXPECT_EQ(2, incremental.meshes.size());
+}
+
+}
+
@@ -0,0 +1,151 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/SparseComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+// Core that stores positions in a sparse component container.
+class SparseCore : public es::ESCore
+{
+public:
+  void addSparsePosition(uint64_t entityID, const CompPosition& pos)
+  {
+    coreAddComponent<CompPosition, es::SparseComponentContainer<CompPosition>>(entityID, pos);
+  }
+};
+
+class WalkSystem : public es::GenericSystem<false, CompPosition, CompGameplay>
+{
+public:
+  std::vector<std::pair<uint64_t, float>> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompPosition* pos, const CompGameplay*) override
+  {
+    log.push_back(std::make_pair(entityID, pos->position.x));
+  }
+};
+
+TEST(EntitySystem, TestSparseContainer)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::uniform_int_distribution<int> coin(0, 2);
+
+  std::shared_ptr<SparseCore> sparse(new SparseCore());
+  std::shared_ptr<es::ESCore> dense(new es::ESCore());
+
+  // Spread entity IDs over several index pages.
+  std::vector<uint64_t> ids;
+  for (uint64_t i = 0; i < 3000; ++i)
+  {
+    uint64_t id = 2 + i * 7;
+    ids.push_back(id);
+
+    int numPos = coin(rng);
+    for (int p = 0; p < numPos; ++p)
+    {
+      CompPosition pos(glm::vec3(static_cast<float>(id) + p, 0.0f, 0.0f));
+      sparse->addSparsePosition(id, pos);
+      dense->addComponent(id, pos);
+    }
+    if (coin(rng) != 0)
+    {
+      sparse->addComponent(id, CompGameplay(static_cast<int>(id), 1));
+      dense->addComponent(id, CompGameplay(static_cast<int>(id), 1));
+    }
+  }
+
+  for (int frame = 0; frame < 3; ++frame)
+  {
+    sparse->renormalize(true);
+    dense->renormalize(true);
+
+    es::SparseComponentContainer<CompPosition>* sparseCont =
+        dynamic_cast<es::SparseComponentContainer<CompPosition>*>(
+            sparse->getComponentContainer(es::getESTypeID<CompPosition>()));
+    es::ComponentContainer<CompPosition>* denseCont =
+        dynamic_cast<es::ComponentContainer<CompPosition>*>(
+            dense->getComponentContainer(es::getESTypeID<CompPosition>()));
+    ASSERT_NE(nullptr, sparseCont);
+    ASSERT_NE(nullptr, denseCont);
+    EXPECT_GT(sparseCont->getSparseIndex().getNumAllocatedPages(), 1);
+
+    // Random access must agree with the binary search, including for IDs
+    // that were never added.
+    for (uint64_t id = 0; id < ids.back() + 10; ++id)
+    {
+      EXPECT_EQ(denseCont->getComponentItemIndexWithSequence(id),
+                sparseCont->getComponentItemIndexWithSequence(id));
+
+      std::pair<const CompPosition*, size_t> a = denseCont->getComponent(id);
+      std::pair<const CompPosition*, size_t> b = sparseCont->getComponent(id);
+      ASSERT_EQ(a.first == nullptr, b.first == nullptr);
+      if (a.first)
+      {
+        EXPECT_EQ(a.second, b.second);
+        EXPECT_FLOAT_EQ(a.first->position.x, b.first->position.x);
+      }
+      EXPECT_EQ(a.first == nullptr, sparseCont->getComponentWithSequence(id) == nullptr);
+    }
+
+    // Walks see exactly the same data.
+    WalkSystem sparseSys, denseSys;
+    sparseSys.walkComponents(*sparse);
+    denseSys.walkComponents(*dense);
+    EXPECT_TRUE(sparseSys.log == denseSys.log);
+
+    WalkSystem sparseEnt, denseEnt;
+    for (size_t i = 0; i < ids.size(); i += 13)
+    {
+      EXPECT_EQ(denseEnt.walkEntity(*dense, ids[i]), sparseEnt.walkEntity(*sparse, ids[i]));
+    }
+    EXPECT_TRUE(sparseEnt.log == denseEnt.log);
+
+    // Churn for the next frame: remove some entities, add some components.
+    for (size_t i = frame; i < ids.size(); i += 5)
+    {
+      sparse->removeEntity(ids[i]);
+      dense->removeEntity(ids[i]);
+    }
+    for (size_t i = frame + 1; i < ids.size(); i += 11)
+    {
+      CompPosition pos(glm::vec3(static_cast<float>(frame), 1.0f, 0.0f));
+      sparse->addSparsePosition(ids[i], pos);
+      dense->addComponent(ids[i], pos);
+    }
+  }
+}
+
+}
+
@@ -0,0 +1,111 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <glm/glm.hpp>
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompSelected {};
+struct CompDead {};
+
+static_assert(sizeof(es::ComponentContainer<CompSelected>::ComponentItem) == sizeof(uint64_t),
+              "Tag component items should only hold their sequence");
+
+class SelectedSystem : public es::GenericSystem<false, CompPosition, CompSelected, CompDead>
+{
+public:
+  std::vector<uint64_t> alive;
+  std::vector<uint64_t> dead;
+  std::vector<const CompSelected*> tags;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompPosition*, const CompSelected* sel, const CompDead* d) override
+  {
+    tags.push_back(sel);
+    if (d)
+      dead.push_back(entityID);
+    else
+      alive.push_back(entityID);
+  }
+
+  bool isComponentOptional(uint64_t templateID) override
+  {
+    return es::OptionalComponents<CompDead>(templateID);
+  }
+};
+
+class SelectedGroupSystem : public es::GenericSystem<true, CompPosition, CompSelected>
+{
+public:
+  std::vector<std::pair<size_t, size_t>> sizes;
+
+  void groupExecute(es::ESCoreBase&, uint64_t,
+                    const es::ComponentGroup<CompPosition>& pos,
+                    const es::ComponentGroup<CompSelected>& sel) override
+  {
+    sizes.push_back(std::make_pair(pos.size(), sel.size()));
+  }
+};
+
+TEST(EntitySystem, TestTagComponents)
+{
+  std::shared_ptr<es::ESCore> core(new es::ESCore());
+
+  for (uint64_t id = 1; id <= 10; ++id)
+  {
+    core->addComponent(id, CompPosition(glm::vec3(static_cast<float>(id), 0.0f, 0.0f)));
+    if (id % 2 == 0)
+      core->addComponent(id, CompSelected());
+    if (id % 4 == 0)
+      core->addComponent(id, CompDead());
+  }
+  core->addComponent(6, CompSelected());
+  core->renormalize(true);
+
+  SelectedSystem sys;
+  sys.walkComponents(*core);
+  EXPECT_EQ(std::vector<uint64_t>({2, 6, 6, 10}), sys.alive);
+  EXPECT_EQ(std::vector<uint64_t>({4, 8}), sys.dead);
+
+  // Every entity sees the same shared tag instance.
+  ASSERT_EQ(6, sys.tags.size());
+  for (const CompSelected* tag : sys.tags)
+    EXPECT_EQ(sys.tags[0], tag);
+
+  SelectedGroupSystem group;
+  group.walkComponents(*core);
+  ASSERT_EQ(5, group.sizes.size());
+  EXPECT_EQ(std::make_pair(size_t(1), size_t(2)), group.sizes[2]);
+
+  // Modifications of tags are dropped, removals go through as usual.
+  es::ComponentContainer<CompSelected>* cont =
+      dynamic_cast<es::ComponentContainer<CompSelected>*>(
+          core->getComponentContainer(es::getESTypeID<CompSelected>()));
+  ASSERT_NE(nullptr, cont);
+  cont->modifyIndex(CompSelected(), 0, 0);
+
+  core->removeEntity(6);
+  core->removeAllComponentsT<CompDead>(4);
+  core->renormalize(true);
+
+  SelectedSystem after;
+  after.walkComponents(*core);
+  EXPECT_EQ(std::vector<uint64_t>({2, 4, 10}), after.alive);
+  EXPECT_EQ(std::vector<uint64_t>({8}), after.dead);
+  EXPECT_EQ(4, cont->getNumComponents());
+}
+
+}
+
@@ -0,0 +1,144 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+// Plain data: takes the memmove / memcpy paths.
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+// Same data with hooks: takes the generic paths, as reference.
+struct CompRefPosition
+{
+  CompRefPosition() {}
+  CompRefPosition(const glm::vec3& pos) {position = pos;}
+
+  void componentConstruct(uint64_t) {++numConstructed;}
+  void componentDestruct(uint64_t)  {++numDestructed;}
+
+  glm::vec3 position;
+
+  static int numConstructed;
+  static int numDestructed;
+};
+
+int CompRefPosition::numConstructed = 0;
+int CompRefPosition::numDestructed = 0;
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+static_assert(es::ComponentTraits<CompPosition>::IsTrivial, "CompPosition should be trivial.");
+static_assert(es::ComponentContainer<CompPosition>::TrivialItems, "CompPosition items should be trivial.");
+static_assert(es::ComponentTraits<CompRefPosition>::HasConstructHook, "CompRefPosition has a construct hook.");
+static_assert(es::ComponentTraits<CompRefPosition>::HasDestructHook, "CompRefPosition has a destruct hook.");
+static_assert(!es::ComponentContainer<CompRefPosition>::TrivialItems, "CompRefPosition has hooks.");
+
+// (entity, position.x, health)
+typedef std::tuple<uint64_t, float, int> Entry;
+
+template <typename Pos>
+class RecordSystem : public es::GenericSystem<true, Pos, CompGameplay>
+{
+public:
+  std::vector<Entry> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<Pos>& pos,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    for (const Pos& p : pos)
+      log.push_back(std::make_tuple(entityID, p.position.x, gp.front().health));
+
+    Pos moved = pos.back();
+    moved.position.x += 0.5f;
+    pos.modify(moved, pos.size() - 1);
+  }
+};
+
+TEST(EntitySystem, TestTrivialComponents)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+
+  CompRefPosition::numConstructed = 0;
+  CompRefPosition::numDestructed = 0;
+  int numAdded = 0;
+  {
+    es::ESCore core;
+    const uint64_t maxID = 5000;
+    for (uint64_t id = 1; id <= maxID; id += 2)
+      core.addComponent(id, CompGameplay(static_cast<int>(id), 0));
+
+    auto addPosition = [&core, &numAdded](uint64_t id, float x)
+    {
+      core.addComponent(id, CompPosition(glm::vec3(x)));
+      core.addComponent(id, CompRefPosition(glm::vec3(x)));
+      ++numAdded;
+    };
+
+    for (uint64_t id = 1; id <= maxID; ++id)
+      addPosition(id, static_cast<float>(id));
+    core.renormalize(true);
+
+    std::uniform_int_distribution<uint64_t> entity(1, maxID);
+    for (int frame = 0; frame < 20; ++frame)
+    {
+      // Additions merged into the sorted array, including several per
+      // entity and entities already holding components.
+      for (int i = 0; i < 500; ++i)
+        addPosition(entity(rng), static_cast<float>(frame * 1000 + i));
+      for (int i = 0; i < 200; ++i)
+      {
+        uint64_t id = entity(rng);
+        core.removeFirstComponentT<CompPosition>(id);
+        core.removeFirstComponentT<CompRefPosition>(id);
+        id = entity(rng);
+        core.removeLastComponentT<CompPosition>(id);
+        core.removeLastComponentT<CompRefPosition>(id);
+      }
+      core.removeEntity(entity(rng));
+      core.renormalize(true);
+
+      RecordSystem<CompPosition> trivial;
+      RecordSystem<CompRefPosition> reference;
+      trivial.walkComponents(core);
+      reference.walkComponents(core);
+      EXPECT_FALSE(trivial.log.empty());
+      ASSERT_TRUE(trivial.log == reference.log);
+      core.renormalize(true);
+    }
+  }
+
+  // The generic path still runs the hooks of every component.
+  EXPECT_EQ(numAdded, CompRefPosition::numConstructed);
+  EXPECT_EQ(numAdded, CompRefPosition::numDestructed);
+}
+
+}
+
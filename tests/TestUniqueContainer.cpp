@@ -0,0 +1,207 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <entity-system/src/UniqueComponentContainer.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <glm/glm.hpp>
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompTransform
+{
+  CompTransform() {}
+  CompTransform(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+struct CompTracked
+{
+  CompTracked() : value(0) {}
+  CompTracked(int valueIn) : value(valueIn) {}
+
+  int value;
+};
+
+}
+
+namespace CPM_ES_NS {
+template <> struct ComponentContainerType<CompTransform>
+{typedef UniqueComponentContainer<CompTransform> type;};
+template <> struct ComponentContainerType<CompTracked>
+{typedef UniqueComponentContainer<CompTracked> type;};
+template <> struct TrackComponentChanges<CompTracked> : std::true_type {};
+}
+
+namespace {
+
+static_assert(es::IsUniqueComponent<CompTransform>::value, "CompTransform should be unique");
+static_assert(!es::IsUniqueComponent<CompGameplay>::value, "CompGameplay should not be unique");
+
+class TransformSystem : public es::GenericSystem<false, CompTransform, CompGameplay>
+{
+public:
+  std::vector<std::tuple<uint64_t, float, int>> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompTransform* trafo, const CompGameplay* gp) override
+  {
+    log.push_back(std::make_tuple(entityID, trafo->position.x, gp ? gp->health : -1));
+  }
+
+  bool isComponentOptional(uint64_t templateID) override
+  {
+    return es::OptionalComponents<CompGameplay>(templateID);
+  }
+};
+
+class TransformGroupSystem : public es::GenericSystem<true, CompTransform, CompGameplay>
+{
+public:
+  std::vector<std::tuple<uint64_t, size_t, size_t>> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<CompTransform>& trafo,
+                    const es::ComponentGroup<CompGameplay>& gp) override
+  {
+    log.push_back(std::make_tuple(entityID, trafo.size(), gp.size()));
+  }
+};
+
+TEST(EntitySystem, TestUniqueContainer)
+{
+  std::shared_ptr<es::ESCore> core(new es::ESCore());
+
+  for (uint64_t id = 1; id <= 6; ++id)
+  {
+    core->addComponent(id, CompTransform(glm::vec3(static_cast<float>(id), 0.0f, 0.0f)));
+    if (id % 2 == 0)
+    {
+      core->addComponent(id, CompGameplay(static_cast<int>(id), 0));
+      core->addComponent(id, CompGameplay(static_cast<int>(id) * 10, 0));
+    }
+  }
+  // Duplicates within a frame: the newest one wins.
+  core->addComponent(3, CompTransform(glm::vec3(30.0f, 0.0f, 0.0f)));
+  core->addComponent(3, CompTransform(glm::vec3(31.0f, 0.0f, 0.0f)));
+  core->renormalize();
+
+  es::UniqueComponentContainer<CompTransform>* cont =
+      dynamic_cast<es::UniqueComponentContainer<CompTransform>*>(
+          core->getComponentContainer(es::getESTypeID<CompTransform>()));
+  ASSERT_NE(nullptr, cont);
+  EXPECT_EQ(6, cont->getNumComponents());
+  EXPECT_EQ(1, cont->getNumComponentsWithSequence(3));
+
+  TransformSystem sys;
+  sys.walkComponents(*core);
+  std::vector<std::tuple<uint64_t, float, int>> expected = {
+    std::make_tuple(1, 1.0f, -1),
+    std::make_tuple(2, 2.0f, 2), std::make_tuple(2, 2.0f, 20),
+    std::make_tuple(3, 31.0f, -1),
+    std::make_tuple(4, 4.0f, 4), std::make_tuple(4, 4.0f, 40),
+    std::make_tuple(5, 5.0f, -1),
+    std::make_tuple(6, 6.0f, 6), std::make_tuple(6, 6.0f, 60),
+  };
+  EXPECT_TRUE(expected == sys.log);
+
+  TransformGroupSystem group;
+  group.walkComponents(*core);
+  std::vector<std::tuple<uint64_t, size_t, size_t>> expectedGroups = {
+    std::make_tuple(2, 1, 2), std::make_tuple(4, 1, 2), std::make_tuple(6, 1, 2),
+  };
+  EXPECT_TRUE(expectedGroups == group.log);
+
+  // Duplicates across frames replace the existing component. A removal in
+  // the same frame as a replacement removes the component.
+  core->addComponent(2, CompTransform(glm::vec3(22.0f, 0.0f, 0.0f)));
+  core->addComponent(5, CompTransform(glm::vec3(55.0f, 0.0f, 0.0f)));
+  core->removeFirstComponentT<CompTransform>(5);
+  core->addComponent(7, CompTransform(glm::vec3(7.0f, 0.0f, 0.0f)));
+  core->renormalize();
+
+  EXPECT_EQ(6, cont->getNumComponents());
+
+  TransformSystem after;
+  after.walkEntity(*core, 2);
+  after.walkEntity(*core, 5);
+  after.walkEntity(*core, 7);
+  std::vector<std::tuple<uint64_t, float, int>> expectedAfter = {
+    std::make_tuple(2, 22.0f, 2), std::make_tuple(2, 22.0f, 20),
+    std::make_tuple(7, 7.0f, -1),
+  };
+  EXPECT_TRUE(expectedAfter == after.log);
+}
+
+// Stores CompTransform in a plain ComponentContainer.
+class PlainTransformCore : public es::ESCore
+{
+public:
+  void addPlainTransform(uint64_t entityID, const CompTransform& component)
+  {
+    coreAddComponent<CompTransform, es::ComponentContainer<CompTransform>>(entityID, component);
+  }
+};
+
+TEST(EntitySystem, TestUniqueContainerMismatch)
+{
+  // A plain container for a component type declared unique would be walked
+  // one-to-one, silently skipping duplicates.
+  PlainTransformCore core;
+  core.addPlainTransform(1, CompTransform(glm::vec3(1.0f, 0.0f, 0.0f)));
+  core.addPlainTransform(1, CompTransform(glm::vec3(2.0f, 0.0f, 0.0f)));
+  core.renormalize();
+
+  TransformSystem sys;
+  EXPECT_THROW(sys.walkComponents(core), std::runtime_error);
+  EXPECT_THROW(sys.walkEntity(core, 1), std::runtime_error);
+  EXPECT_TRUE(sys.log.empty());
+}
+
+TEST(EntitySystem, TestUniqueContainerRemovalVersion)
+{
+  // Replacements and removals in the same frame are one change.
+  es::ESCore core;
+  for (uint64_t id = 1; id <= 4; ++id)
+    core.addComponent(id, CompTracked(static_cast<int>(id)));
+  core.renormalize();
+
+  es::UniqueComponentContainer<CompTracked>* cont =
+      dynamic_cast<es::UniqueComponentContainer<CompTracked>*>(
+          core.getComponentContainer(es::getESTypeID<CompTracked>()));
+  ASSERT_NE(nullptr, cont);
+  uint64_t version = cont->getChangeVersion();
+
+  core.addComponent(2, CompTracked(20));
+  core.addComponent(5, CompTracked(5));
+  core.removeEntity(3);
+  core.renormalize();
+
+  EXPECT_EQ(version + 1, cont->getChangeVersion());
+  EXPECT_EQ(4, cont->getNumComponents());
+  EXPECT_EQ(20, cont->getComponent(2).first->value);
+  EXPECT_EQ(nullptr, cont->getComponent(3).first);
+
+  std::vector<uint64_t> changed;
+  cont->collectChangedSequences(version, changed);
+  std::vector<uint64_t> expected = {2, 5};
+  EXPECT_TRUE(expected == changed);
+}
+
+}
@@ -0,0 +1,168 @@
+
+#include <entity-system/GenericSystem.hpp>
+#include <entity-system/ESCore.hpp>
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <glm/glm.hpp>
+
+// Global variable from tests/main.cpp -- the random seed that we should use.
+extern uint64_t gRandomSeed;
+
+namespace es = CPM_ES_NS;
+
+namespace {
+
+struct CompPosition
+{
+  CompPosition() {}
+  CompPosition(const glm::vec3& pos) {position = pos;}
+
+  glm::vec3 position;
+};
+
+struct CompGameplay
+{
+  CompGameplay() : health(0), armor(0) {}
+  CompGameplay(int healthIn, int armorIn)
+  {
+    this->health = healthIn;
+    this->armor = armorIn;
+  }
+
+  int health;
+  int armor;
+};
+
+struct CompCamera
+{
+  CompCamera() : fov(0.0f) {}
+  CompCamera(float fovIn) : fov(fovIn) {}
+
+  float fov;
+};
+
+// Each execution is logged as (entityID, position.x, health or -1, fov).
+typedef std::tuple<uint64_t, float, int, float> ExecEntry;
+
+class RecordSystem : public es::GenericSystem<false, CompPosition, CompGameplay, CompCamera>
+{
+public:
+  std::vector<ExecEntry> log;
+
+  void execute(es::ESCoreBase&, uint64_t entityID,
+               const CompPosition* pos, const CompGameplay* gp,
+               const CompCamera* cam) override
+  {
+    log.push_back(std::make_tuple(entityID, pos->position.x,
+                                  gp ? gp->health : -1, cam->fov));
+  }
+
+  bool isComponentOptional(uint64_t templateID) override
+  {
+    return es::OptionalComponents<CompGameplay>(templateID);
+  }
+};
+
+// Grouped executions log the entity ID and the size of each group.
+typedef std::tuple<uint64_t, size_t, size_t, size_t> GroupEntry;
+
+class RecordGroupSystem : public es::GenericSystem<true, CompPosition, CompGameplay, CompCamera>
+{
+public:
+  std::vector<GroupEntry> log;
+
+  void groupExecute(es::ESCoreBase&, uint64_t entityID,
+                    const es::ComponentGroup<CompPosition>& pos,
+                    const es::ComponentGroup<CompGameplay>& gp,
+                    const es::ComponentGroup<CompCamera>& cam) override
+  {
+    log.push_back(std::make_tuple(entityID, pos.size(), gp.size(), cam.size()));
+  }
+
+  bool isComponentOptional(uint64_t templateID) override
+  {
+    return es::OptionalComponents<CompGameplay>(templateID);
+  }
+};
+
+TEST(EntitySystem, TestWalkEntities)
+{
+  std::mt19937 rng(static_cast<std::mt19937::result_type>(gRandomSeed));
+  std::uniform_int_distribution<int> coin(0, 3);
+
+  std::shared_ptr<es::ESCore> core(new es::ESCore());
+  core->addStaticComponent(CompCamera(45.0f));
+
+  const uint64_t numEntities = 500;
+  for (uint64_t i = 0; i < numEntities; ++i)
+  {
+    uint64_t id = core->getNewEntityID();
+
+    // Some entities are missing mandatory components, some have several
+    // components of the same type.
+    int numPos = coin(rng);
+    for (int p = 0; p < numPos; ++p)
+      core->addComponent(id, CompPosition(glm::vec3(static_cast<float>(id) + p * 0.25f, 0.0f, 0.0f)));
+
+    if (coin(rng) != 0)
+      core->addComponent(id, CompGameplay(static_cast<int>(id), 0));
+  }
+  core->renormalize(true);
+
+  // Scattered, unsorted query containing duplicates and IDs that do not exist.
+  std::vector<uint64_t> query;
+  std::uniform_int_distribution<uint64_t> anyID(0, numEntities + 20);
+  for (int i = 0; i < 300; ++i)
+    query.push_back(anyID(rng));
+
+  std::vector<uint64_t> sorted = query;
+  std::sort(sorted.begin(), sorted.end());
+
+  // Non-grouped.
+  {
+    RecordSystem expected;
+    size_t expectedExecuted = 0;
+    for (uint64_t id : sorted)
+      if (expected.walkEntity(*core, id))
+        ++expectedExecuted;
+
+    RecordSystem batched;
+    size_t executed = batched.walkEntities(*core, query);
+
+    EXPECT_EQ(expectedExecuted, executed);
+    ASSERT_EQ(expected.log.size(), batched.log.size());
+    EXPECT_TRUE(expected.log == batched.log);
+    EXPECT_FALSE(batched.log.empty());
+  }
+
+  // Grouped.
+  {
+    RecordGroupSystem expected;
+    size_t expectedExecuted = 0;
+    for (uint64_t id : sorted)
+      if (expected.walkEntity(*core, id))
+        ++expectedExecuted;
+
+    RecordGroupSystem batched;
+    size_t executed = batched.walkEntities(*core, query);
+
+    EXPECT_EQ(expectedExecuted, executed);
+    EXPECT_TRUE(expected.log == batched.log);
+  }
+
+  // Through the BaseSystem interface with an already sorted list.
+  {
+    RecordSystem expected;
+    for (uint64_t id : sorted)
+      expected.walkEntity(*core, id);
+
+    RecordSystem batched;
+    batched.walkSortedEntities(*core, &sorted[0], sorted.size());
+    EXPECT_TRUE(expected.log == batched.log);
+  }
+}
+
+}
+